@@ -0,0 +1,113 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bsec_bus.h"
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an empty completion queue
+ *
+ * @param[out]  bus                 completion queue of the bus to initialize
+ * @param[in]   notify              pointer to the function waking the event loop up, NULL if it polls
+ * @param[in]   notify_arg          pointer handed to the notify function
+ *
+ * @return      none
+ */
+void bsec_iot_bus_init(bsec_iot_bus_t *bus, bsec_iot_bus_notify_fct notify, void *notify_arg) {
+    memset(bus, 0, sizeof(*bus));
+    bus->notify = notify;
+    bus->notify_arg = notify_arg;
+}
+
+/*!
+ * @brief       Queue the end of the read of a sensor, without ever waiting
+ *
+ * @param[in]   bus                 completion queue of the bus
+ * @param[in]   ctx                 context of the sensor whose read ended
+ * @param[in]   rslt                result of the transfer, BME68X_INTF_RET_SUCCESS if the registers were read
+ *
+ * @return      none
+ */
+void bsec_iot_bus_complete(bsec_iot_bus_t *bus, bsec_iot_ctx_t *ctx, BME68X_INTF_RET_TYPE rslt) {
+    unsigned int head = __atomic_load_n(&bus->head, __ATOMIC_RELAXED);
+    bsec_iot_bus_completion_t *item;
+
+    /* The interrupt never waits for the event loop, a lost completion lets the read time out */
+    if (head - __atomic_load_n(&bus->tail, __ATOMIC_ACQUIRE) >= BSEC_IOT_BUS_DEPTH) {
+        bus->n_dropped++;
+        return;
+    }
+
+    item = &bus->items[head % BSEC_IOT_BUS_DEPTH];
+    item->ctx = ctx;
+    item->rslt = rslt;
+
+    /* Publish the item once it is complete */
+    __atomic_store_n(&bus->head, head + 1, __ATOMIC_RELEASE);
+    bus->n_completed++;
+
+    if (bus->notify != NULL) {
+        bus->notify(bus->notify_arg);
+    }
+}
+
+/*!
+ * @brief       Report the queued completions to the sensors with bsec_iot_bus_done()
+ *
+ * @param[in]   bus                 completion queue of the bus
+ * @param[in]   sched               scheduler serving the sensors, which are put back in order, NULL if none
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      number of completions dispatched
+ */
+uint32_t bsec_iot_bus_dispatch(bsec_iot_bus_t *bus, bsec_iot_sched_t *sched, int64_t now_us) {
+    unsigned int tail = __atomic_load_n(&bus->tail, __ATOMIC_RELAXED);
+    const bsec_iot_bus_completion_t *item;
+    uint32_t n_dispatched = 0;
+
+    while (tail != __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE)) {
+        item = &bus->items[tail % BSEC_IOT_BUS_DEPTH];
+        bsec_iot_bus_done(item->ctx, item->rslt, now_us);
+        if (sched != NULL) {
+            bsec_iot_sched_reschedule(sched, item->ctx);
+        }
+
+        /* Hand the slot back to the interrupt only once the item is no longer used */
+        tail++;
+        __atomic_store_n(&bus->tail, tail, __ATOMIC_RELEASE);
+        n_dispatched++;
+    }
+    bus->n_dispatched += n_dispatched;
+
+    return n_dispatched;
+}
+
+/*!
+ * @brief       Asynchronous read function doing the read through the blocking bus_read function of the sensor
+ *
+ * @param[in]   read_async_arg      unused
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   reg_addr            register address
+ * @param[out]  reg_data            buffer receiving the register data
+ * @param[in]   length              number of bytes to read
+ *
+ * @return      BME68X_INTF_RET_SUCCESS, the result of the transfer being reported through bsec_iot_bus_done()
+ */
+BME68X_INTF_RET_TYPE bsec_iot_bus_blocking_read(void *read_async_arg, bsec_iot_ctx_t *ctx, uint8_t reg_addr,
+                                                uint8_t *reg_data, uint32_t length) {
+    (void)read_async_arg;
+
+    /* Done before bsec_iot_step() gets back from the start of the read, its deadline is left as it is */
+    bsec_iot_bus_done(ctx, ctx->bus_read(reg_addr, reg_data, length, ctx->intf_ptr), ctx->deadline);
+
+    return BME68X_INTF_RET_SUCCESS;
+}
+
+/*! @}*/
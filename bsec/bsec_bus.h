@@ -0,0 +1,140 @@
+/*!
+ * @file bsec_bus.h
+ *
+ * @brief
+ * Completion of the asynchronous data reads of the sensors, from the interrupt of the bus to the event loop
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_BUS_H__
+#define __BSEC_BUS_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+#include "bsec_scheduler.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Number of completions the queue holds, a power of two. Each sensor has at most one read running, so a depth of at
+ * least the number of sensors on the bus never loses any. */
+#ifndef BSEC_IOT_BUS_DEPTH
+#define BSEC_IOT_BUS_DEPTH 8
+#endif
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to the function waking the event loop up after a completion was queued, e.g. by a task
+ * notification from the interrupt */
+typedef void (*bsec_iot_bus_notify_fct)(void *notify_arg);
+
+/* Structure with one queued completion */
+typedef struct {
+	/*! Context of the sensor whose read ended */
+	bsec_iot_ctx_t *ctx;
+	/*! Result of the transfer */
+	BME68X_INTF_RET_TYPE rslt;
+} bsec_iot_bus_completion_t;
+
+/* Structure holding the completions of the reads of one bus, between the interrupt (or the callback of the bus
+ * driver) reporting them and the event loop running bsec_iot_step() for the sensors of the bus */
+typedef struct {
+	/*! Queued completions */
+	bsec_iot_bus_completion_t items[BSEC_IOT_BUS_DEPTH];
+	/*! Number of completions queued so far, only written by the interrupt, only accessed atomically */
+	volatile unsigned int head;
+	/*! Number of completions dispatched so far, only written by the event loop, only accessed atomically */
+	volatile unsigned int tail;
+	/*! Function waking the event loop up, NULL if it polls */
+	bsec_iot_bus_notify_fct notify;
+	/*! Pointer handed to the notify function */
+	void *notify_arg;
+	/*! Number of completions queued */
+	uint32_t n_completed;
+	/*! Number of completions dropped because the queue was full, their reads then time out */
+	uint32_t n_dropped;
+	/*! Number of completions dispatched */
+	uint32_t n_dispatched;
+} bsec_iot_bus_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an empty completion queue
+ *
+ * @param[out]  bus                 completion queue of the bus to initialize
+ * @param[in]   notify              pointer to the function waking the event loop up, NULL if it polls
+ * @param[in]   notify_arg          pointer handed to the notify function
+ *
+ * @return      none
+ */
+void bsec_iot_bus_init(bsec_iot_bus_t *bus, bsec_iot_bus_notify_fct notify, void *notify_arg);
+
+/*!
+ * @brief       Queue the end of the read of a sensor, without ever waiting
+ *
+ * Meant to be called from the interrupt, or the transfer callback of the bus driver, that ends the read started by the
+ * bus_read_async_fct given to bsec_iot_set_async_read(); only one such caller per bus.
+ *
+ * @param[in]   bus                 completion queue of the bus
+ * @param[in]   ctx                 context of the sensor whose read ended
+ * @param[in]   rslt                result of the transfer, BME68X_INTF_RET_SUCCESS if the registers were read
+ *
+ * @return      none
+ */
+void bsec_iot_bus_complete(bsec_iot_bus_t *bus, bsec_iot_ctx_t *ctx, BME68X_INTF_RET_TYPE rslt);
+
+/*!
+ * @brief       Report the queued completions to the sensors with bsec_iot_bus_done()
+ *
+ * Meant to be called by the event loop whenever it is notified, before running the phases that are due.
+ *
+ * @param[in]   bus                 completion queue of the bus
+ * @param[in]   sched               scheduler serving the sensors, which are put back in order, NULL if none
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      number of completions dispatched
+ */
+uint32_t bsec_iot_bus_dispatch(bsec_iot_bus_t *bus, bsec_iot_sched_t *sched, int64_t now_us);
+
+/*!
+ * @brief       Asynchronous read function doing the read through the blocking bus_read function of the sensor
+ *
+ * Lets the code written for bsec_iot_set_async_read() run on a bus that only has blocking transfers: the read ends
+ * before the function returns, so bsec_iot_step() goes on at once as with no asynchronous read.
+ *
+ * @param[in]   read_async_arg      unused
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   reg_addr            register address
+ * @param[out]  reg_data            buffer receiving the register data
+ * @param[in]   length              number of bytes to read
+ *
+ * @return      BME68X_INTF_RET_SUCCESS, the result of the transfer being reported through bsec_iot_bus_done()
+ */
+BME68X_INTF_RET_TYPE bsec_iot_bus_blocking_read(void *read_async_arg, bsec_iot_ctx_t *ctx, uint8_t reg_addr,
+                                                uint8_t *reg_data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_BUS_H__ */
+
+/*! @}*/
@@ -0,0 +1,189 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bsec_energy.h"
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+/* Typical currents of a BME68X and an ESP32 at 160 MHz with the radio off, and the charge of 4.7 kOhm I2C pull-ups at
+ * 3.3 V and 400 kHz */
+static const bsec_iot_energy_coeffs_t bsec_iot_energy_default_coeffs = {
+    .heater_ua = 12000.0f,
+    .tph_ua = 500.0f,
+    .sleep_ua = 0.15f,
+    .cpu_ua = 40000.0f,
+    .wake_nc = 5000.0f,
+    .transfer_nc = 20.0f,
+    .byte_nc = 8.0f,
+};
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Mode a sensor is in
+ *
+ * @param[in]   ctx                 context of the sensor
+ *
+ * @return      mode of the sensor
+ */
+static bsec_iot_energy_mode_t bsec_iot_energy_mode(const bsec_iot_ctx_t *ctx) {
+    if (ctx->op_mode == BME68X_PARALLEL_MODE || ctx->sample_rate == BSEC_SAMPLE_RATE_SCAN) {
+        return BSEC_IOT_ENERGY_MODE_SCAN;
+    }
+    if (ctx->sample_rate == BSEC_SAMPLE_RATE_CONT) {
+        return BSEC_IOT_ENERGY_MODE_CONT;
+    }
+    if (ctx->sample_rate == BSEC_SAMPLE_RATE_LP) {
+        return BSEC_IOT_ENERGY_MODE_LP;
+    }
+
+    return BSEC_IOT_ENERGY_MODE_ULP;
+}
+
+/*!
+ * @brief       Charge (in picocoulombs) of a current over a time
+ *
+ * @param[in]   time_us             time (in microseconds)
+ * @param[in]   current_ua          current (in microamperes)
+ *
+ * @return      charge, zero for a negative time
+ */
+static uint64_t bsec_iot_energy_charge(int64_t time_us, float current_ua) {
+    return (time_us > 0) ? (uint64_t)((float)time_us * current_ua) : 0;
+}
+
+/*!
+ * @brief       Increase of a counter since the previous update, the whole count if it was started over since
+ *
+ * @param[in]   cur                 current value of the counter
+ * @param[in]   last                value at the previous update
+ *
+ * @return      increase of the counter
+ */
+static uint32_t bsec_iot_energy_delta(uint32_t cur, uint32_t last) {
+    return (cur >= last) ? cur - last : cur;
+}
+
+/*!
+ * @brief       Increase of a time since the previous update, the whole time if it was started over since
+ *
+ * @param[in]   cur                 current value of the time (in microseconds)
+ * @param[in]   last                value at the previous update
+ *
+ * @return      increase of the time
+ */
+static int64_t bsec_iot_energy_delta_us(int64_t cur, int64_t last) {
+    return (cur >= last) ? cur - last : cur;
+}
+
+/*!
+ * @brief       Initialize the charge estimate of a sensor
+ *
+ * @param[out]  energy              charge estimate to initialize
+ * @param[in]   coeffs              currents and charges of the board, NULL for the typical ones of a BME68X on I2C
+ *                                  next to an ESP32
+ *
+ * @return      none
+ */
+void bsec_iot_energy_init(bsec_iot_energy_t *energy, const bsec_iot_energy_coeffs_t *coeffs) {
+    memset(energy, 0, sizeof(*energy));
+    energy->coeffs = (coeffs != NULL) ? *coeffs : bsec_iot_energy_default_coeffs;
+}
+
+/*!
+ * @brief       Charge what the sensor did since the previous update to the mode it was in then
+ *
+ * @param[in]   energy              charge estimate of the sensor
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      none
+ */
+void bsec_iot_energy_update(bsec_iot_energy_t *energy, const bsec_iot_ctx_t *ctx, int64_t now_us) {
+    const bsec_iot_activity_t *activity = &ctx->activity;
+    const bsec_iot_energy_coeffs_t *coeffs = &energy->coeffs;
+    bsec_iot_energy_bucket_t *bucket = &energy->modes[energy->mode];
+    uint32_t transfers = ctx->bus_stats.n_reads + ctx->bus_stats.n_writes;
+    uint32_t bytes = ctx->bus_stats.n_bytes_read + ctx->bus_stats.n_bytes_written;
+    int64_t elapsed = now_us - energy->last_us;
+    /* The counters start over whenever the context is set up again, e.g. by bsec_iot_init() */
+    int64_t tph_us = bsec_iot_energy_delta_us(activity->tph_us, energy->last.tph_us);
+    int64_t heater_us = bsec_iot_energy_delta_us(activity->heater_us, energy->last.heater_us);
+
+    if (energy->last_us != 0 && elapsed > 0) {
+        bucket->time_us += elapsed;
+        bucket->n_steps += bsec_iot_energy_delta(activity->n_steps, energy->last.n_steps);
+        bucket->charge_pc[BSEC_IOT_ENERGY_HEATER] += bsec_iot_energy_charge(heater_us, coeffs->heater_ua);
+        bucket->charge_pc[BSEC_IOT_ENERGY_TPH] += bsec_iot_energy_charge(tph_us, coeffs->tph_ua);
+        bucket->charge_pc[BSEC_IOT_ENERGY_BUS] +=
+            (uint64_t)((float)bsec_iot_energy_delta(transfers, energy->last_transfers) * coeffs->transfer_nc * 1000.0f +
+                       (float)bsec_iot_energy_delta(bytes, energy->last_bytes) * coeffs->byte_nc * 1000.0f);
+        bucket->charge_pc[BSEC_IOT_ENERGY_CPU] +=
+            bsec_iot_energy_charge(bsec_iot_energy_delta_us(activity->cpu_us, energy->last.cpu_us), coeffs->cpu_ua) +
+            (uint64_t)((float)bsec_iot_energy_delta(activity->n_phases, energy->last.n_phases) * coeffs->wake_nc *
+                       1000.0f);
+
+        /* The sensor sleeps whenever it neither converts nor heats */
+        bucket->charge_pc[BSEC_IOT_ENERGY_SLEEP] += bsec_iot_energy_charge(elapsed - tph_us - heater_us,
+                                                                           coeffs->sleep_ua);
+    }
+
+    /* What happens until the next update is charged to the mode set by this sample */
+    energy->mode = bsec_iot_energy_mode(ctx);
+    energy->last_us = now_us;
+    energy->last = *activity;
+    energy->last_transfers = transfers;
+    energy->last_bytes = bytes;
+}
+
+/*!
+ * @brief       Sum up the charge spent in a mode
+ *
+ * @param[in]   energy              charge estimate of the sensor
+ * @param[in]   mode                mode, BSEC_IOT_ENERGY_NUM_MODES for all of them
+ * @param[out]  report              charge spent
+ *
+ * @return      none
+ */
+void bsec_iot_energy_get(const bsec_iot_energy_t *energy, bsec_iot_energy_mode_t mode,
+                         bsec_iot_energy_report_t *report) {
+    uint64_t charge_pc[BSEC_IOT_ENERGY_NUM_PARTS] = {0};
+    uint64_t total_pc = 0;
+    uint8_t m;
+    uint8_t part;
+
+    memset(report, 0, sizeof(*report));
+    for (m = 0; m < BSEC_IOT_ENERGY_NUM_MODES; m++) {
+        if (mode != BSEC_IOT_ENERGY_NUM_MODES && m != mode) {
+            continue;
+        }
+        report->time_us += energy->modes[m].time_us;
+        report->n_steps += energy->modes[m].n_steps;
+        for (part = 0; part < BSEC_IOT_ENERGY_NUM_PARTS; part++) {
+            charge_pc[part] += energy->modes[m].charge_pc[part];
+        }
+    }
+
+    for (part = 0; part < BSEC_IOT_ENERGY_NUM_PARTS; part++) {
+        report->charge_uc[part] = (float)charge_pc[part] / 1e6f;
+        total_pc += charge_pc[part];
+    }
+    report->total_uc = (float)total_pc / 1e6f;
+    if (report->n_steps > 0) {
+        report->per_sample_uc = report->total_uc / (float)report->n_steps;
+    }
+    /* Picocoulombs per microsecond are microamperes */
+    if (report->time_us > 0) {
+        report->per_hour_uah = (float)total_pc / (float)report->time_us;
+    }
+}
+
+/*! @}*/
@@ -0,0 +1,170 @@
+/*!
+ * @file bsec_energy.h
+ *
+ * @brief
+ * Estimate of the charge each sensor draws, per sample and per hour, from what the integration did
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_ENERGY_H__
+#define __BSEC_ENERGY_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* What the charge of a sensor is spent on */
+typedef enum {
+	/*! Gas sensor heater */
+	BSEC_IOT_ENERGY_HEATER = 0,
+	/*! Temperature, pressure and humidity conversions */
+	BSEC_IOT_ENERGY_TPH,
+	/*! Bus lines, e.g. the I2C pull-ups */
+	BSEC_IOT_ENERGY_BUS,
+	/*! Processor running the integration, the bus transfers and BSEC, and waking up for it */
+	BSEC_IOT_ENERGY_CPU,
+	/*! Sensor sleeping between measurements */
+	BSEC_IOT_ENERGY_SLEEP,
+	/*! Number of parts */
+	BSEC_IOT_ENERGY_NUM_PARTS
+} bsec_iot_energy_part_t;
+
+/* Modes the charge is broken down by, from the sample rate of the sensor */
+typedef enum {
+	/*! Ultra low power, measurements on demand included */
+	BSEC_IOT_ENERGY_MODE_ULP = 0,
+	/*! Low power */
+	BSEC_IOT_ENERGY_MODE_LP,
+	/*! Continuous */
+	BSEC_IOT_ENERGY_MODE_CONT,
+	/*! Parallel mode scan of the BME688 */
+	BSEC_IOT_ENERGY_MODE_SCAN,
+	/*! Number of modes */
+	BSEC_IOT_ENERGY_NUM_MODES
+} bsec_iot_energy_mode_t;
+
+/* Structure with the board specific currents and charges the estimate is made with */
+typedef struct {
+	/*! Current (in microamperes) of the heater while it is on */
+	float heater_ua;
+	/*! Current (in microamperes) of the sensor during a TPH conversion */
+	float tph_ua;
+	/*! Current (in microamperes) of the sensor while it sleeps */
+	float sleep_ua;
+	/*! Current (in microamperes) of the processor while it runs, the bus transfers being part of its running time */
+	float cpu_ua;
+	/*! Charge (in nanocoulombs) of waking the processor up for one phase of the acquisition cycle */
+	float wake_nc;
+	/*! Charge (in nanocoulombs) the bus lines draw per transfer, e.g. start, address and stop conditions */
+	float transfer_nc;
+	/*! Charge (in nanocoulombs) the bus lines draw per byte */
+	float byte_nc;
+} bsec_iot_energy_coeffs_t;
+
+/* Structure with the charge spent in one mode */
+typedef struct {
+	/*! Time (in microseconds) spent in the mode */
+	int64_t time_us;
+	/*! Number of sets of inputs processed by BSEC in the mode */
+	uint32_t n_steps;
+	/*! Charge (in picocoulombs) of each part */
+	uint64_t charge_pc[BSEC_IOT_ENERGY_NUM_PARTS];
+} bsec_iot_energy_bucket_t;
+
+/* Structure with the charge estimate of one sensor */
+typedef struct {
+	/*! Currents and charges the estimate is made with */
+	bsec_iot_energy_coeffs_t coeffs;
+	/*! Charge spent in each mode */
+	bsec_iot_energy_bucket_t modes[BSEC_IOT_ENERGY_NUM_MODES];
+	/*! Mode the sensor was in at the previous update */
+	bsec_iot_energy_mode_t mode;
+	/*! Time (in microseconds) of the previous update, zero before the first one */
+	int64_t last_us;
+	/*! Activity of the sensor at the previous update */
+	bsec_iot_activity_t last;
+	/*! Bus transfers at the previous update */
+	uint32_t last_transfers;
+	/*! Bytes transferred at the previous update */
+	uint32_t last_bytes;
+} bsec_iot_energy_t;
+
+/* Structure with the charge spent in a mode, or in all of them */
+typedef struct {
+	/*! Time (in microseconds) covered */
+	int64_t time_us;
+	/*! Number of sets of inputs processed by BSEC */
+	uint32_t n_steps;
+	/*! Charge (in microcoulombs) of each part */
+	float charge_uc[BSEC_IOT_ENERGY_NUM_PARTS];
+	/*! Total charge (in microcoulombs) */
+	float total_uc;
+	/*! Charge (in microcoulombs) per set of inputs processed */
+	float per_sample_uc;
+	/*! Charge (in microampere-hours) per hour, i.e. the mean current in microamperes */
+	float per_hour_uah;
+} bsec_iot_energy_report_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize the charge estimate of a sensor
+ *
+ * @param[out]  energy              charge estimate to initialize
+ * @param[in]   coeffs              currents and charges of the board, NULL for the typical ones of a BME68X on I2C
+ *                                  next to an ESP32
+ *
+ * @return      none
+ */
+void bsec_iot_energy_init(bsec_iot_energy_t *energy, const bsec_iot_energy_coeffs_t *coeffs);
+
+/*!
+ * @brief       Charge what the sensor did since the previous update to the mode it was in then
+ *
+ * Meant to be called from the output_ready function given to bsec_iot_set_handlers(), so that each sample is charged
+ * to the mode it was measured in; the first call only starts the estimate.
+ *
+ * @param[in]   energy              charge estimate of the sensor
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      none
+ */
+void bsec_iot_energy_update(bsec_iot_energy_t *energy, const bsec_iot_ctx_t *ctx, int64_t now_us);
+
+/*!
+ * @brief       Sum up the charge spent in a mode
+ *
+ * @param[in]   energy              charge estimate of the sensor
+ * @param[in]   mode                mode, BSEC_IOT_ENERGY_NUM_MODES for all of them
+ * @param[out]  report              charge spent
+ *
+ * @return      none
+ */
+void bsec_iot_energy_get(const bsec_iot_energy_t *energy, bsec_iot_energy_mode_t mode,
+                         bsec_iot_energy_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_ENERGY_H__ */
+
+/*! @}*/
@@ -0,0 +1,583 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bsec_history.h"
+
+/**********************************************************************************************************************/
+/* local macro definitions */
+/**********************************************************************************************************************/
+
+/* Flags at the start of an encoded sample, telling which optional parts follow the time delta */
+#define BSEC_IOT_HISTORY_MASK_FOLLOWS       UINT8_C(0x01)
+#define BSEC_IOT_HISTORY_ACCURACY_FOLLOWS   UINT8_C(0x02)
+#define BSEC_IOT_HISTORY_CHANGED_FOLLOWS    UINT8_C(0x04)
+
+/* Number of bytes holding the accuracies of all the outputs, two bits each */
+#define BSEC_IOT_HISTORY_ACCURACY_LEN       ((BSEC_IOT_NUM_OUTPUTS + 3) / 4)
+
+/* Bits of the output mask that are outputs */
+#define BSEC_IOT_HISTORY_OUTPUTS_MASK       ((UINT32_C(1) << BSEC_IOT_NUM_OUTPUTS) - 1)
+
+/* Quantized values and time deltas are kept within +/-2^30 so that the difference of two of them fits 32 bits */
+#define BSEC_IOT_HISTORY_Q_MAX              INT32_C(0x3FFFFFFF)
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+/* Number of quantization steps per unit of each output, i.e. the inverse of the resolution it is stored with */
+static const float bsec_iot_history_scale[BSEC_IOT_NUM_OUTPUTS] = {
+    [BSEC_IOT_OUTPUT_IAQ] = 10.0f,
+    [BSEC_IOT_OUTPUT_STATIC_IAQ] = 10.0f,
+    [BSEC_IOT_OUTPUT_CO2_EQUIVALENT] = 1.0f,
+    [BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT] = 100.0f,
+    [BSEC_IOT_OUTPUT_RAW_TEMPERATURE] = 100.0f,
+    [BSEC_IOT_OUTPUT_RAW_PRESSURE] = 1.0f,
+    [BSEC_IOT_OUTPUT_RAW_HUMIDITY] = 100.0f,
+    [BSEC_IOT_OUTPUT_RAW_GAS] = 0.1f,
+    [BSEC_IOT_OUTPUT_STABILIZATION_STATUS] = 1.0f,
+    [BSEC_IOT_OUTPUT_RUN_IN_STATUS] = 1.0f,
+    [BSEC_IOT_OUTPUT_TEMPERATURE] = 100.0f,
+    [BSEC_IOT_OUTPUT_HUMIDITY] = 100.0f,
+    [BSEC_IOT_OUTPUT_COMPENSATED_GAS] = 1000.0f,
+    [BSEC_IOT_OUTPUT_GAS_PERCENTAGE] = 10.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_1] = 10.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_2] = 10.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_3] = 10.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_4] = 10.0f,
+    [BSEC_IOT_OUTPUT_RAW_GAS_INDEX] = 1.0f,
+};
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Block of the ring holding a sequence number
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   seq                 sequence number of the block, one or more
+ *
+ * @return      pointer to the block
+ */
+static bsec_iot_history_block_t *bsec_iot_history_block(const bsec_iot_history_t *hist, uint32_t seq) {
+    return (bsec_iot_history_block_t *)&hist->mem[((seq - 1) % hist->n_blocks) * hist->block_size];
+}
+
+/*!
+ * @brief       Sequence number of the oldest block still in the ring
+ *
+ * @param[in]   hist                history of the sensor
+ *
+ * @return      sequence number of the oldest block, one if the ring never wrapped
+ */
+static uint32_t bsec_iot_history_oldest(const bsec_iot_history_t *hist) {
+    return (hist->head_seq > hist->n_blocks) ? hist->head_seq - hist->n_blocks + 1 : 1;
+}
+
+/*!
+ * @brief       Quantize an output to the resolution of its type
+ *
+ * @param[in]   value               value of the output
+ * @param[in]   id                  output
+ *
+ * @return      quantized value
+ */
+static int32_t bsec_iot_history_quantize(float value, uint8_t id) {
+    float q = value * bsec_iot_history_scale[id];
+
+    if (!(q > -BSEC_IOT_HISTORY_Q_MAX)) {
+        /* Also catches NaN */
+        return -BSEC_IOT_HISTORY_Q_MAX;
+    }
+    if (q > BSEC_IOT_HISTORY_Q_MAX) {
+        return BSEC_IOT_HISTORY_Q_MAX;
+    }
+
+    return (int32_t)((q >= 0.0f) ? q + 0.5f : q - 0.5f);
+}
+
+/*!
+ * @brief       Write a signed value as a variable-length integer, zig-zag encoded so that small magnitudes take a byte
+ *
+ * @param[out]  buf                 buffer receiving the encoding, five bytes at most
+ * @param[in]   value               value to encode
+ *
+ * @return      number of bytes written
+ */
+static uint32_t bsec_iot_history_put_varint(uint8_t *buf, int32_t value) {
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    uint32_t n = 0;
+
+    while (zz >= 0x80) {
+        buf[n++] = (uint8_t)(zz | 0x80);
+        zz >>= 7;
+    }
+    buf[n++] = (uint8_t)zz;
+
+    return n;
+}
+
+/*!
+ * @brief       Read a variable-length integer written by bsec_iot_history_put_varint()
+ *
+ * @param[in]   buf                 encoded data
+ * @param[in,out] offset            offset of the integer, moved past it
+ * @param[in]   end                 offset of the end of the encoded data
+ * @param[out]  value               decoded value
+ *
+ * @return      zero if successful, negative if the data ends within the integer
+ */
+static int8_t bsec_iot_history_get_varint(const uint8_t *buf, uint32_t *offset, uint32_t end, int32_t *value) {
+    uint32_t zz = 0;
+    uint8_t shift;
+
+    for (shift = 0; shift < 35; shift += 7) {
+        if (*offset >= end) {
+            return -1;
+        }
+        zz |= (uint32_t)(buf[*offset] & 0x7F) << shift;
+        if (!(buf[(*offset)++] & 0x80)) {
+            *value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*!
+ * @brief       Start a new block with the sample about to be appended, overwriting the oldest one if the ring is full
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   time_ms             time stamp (in milliseconds) of the keyframe
+ *
+ * @return      pointer to the new block, NULL if the oldest one is still to be written to flash
+ */
+static bsec_iot_history_block_t *bsec_iot_history_start_block(bsec_iot_history_t *hist, int64_t time_ms) {
+    bsec_iot_history_block_t *block = bsec_iot_history_block(hist, hist->head_seq + 1);
+
+    /* A full block is left alone until it reached flash, the flushing task may be writing it */
+    if (block->seq != 0 && hist->spill != NULL &&
+        block->seq > __atomic_load_n(&hist->spilled_seq, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    /* The block filled so far is handed to the flushing task */
+    __atomic_store_n(&hist->head_seq, hist->head_seq + 1, __ATOMIC_RELEASE);
+
+    block->seq = hist->head_seq;
+    block->length = 0;
+    block->n_samples = 0;
+    block->start_ms = time_ms;
+
+    return block;
+}
+
+/*!
+ * @brief       Encode a sample as the difference to the previous one of the block, or as a keyframe
+ *
+ * The time is stored as the change of the time delta, zero while the sample period holds. The outputs that did not
+ * change at their resolution are left out when listing the changed ones takes fewer bytes than their zero deltas.
+ *
+ * @param[in]   hist                history of the sensor, holding the previous sample
+ * @param[in]   keyframe            non-zero to encode the absolute values
+ * @param[in]   time_ms             time stamp (in milliseconds) of the sample, the one of the block for a keyframe
+ * @param[in]   mask                outputs of the sample
+ * @param[in]   q                   quantized value of each output
+ * @param[in]   accuracy            accuracy of each output
+ * @param[out]  buf                 buffer receiving the encoding, BSEC_IOT_HISTORY_MAX_SAMPLE bytes
+ *
+ * @return      number of bytes written
+ */
+static uint32_t bsec_iot_history_encode(const bsec_iot_history_t *hist, uint8_t keyframe, int64_t time_ms,
+                                        uint32_t mask, const int32_t *q, const uint8_t *accuracy, uint8_t *buf) {
+    uint8_t packed[BSEC_IOT_HISTORY_ACCURACY_LEN] = {0};
+    uint8_t changed_buf[5];
+    int32_t delta[BSEC_IOT_NUM_OUTPUTS];
+    uint32_t changed = 0;
+    uint32_t n_changed_buf;
+    uint8_t n_unchanged = 0;
+    uint8_t flags = 0;
+    uint32_t n = 1;
+    uint8_t id;
+
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        packed[id / 4] |= (uint8_t)((accuracy[id] & 0x03) << (2 * (id % 4)));
+    }
+
+    n += bsec_iot_history_put_varint(&buf[n], keyframe ? 0 : (int32_t)(time_ms - hist->last_ms) - hist->last_dt_ms);
+    if (keyframe || mask != hist->last_mask) {
+        flags |= BSEC_IOT_HISTORY_MASK_FOLLOWS;
+        n += bsec_iot_history_put_varint(&buf[n], (int32_t)mask);
+    }
+    if (keyframe || memcmp(accuracy, hist->last_accuracy, BSEC_IOT_NUM_OUTPUTS) != 0) {
+        flags |= BSEC_IOT_HISTORY_ACCURACY_FOLLOWS;
+        memcpy(&buf[n], packed, sizeof(packed));
+        n += sizeof(packed);
+    }
+
+    /* An output missing from the previous samples is taken relative to its last value, zero in a keyframe */
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        if (mask & BSEC_IOT_OUTPUT_MASK(id)) {
+            delta[id] = keyframe ? q[id] : q[id] - hist->last_q[id];
+            if (delta[id] != 0) {
+                changed |= BSEC_IOT_OUTPUT_MASK(id);
+            } else {
+                n_unchanged++;
+            }
+        }
+    }
+
+    n_changed_buf = bsec_iot_history_put_varint(changed_buf, (int32_t)changed);
+    if (!keyframe && n_unchanged > n_changed_buf) {
+        flags |= BSEC_IOT_HISTORY_CHANGED_FOLLOWS;
+        memcpy(&buf[n], changed_buf, n_changed_buf);
+        n += n_changed_buf;
+        mask = changed;
+    }
+
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        if (mask & BSEC_IOT_OUTPUT_MASK(id)) {
+            n += bsec_iot_history_put_varint(&buf[n], delta[id]);
+        }
+    }
+
+    buf[0] = flags;
+    return n;
+}
+
+/*!
+ * @brief       Initialize an empty history on the memory given
+ *
+ * @param[out]  hist                history to initialize
+ * @param[in]   mem                 memory of the ring, aligned on 8 bytes
+ * @param[in]   size                size of the memory (in bytes)
+ * @param[in]   block_size          size (in bytes) of each block
+ *
+ * @return      zero if successful, negative if the memory does not hold two blocks
+ */
+int8_t bsec_iot_history_init(bsec_iot_history_t *hist, uint8_t *mem, uint32_t size, uint32_t block_size) {
+    memset(hist, 0, sizeof(*hist));
+
+    /* Every block starts 8-byte aligned for its header */
+    block_size &= ~UINT32_C(7);
+    if (block_size < BSEC_IOT_HISTORY_MIN_BLOCK_SIZE || block_size > UINT16_MAX || size / block_size < 2) {
+        return -1;
+    }
+
+    hist->mem = mem;
+    hist->block_size = block_size;
+    hist->n_blocks = size / block_size;
+    memset(mem, 0, hist->n_blocks * block_size);
+
+    return 0;
+}
+
+/*!
+ * @brief       Have the full blocks written to flash by bsec_iot_history_flush()
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   spill               pointer to the function writing a block
+ * @param[in]   storage             pointer handed to the spill function
+ * @param[in]   spill_budget_us     idle time (in microseconds) a block write needs
+ *
+ * @return      none
+ */
+void bsec_iot_history_set_spill(bsec_iot_history_t *hist, bsec_iot_history_spill_fct spill, void *storage,
+                                int64_t spill_budget_us) {
+    hist->spill = spill;
+    hist->storage = storage;
+    hist->spill_budget_us = spill_budget_us;
+
+    /* The full blocks already in the ring are written too */
+    __atomic_store_n(&hist->spilled_seq, bsec_iot_history_oldest(hist) - 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * @brief       Append the outputs of a step to the history
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+void bsec_iot_history_append(bsec_iot_history_t *hist, const bsec_iot_output_t *output) {
+    uint8_t buf[BSEC_IOT_HISTORY_MAX_SAMPLE];
+    bsec_iot_history_block_t *block = NULL;
+    int64_t time_ms = output->timestamp / 1000000;
+    uint32_t mask = output->valid_mask & BSEC_IOT_HISTORY_OUTPUTS_MASK;
+    int32_t q[BSEC_IOT_NUM_OUTPUTS];
+    uint8_t keyframe;
+    uint32_t n = 0;
+    uint8_t id;
+
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        q[id] = (mask & BSEC_IOT_OUTPUT_MASK(id)) ? bsec_iot_history_quantize(output->value[id], id) : 0;
+    }
+
+    if (hist->head_seq != 0) {
+        block = bsec_iot_history_block(hist, hist->head_seq);
+    }
+
+    /* A sample that does not fit starts the next block, as a keyframe. So does a clock going backwards or jumping by
+     * more than the time delta holds, since the time stamps of a block only go forward. */
+    keyframe = (block == NULL || time_ms < hist->last_ms || time_ms - hist->last_ms > BSEC_IOT_HISTORY_Q_MAX);
+    if (!keyframe) {
+        n = bsec_iot_history_encode(hist, 0, time_ms, mask, q, output->accuracy, buf);
+        keyframe = (sizeof(*block) + block->length + n > hist->block_size);
+    }
+    if (keyframe) {
+        block = bsec_iot_history_start_block(hist, time_ms);
+        if (block == NULL) {
+            hist->n_dropped++;
+            return;
+        }
+        memset(hist->last_q, 0, sizeof(hist->last_q));
+        hist->last_ms = time_ms;
+        hist->last_dt_ms = 0;
+        n = bsec_iot_history_encode(hist, 1, time_ms, mask, q, output->accuracy, buf);
+    }
+
+    memcpy((uint8_t *)(block + 1) + block->length, buf, n);
+    block->length = (uint16_t)(block->length + n);
+    block->n_samples++;
+
+    hist->last_dt_ms = (int32_t)(time_ms - hist->last_ms);
+    hist->last_ms = time_ms;
+    hist->last_mask = mask;
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        if (mask & BSEC_IOT_OUTPUT_MASK(id)) {
+            hist->last_q[id] = q[id];
+        }
+    }
+    memcpy(hist->last_accuracy, output->accuracy, BSEC_IOT_NUM_OUTPUTS);
+
+    hist->n_samples++;
+    hist->n_bytes += n;
+}
+
+/*!
+ * @brief       Write the full blocks not written yet, oldest first, as long as there is enough idle time
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   idle_us             time (in microseconds) left before the next sensor deadline
+ *
+ * @return      zero if nothing is left to write, positive if a write was deferred, negative if one failed
+ */
+int8_t bsec_iot_history_flush(bsec_iot_history_t *hist, int64_t idle_us) {
+    uint32_t seq;
+
+    if (hist->spill == NULL) {
+        return 0;
+    }
+
+    /* The blocks before the head are full, and left alone by the appending task until they are written */
+    while ((seq = hist->spilled_seq + 1) < __atomic_load_n(&hist->head_seq, __ATOMIC_ACQUIRE)) {
+        if (idle_us < hist->spill_budget_us) {
+            return 1;
+        }
+
+        if (hist->spill(hist->storage, (const uint8_t *)bsec_iot_history_block(hist, seq), hist->block_size) != 0) {
+            hist->n_spill_errors++;
+            return -1;
+        }
+
+        /* Only then may the appending task reuse the block */
+        __atomic_store_n(&hist->spilled_seq, seq, __ATOMIC_RELEASE);
+        hist->n_spilled++;
+        idle_us -= hist->spill_budget_us;
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       Position a decoding at the keyframe of a block
+ *
+ * @param[in]   iter                decoding
+ * @param[in]   block               block to decode
+ *
+ * @return      none
+ */
+static void bsec_iot_history_iter_load(bsec_iot_history_iter_t *iter, const uint8_t *block) {
+    const bsec_iot_history_block_t *header = (const bsec_iot_history_block_t *)block;
+
+    iter->block = block;
+    iter->seq = header->seq;
+    iter->offset = sizeof(*header);
+    iter->n_left = (header->seq != 0) ? header->n_samples : 0;
+    iter->last_ms = header->start_ms;
+    iter->last_dt_ms = 0;
+    iter->last_mask = 0;
+    memset(iter->last_q, 0, sizeof(iter->last_q));
+    memset(iter->last_accuracy, 0, sizeof(iter->last_accuracy));
+}
+
+/*!
+ * @brief       Start decoding the samples of the history within a time range
+ *
+ * @param[out]  iter                decoding to start
+ * @param[in]   hist                history of the sensor
+ * @param[in]   from_ns             time stamp (in nanoseconds) of the first sample wanted
+ * @param[in]   to_ns               time stamp (in nanoseconds) of the last sample wanted
+ *
+ * @return      none
+ */
+void bsec_iot_history_iter_init(bsec_iot_history_iter_t *iter, const bsec_iot_history_t *hist, int64_t from_ns,
+                                int64_t to_ns) {
+    uint32_t seq;
+
+    memset(iter, 0, sizeof(*iter));
+    iter->from_ms = from_ns / 1000000;
+    iter->to_ms = to_ns / 1000000;
+    if (hist->head_seq == 0) {
+        return;
+    }
+    iter->hist = hist;
+
+    /* Skip the blocks ending before the range, the keyframes tell without decoding them */
+    seq = bsec_iot_history_oldest(hist);
+    while (seq < hist->head_seq && bsec_iot_history_block(hist, seq + 1)->start_ms <= iter->from_ms) {
+        seq++;
+    }
+    bsec_iot_history_iter_load(iter, (const uint8_t *)bsec_iot_history_block(hist, seq));
+}
+
+/*!
+ * @brief       Start decoding the samples of a block within a time range
+ *
+ * @param[out]  iter                decoding to start
+ * @param[in]   block               block as handed to the spill function
+ * @param[in]   from_ns             time stamp (in nanoseconds) of the first sample wanted
+ * @param[in]   to_ns               time stamp (in nanoseconds) of the last sample wanted
+ *
+ * @return      none
+ */
+void bsec_iot_history_iter_block(bsec_iot_history_iter_t *iter, const uint8_t *block, int64_t from_ns, int64_t to_ns) {
+    memset(iter, 0, sizeof(*iter));
+    iter->from_ms = from_ns / 1000000;
+    iter->to_ms = to_ns / 1000000;
+    bsec_iot_history_iter_load(iter, block);
+}
+
+/*!
+ * @brief       Decode the next sample of the block
+ *
+ * @param[in]   iter                decoding, holding the previous sample
+ *
+ * @return      zero if successful, negative if the block is corrupted
+ */
+static int8_t bsec_iot_history_decode(bsec_iot_history_iter_t *iter) {
+    const uint8_t *data = iter->block;
+    uint32_t end = sizeof(bsec_iot_history_block_t) + ((const bsec_iot_history_block_t *)data)->length;
+    uint32_t changed;
+    int32_t value;
+    uint8_t flags;
+    uint8_t id;
+
+    if (iter->offset >= end) {
+        return -1;
+    }
+    flags = data[iter->offset++];
+
+    if (bsec_iot_history_get_varint(data, &iter->offset, end, &value) != 0) {
+        return -1;
+    }
+    iter->last_dt_ms += value;
+    iter->last_ms += iter->last_dt_ms;
+
+    if (flags & BSEC_IOT_HISTORY_MASK_FOLLOWS) {
+        if (bsec_iot_history_get_varint(data, &iter->offset, end, &value) != 0) {
+            return -1;
+        }
+        iter->last_mask = (uint32_t)value & BSEC_IOT_HISTORY_OUTPUTS_MASK;
+    }
+
+    if (flags & BSEC_IOT_HISTORY_ACCURACY_FOLLOWS) {
+        if (iter->offset + BSEC_IOT_HISTORY_ACCURACY_LEN > end) {
+            return -1;
+        }
+        for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+            iter->last_accuracy[id] = (data[iter->offset + id / 4] >> (2 * (id % 4))) & 0x03;
+        }
+        iter->offset += BSEC_IOT_HISTORY_ACCURACY_LEN;
+    }
+
+    changed = iter->last_mask;
+    if (flags & BSEC_IOT_HISTORY_CHANGED_FOLLOWS) {
+        if (bsec_iot_history_get_varint(data, &iter->offset, end, &value) != 0) {
+            return -1;
+        }
+        changed &= (uint32_t)value;
+    }
+
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        if (changed & BSEC_IOT_OUTPUT_MASK(id)) {
+            if (bsec_iot_history_get_varint(data, &iter->offset, end, &value) != 0) {
+                return -1;
+            }
+            iter->last_q[id] += value;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       Decode the next sample of the range
+ *
+ * @param[in]   iter                decoding
+ * @param[out]  output              outputs of the sample
+ *
+ * @return      one if a sample was decoded, zero at the end of the range
+ */
+uint8_t bsec_iot_history_next(bsec_iot_history_iter_t *iter, bsec_iot_output_t *output) {
+    uint8_t id;
+
+    for (;;) {
+        if (iter->n_left == 0) {
+            if (iter->hist == NULL || iter->seq >= iter->hist->head_seq) {
+                return 0;
+            }
+            bsec_iot_history_iter_load(iter, (const uint8_t *)bsec_iot_history_block(iter->hist, iter->seq + 1));
+            continue;
+        }
+
+        /* The rest of a corrupted block is skipped */
+        iter->n_left--;
+        if (bsec_iot_history_decode(iter) != 0) {
+            iter->n_left = 0;
+            continue;
+        }
+
+        if (iter->last_ms > iter->to_ms) {
+            iter->n_left = 0;
+            iter->hist = NULL;
+            return 0;
+        }
+        if (iter->last_ms >= iter->from_ms) {
+            break;
+        }
+    }
+
+    memset(output, 0, sizeof(*output));
+    output->timestamp = iter->last_ms * 1000000;
+    output->valid_mask = iter->last_mask;
+    output->subscribed_mask = iter->last_mask;
+    output->bsec_status = BSEC_OK;
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        if (iter->last_mask & BSEC_IOT_OUTPUT_MASK(id)) {
+            output->value[id] = (float)iter->last_q[id] / bsec_iot_history_scale[id];
+            output->accuracy[id] = iter->last_accuracy[id];
+        }
+    }
+
+    return 1;
+}
+
+/*! @}*/
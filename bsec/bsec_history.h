@@ -0,0 +1,236 @@
+/*!
+ * @file bsec_history.h
+ *
+ * @brief
+ * Compressed history of the BSEC outputs in a fixed-size ring of blocks, which can be spilled to flash
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_HISTORY_H__
+#define __BSEC_HISTORY_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Largest encoded sample (in bytes): flags, time delta, output mask, packed accuracies, mask of the changed outputs
+ * and one delta per output */
+#define BSEC_IOT_HISTORY_MAX_SAMPLE (1 + 5 + 5 + (BSEC_IOT_NUM_OUTPUTS + 3) / 4 + 5 + 5 * BSEC_IOT_NUM_OUTPUTS)
+
+/* Smallest block size (in bytes), holding the block header and at least one sample */
+#define BSEC_IOT_HISTORY_MIN_BLOCK_SIZE (sizeof(bsec_iot_history_block_t) + BSEC_IOT_HISTORY_MAX_SAMPLE)
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to the function writing a full block to flash, returning zero if successful */
+typedef int8_t (*bsec_iot_history_spill_fct)(void *storage, const uint8_t *block, uint32_t length);
+
+/* Structure at the start of each block. The first sample of a block is a keyframe holding absolute values, the
+ * following ones only their difference to the previous sample, so that a block decodes on its own. */
+typedef struct {
+	/*! Sequence number of the block, zero while it was never written */
+	uint32_t seq;
+	/*! Number of bytes of encoded samples following the header */
+	uint16_t length;
+	/*! Number of samples in the block */
+	uint16_t n_samples;
+	/*! Time stamp (in milliseconds) of the keyframe */
+	int64_t start_ms;
+} bsec_iot_history_block_t;
+
+/* Structure holding the history of one sensor. The history is appended to and read from one task, e.g. the one running
+ * output_ready; the blocks may be written to flash from another one, e.g. the idle function of the scheduler. The
+ * full blocks pass between them as in a queue: once the ring is full of blocks not written yet, the newest samples
+ * are dropped rather than a block overwritten while it is being written. */
+typedef struct {
+	/*! Memory of the ring, n_blocks blocks of block_size bytes aligned on 8 bytes */
+	uint8_t *mem;
+	/*! Size (in bytes) of each block */
+	uint32_t block_size;
+	/*! Number of blocks in the ring */
+	uint32_t n_blocks;
+	/*! Sequence number of the block being filled, zero before the first sample; only written by the appending task,
+	 * read atomically by the flushing one */
+	volatile uint32_t head_seq;
+	/*! Sequence number of the latest block written to flash; only written by the flushing task, read atomically by
+	 * the appending one */
+	volatile uint32_t spilled_seq;
+	/*! Function writing a full block to flash, NULL if the blocks are only kept in RAM */
+	bsec_iot_history_spill_fct spill;
+	/*! Pointer handed to the spill function, e.g. a partition */
+	void *storage;
+	/*! Idle time (in microseconds) a block write needs */
+	int64_t spill_budget_us;
+	/*! Time stamp (in milliseconds) of the latest sample */
+	int64_t last_ms;
+	/*! Time (in milliseconds) between the latest two samples of the block being filled */
+	int32_t last_dt_ms;
+	/*! Output mask of the latest sample */
+	uint32_t last_mask;
+	/*! Quantized value of each output in the latest sample */
+	int32_t last_q[BSEC_IOT_NUM_OUTPUTS];
+	/*! Accuracy of each output in the latest sample */
+	uint8_t last_accuracy[BSEC_IOT_NUM_OUTPUTS];
+	/*! Number of samples appended */
+	uint32_t n_samples;
+	/*! Number of bytes the appended samples were encoded to, block headers excluded */
+	uint32_t n_bytes;
+	/*! Number of samples dropped because the ring was full of blocks not written to flash yet */
+	uint32_t n_dropped;
+	/*! Number of blocks written to flash */
+	uint32_t n_spilled;
+	/*! Number of failed block writes */
+	uint32_t n_spill_errors;
+} bsec_iot_history_t;
+
+/* Structure holding the position of a decoding through the history or a spilled block */
+typedef struct {
+	/*! History decoded, NULL when decoding a single block */
+	const bsec_iot_history_t *hist;
+	/*! Block being decoded */
+	const uint8_t *block;
+	/*! Sequence number of the block being decoded */
+	uint32_t seq;
+	/*! Offset (in bytes) of the next sample in the block */
+	uint32_t offset;
+	/*! Number of samples left in the block */
+	uint16_t n_left;
+	/*! Time stamp (in milliseconds) from which the samples are returned */
+	int64_t from_ms;
+	/*! Time stamp (in milliseconds) after which the decoding stops */
+	int64_t to_ms;
+	/*! Time stamp (in milliseconds) of the previous sample */
+	int64_t last_ms;
+	/*! Time (in milliseconds) between the previous two samples */
+	int32_t last_dt_ms;
+	/*! Output mask of the previous sample */
+	uint32_t last_mask;
+	/*! Quantized value of each output in the previous sample */
+	int32_t last_q[BSEC_IOT_NUM_OUTPUTS];
+	/*! Accuracy of each output in the previous sample */
+	uint8_t last_accuracy[BSEC_IOT_NUM_OUTPUTS];
+} bsec_iot_history_iter_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an empty history on the memory given
+ *
+ * The longer the blocks, the fewer keyframes are stored, at the cost of more data lost with each overwritten block.
+ *
+ * @param[out]  hist                history to initialize
+ * @param[in]   mem                 memory of the ring, aligned on 8 bytes
+ * @param[in]   size                size of the memory (in bytes)
+ * @param[in]   block_size          size (in bytes) of each block, at least BSEC_IOT_HISTORY_MIN_BLOCK_SIZE
+ *
+ * @return      zero if successful, negative if the memory does not hold two blocks
+ */
+int8_t bsec_iot_history_init(bsec_iot_history_t *hist, uint8_t *mem, uint32_t size, uint32_t block_size);
+
+/*!
+ * @brief       Have the full blocks written to flash by bsec_iot_history_flush()
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   spill               pointer to the function writing a block
+ * @param[in]   storage             pointer handed to the spill function
+ * @param[in]   spill_budget_us     idle time (in microseconds) a block write needs
+ *
+ * @return      none
+ */
+void bsec_iot_history_set_spill(bsec_iot_history_t *hist, bsec_iot_history_spill_fct spill, void *storage,
+                                int64_t spill_budget_us);
+
+/*!
+ * @brief       Append the outputs of a step to the history
+ *
+ * Meant to be called from the output_ready function given to bsec_iot_set_handlers(). The outputs are quantized to the
+ * resolution of their type and stored as the variable-length difference to the previous sample; nothing is written to
+ * flash here. Once the ring is full, the oldest block is overwritten, or the sample dropped if that block is still to
+ * be written to flash.
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+void bsec_iot_history_append(bsec_iot_history_t *hist, const bsec_iot_output_t *output);
+
+/*!
+ * @brief       Write the full blocks not written yet, oldest first, as long as there is enough idle time
+ *
+ * Meant to be called from the idle function of the scheduler (see bsec_iot_sched_set_idle()), or from any other
+ * place out of the measurement path, always from the same task. That task may differ from the one appending.
+ *
+ * @param[in]   hist                history of the sensor
+ * @param[in]   idle_us             time (in microseconds) left before the next sensor deadline
+ *
+ * @return      zero if nothing is left to write, positive if a write was deferred, negative if one failed
+ */
+int8_t bsec_iot_history_flush(bsec_iot_history_t *hist, int64_t idle_us);
+
+/*!
+ * @brief       Start decoding the samples of the history within a time range
+ *
+ * The decoding starts from the keyframe of the block holding from_ns, the blocks before it are not decoded.
+ *
+ * @param[out]  iter                decoding to start
+ * @param[in]   hist                history of the sensor, not appended to until the decoding is over
+ * @param[in]   from_ns             time stamp (in nanoseconds) of the first sample wanted
+ * @param[in]   to_ns               time stamp (in nanoseconds) of the last sample wanted
+ *
+ * @return      none
+ */
+void bsec_iot_history_iter_init(bsec_iot_history_iter_t *iter, const bsec_iot_history_t *hist, int64_t from_ns,
+                                int64_t to_ns);
+
+/*!
+ * @brief       Start decoding the samples of a block within a time range, e.g. a block read back from flash
+ *
+ * @param[out]  iter                decoding to start
+ * @param[in]   block               block as handed to the spill function, aligned on 8 bytes
+ * @param[in]   from_ns             time stamp (in nanoseconds) of the first sample wanted
+ * @param[in]   to_ns               time stamp (in nanoseconds) of the last sample wanted
+ *
+ * @return      none
+ */
+void bsec_iot_history_iter_block(bsec_iot_history_iter_t *iter, const uint8_t *block, int64_t from_ns, int64_t to_ns);
+
+/*!
+ * @brief       Decode the next sample of the range
+ *
+ * The values are those of the quantized outputs; the time stamp is given to the millisecond and subscribed_mask is
+ * set to valid_mask.
+ *
+ * @param[in]   iter                decoding
+ * @param[out]  output              outputs of the sample
+ *
+ * @return      one if a sample was decoded, zero at the end of the range
+ */
+uint8_t bsec_iot_history_next(bsec_iot_history_iter_t *iter, bsec_iot_output_t *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_HISTORY_H__ */
+
+/*! @}*/
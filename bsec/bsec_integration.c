@@ -2,48 +2,388 @@
 /* header files */
 /**********************************************************************************************************************/
 
+#include <math.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
 
 #include "bsec_integration.h"
 
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#else
+#include <time.h>
+#endif
+
 /**********************************************************************************************************************/
 /* local macro definitions */
 /**********************************************************************************************************************/
 
 #define NUM_USED_OUTPUTS 10
 
+/* Interval at which the completion of a measurement is checked again when it takes longer than expected */
+#define BSEC_IOT_RETRY_PERIOD_US 1000
+
+/* Number of measurement durations, past the expected completion, after which a measurement whose data does not come
+ * is given up */
+#define BSEC_IOT_RETRY_LIMIT 4
+
+/* Margin initially added to the expected measurement duration, refined from the observed completion times */
+#define BSEC_IOT_INITIAL_MARGIN_US 1000
+
+/* Time after which an asynchronous read that was not reported done is given up */
+#ifndef BSEC_IOT_BUS_TIMEOUT_US
+#define BSEC_IOT_BUS_TIMEOUT_US 10000
+#endif
+
+/* Register groups mirrored in the shadow of the sensor context */
+#define BSEC_IOT_SHADOW_CONF    UINT8_C(0x01)
+#define BSEC_IOT_SHADOW_HEATR   UINT8_C(0x02)
+
+/* Magic number of the retained image, to be changed along with the layout of bsec_iot_retained_t */
+#define BSEC_IOT_RETAINED_MAGIC UINT32_C(0x32525342)
+
+/* Total heating duration (in milliseconds) of one step of the parallel mode heater profile */
+#define BSEC_TOTAL_HEAT_DUR     UINT16_C(140)
+
+/* Update of the instrumentation counters, compiled out unless BSEC_IOT_INSTRUMENT is set */
+#if BSEC_IOT_INSTRUMENT
+#define BSEC_IOT_STAT(statement) statement
+#else
+#define BSEC_IOT_STAT(statement)
+#endif
+
 /**********************************************************************************************************************/
-/* global variable declarations */
+/* local variables */
 /**********************************************************************************************************************/
 
-/* Global sensor APIs data structure */
-static struct bme68x_dev bme68x;
-
-/* Global temperature offset to be subtracted */
-static float bme68x_temperature_offset_g = 0.0f;
+/* Dense identifier plus one of each BSEC output, indexed by its BSEC sensor identifier; zero for outputs not handled */
+static const uint8_t bsec_iot_output_ids[BSEC_OUTPUT_RAW_GAS_INDEX + 1] = {
+    [BSEC_OUTPUT_IAQ] = BSEC_IOT_OUTPUT_IAQ + 1,
+    [BSEC_OUTPUT_STATIC_IAQ] = BSEC_IOT_OUTPUT_STATIC_IAQ + 1,
+    [BSEC_OUTPUT_CO2_EQUIVALENT] = BSEC_IOT_OUTPUT_CO2_EQUIVALENT + 1,
+    [BSEC_OUTPUT_BREATH_VOC_EQUIVALENT] = BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT + 1,
+    [BSEC_OUTPUT_RAW_TEMPERATURE] = BSEC_IOT_OUTPUT_RAW_TEMPERATURE + 1,
+    [BSEC_OUTPUT_RAW_PRESSURE] = BSEC_IOT_OUTPUT_RAW_PRESSURE + 1,
+    [BSEC_OUTPUT_RAW_HUMIDITY] = BSEC_IOT_OUTPUT_RAW_HUMIDITY + 1,
+    [BSEC_OUTPUT_RAW_GAS] = BSEC_IOT_OUTPUT_RAW_GAS + 1,
+    [BSEC_OUTPUT_STABILIZATION_STATUS] = BSEC_IOT_OUTPUT_STABILIZATION_STATUS + 1,
+    [BSEC_OUTPUT_RUN_IN_STATUS] = BSEC_IOT_OUTPUT_RUN_IN_STATUS + 1,
+    [BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE] = BSEC_IOT_OUTPUT_TEMPERATURE + 1,
+    [BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY] = BSEC_IOT_OUTPUT_HUMIDITY + 1,
+    [BSEC_OUTPUT_COMPENSATED_GAS] = BSEC_IOT_OUTPUT_COMPENSATED_GAS + 1,
+    [BSEC_OUTPUT_GAS_PERCENTAGE] = BSEC_IOT_OUTPUT_GAS_PERCENTAGE + 1,
+    [BSEC_OUTPUT_GAS_ESTIMATE_1] = BSEC_IOT_OUTPUT_GAS_ESTIMATE_1 + 1,
+    [BSEC_OUTPUT_GAS_ESTIMATE_2] = BSEC_IOT_OUTPUT_GAS_ESTIMATE_2 + 1,
+    [BSEC_OUTPUT_GAS_ESTIMATE_3] = BSEC_IOT_OUTPUT_GAS_ESTIMATE_3 + 1,
+    [BSEC_OUTPUT_GAS_ESTIMATE_4] = BSEC_IOT_OUTPUT_GAS_ESTIMATE_4 + 1,
+    [BSEC_OUTPUT_RAW_GAS_INDEX] = BSEC_IOT_OUTPUT_RAW_GAS_INDEX + 1,
+};
 
 /**********************************************************************************************************************/
 /* functions */
 /**********************************************************************************************************************/
 
 /*!
- * @brief        Virtual sensor subscription
+ * @brief       Register address the burst of the data registers is read from
+ *
+ * @param[in]   ctx                 context of the sensor
+ *
+ * @return      address of the first data register, with the read bit set on SPI
+ */
+static uint8_t bme68x_bsec_burst_addr(const bsec_iot_ctx_t *ctx) {
+    return (ctx->bme68x.intf == BME68X_SPI_INTF) ? (BME68X_REG_FIELD0 | BME68X_SPI_RD_MSK) : BME68X_REG_FIELD0;
+}
+
+/*!
+ * @brief       Bus read function handed to the sensor API, counts the transfer and forwards it to the user function
+ *
+ * While the data is read over SPI, the first read of the data registers fetches all of them along with the heater
+ * registers the sensor API reads back one by one, and the following reads are served from that burst. A burst
+ * fetched beforehand by an asynchronous read serves them the same way on either bus.
+ *
+ * @param[in]   reg_addr            register address
+ * @param[out]  reg_data            buffer receiving the register data
+ * @param[in]   length              number of bytes to read
+ * @param[in]   intf_ptr            context of the sensor
+ *
+ * @return      result of the user bus read function
+ */
+static BME68X_INTF_RET_TYPE bme68x_bsec_bus_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t length,
+                                                 void *intf_ptr) {
+    bsec_iot_ctx_t *ctx = (bsec_iot_ctx_t *)intf_ptr;
+    uint8_t offset;
+    uint8_t burst_len;
+    BME68X_INTF_RET_TYPE rslt;
+
+    if (ctx->read_aborted) {
+        return BME68X_E_COM_FAIL;
+    }
+
+    /* Only SPI addresses carry the read bit, on I2C the registers beyond 0x80 are distinct from the burst ones */
+    if (ctx->bme68x.intf == BME68X_SPI_INTF) {
+        offset = (uint8_t)((reg_addr & ~BME68X_SPI_RD_MSK) - BME68X_REG_FIELD0);
+    } else {
+        offset = (uint8_t)(reg_addr - BME68X_REG_FIELD0);
+    }
+    /* Bytes the burst holds, or is about to hold once read */
+    burst_len = (ctx->burst_len != 0) ? ctx->burst_len : BSEC_IOT_BURST_LEN;
+
+    /* All the registers of the burst are on the same SPI memory page, which the sensor API already selected */
+    if (ctx->read_burst && offset < burst_len && length <= (uint32_t)(burst_len - offset)) {
+        if (ctx->burst_len == 0) {
+            ctx->bus_stats.n_reads++;
+            ctx->bus_stats.n_bytes_read += BSEC_IOT_BURST_LEN;
+            rslt = ctx->bus_read(bme68x_bsec_burst_addr(ctx), ctx->burst, BSEC_IOT_BURST_LEN, ctx->intf_ptr);
+            if (rslt != BME68X_INTF_RET_SUCCESS) {
+                return rslt;
+            }
+            ctx->burst_len = BSEC_IOT_BURST_LEN;
+        } else {
+            ctx->bus_stats.n_transfers_saved++;
+        }
+
+        memcpy(reg_data, &ctx->burst[offset], length);
+        return BME68X_INTF_RET_SUCCESS;
+    }
+
+    ctx->bus_stats.n_reads++;
+    ctx->bus_stats.n_bytes_read += length;
+
+    return ctx->bus_read(reg_addr, reg_data, length, ctx->intf_ptr);
+}
+
+/*!
+ * @brief       Bus write function handed to the sensor API, counts the transfer and forwards it to the user function
+ *
+ * @param[in]   reg_addr            register address
+ * @param[in]   reg_data            register data to write
+ * @param[in]   length              number of bytes to write
+ * @param[in]   intf_ptr            context of the sensor
+ *
+ * @return      result of the user bus write function
+ */
+static BME68X_INTF_RET_TYPE bme68x_bsec_bus_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t length,
+                                                  void *intf_ptr) {
+    bsec_iot_ctx_t *ctx = (bsec_iot_ctx_t *)intf_ptr;
+
+    ctx->bus_stats.n_writes++;
+    ctx->bus_stats.n_bytes_written += length;
+
+    return ctx->bus_write(reg_addr, reg_data, length, ctx->intf_ptr);
+}
+
+/*!
+ * @brief       Sleep function handed to the sensor API, forwards the user interface pointer to the user function
+ *
+ * @param[in]   period              time to sleep in microseconds
+ * @param[in]   intf_ptr            context of the sensor
+ *
+ * @return      none
+ */
+static void bme68x_bsec_delay_us(uint32_t period, void *intf_ptr) {
+    bsec_iot_ctx_t *ctx = (bsec_iot_ctx_t *)intf_ptr;
+
+    /* The sensor API waits for new data while reading it. When the read is only meant to check for completion,
+     * abort it instead: the following bus reads fail without touching the bus and bme68x_get_data() returns. */
+    if (ctx->read_nonblocking) {
+        ctx->read_aborted = 1;
+        return;
+    }
+
+    /* The sensor API reads the data registers again after waiting, they are fetched anew */
+    ctx->burst_len = 0;
+    ctx->activity.delay_us += period;
+    ctx->sleep(period, ctx->intf_ptr);
+}
+
+/*!
+ * @brief       Number of bus transfers done so far for a sensor
+ *
+ * @param[in]   ctx                 context of the sensor
+ *
+ * @return      number of reads and writes
+ */
+static uint32_t bme68x_bsec_bus_transfers(const bsec_iot_ctx_t *ctx) {
+    return ctx->bus_stats.n_reads + ctx->bus_stats.n_writes;
+}
+
+/*!
+ * @brief       Time base of the instrumentation and of the boot timing, independent from the timestamps handed over by
+ *              the application
+ *
+ * @return      time in microseconds
+ */
+static int64_t bme68x_bsec_stat_now_us(void) {
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/*!
+ * @brief       Take or give back the lock of a sensor, if it has one
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   take                non-zero to take the lock, zero to give it back
+ *
+ * @return      none
+ */
+static void bme68x_bsec_lock(const bsec_iot_ctx_t *ctx, uint8_t take) {
+    if (ctx->lock != NULL) {
+        ctx->lock(ctx->lock_arg, take);
+    }
+}
+
+/*!
+ * @brief       Add the time spent running since a start to the activity of a sensor, leaving out the delays
+ *
+ * The time is added under the lock of the sensor, the processing of a pipeline accounting for its own from the other
+ * task.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   start_us            time (in microseconds) the work started at
+ * @param[in]   delay_us            time (in microseconds) spent waiting through the sleep function since then
+ *
+ * @return      none
+ */
+static void bme68x_bsec_account_cpu(bsec_iot_ctx_t *ctx, int64_t start_us, int64_t delay_us) {
+    int64_t cpu_us = (bme68x_bsec_stat_now_us() - start_us) - delay_us;
+
+    bme68x_bsec_lock(ctx, 1);
+    ctx->activity.cpu_us += cpu_us;
+    bme68x_bsec_lock(ctx, 0);
+}
+
+#if BSEC_IOT_INSTRUMENT
+/*!
+ * @brief       Add a duration to a cumulative time and its maximum
+ *
+ * @param[in]   start_us            time (in microseconds) the measured work started at
+ * @param[in,out] total_us          cumulative time
+ * @param[in,out] max_us            longest duration
+ *
+ * @return      none
+ */
+static void bme68x_bsec_stat_time(int64_t start_us, int64_t *total_us, uint32_t *max_us) {
+    int64_t duration = bme68x_bsec_stat_now_us() - start_us;
+
+    *total_us += duration;
+    if (duration > *max_us) {
+        *max_us = (uint32_t)duration;
+    }
+}
+#endif
+
+/*!
+ * @brief       Account for the result of a sensor API call
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   bme68x_status       result of the call
+ *
+ * @return      none
+ */
+static void bme68x_bsec_stat_status(bsec_iot_ctx_t *ctx, int8_t bme68x_status) {
+#if BSEC_IOT_INSTRUMENT
+    if (bme68x_status != BME68X_OK) {
+        ctx->stats.last_bme68x_status = bme68x_status;
+        if (bme68x_status < BME68X_OK) {
+            ctx->stats.n_bme68x_errors++;
+        }
+    }
+#else
+    (void)ctx;
+    (void)bme68x_status;
+#endif
+}
+
+/*!
+ * @brief       Change the virtual sensors BSEC computes for a sensor, and the rate of each of them, the lock of the
+ *              sensor being held or not needed
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   requested           virtual sensors and their sample rates
+ * @param[in]   n_requested         number of entries in requested
+ *
+ * @return      result of bsec_update_subscription()
+ */
+static bsec_library_return_t bme68x_bsec_subscribe(bsec_iot_ctx_t *ctx, const bsec_sensor_configuration_t *requested,
+                                                   uint8_t n_requested) {
+    bsec_sensor_configuration_t required_sensor_settings[BSEC_MAX_PHYSICAL_SENSOR];
+    uint8_t n_required_sensor_settings = BSEC_MAX_PHYSICAL_SENSOR;
+    bsec_library_return_t bsec_status;
+    uint8_t id;
+    uint8_t i;
+
+    bsec_status = bsec_update_subscription_m(ctx->bsec_inst, requested, n_requested, required_sensor_settings,
+                                             &n_required_sensor_settings);
+    if (bsec_status != BSEC_OK) {
+        return bsec_status;
+    }
+
+    /* Virtual sensors left out of the request keep their previous subscription */
+    for (i = 0; i < n_requested; i++) {
+        if (requested[i].sensor_id >= sizeof(bsec_iot_output_ids) || bsec_iot_output_ids[requested[i].sensor_id] == 0) {
+            continue;
+        }
+        id = bsec_iot_output_ids[requested[i].sensor_id] - 1;
+        if (requested[i].sample_rate == BSEC_SAMPLE_RATE_DISABLED) {
+            ctx->subscribed_mask &= ~BSEC_IOT_OUTPUT_MASK(id);
+        } else {
+            ctx->subscribed_mask |= BSEC_IOT_OUTPUT_MASK(id);
+            /* A single measurement on demand leaves the output at its rate */
+            if (requested[i].sample_rate != BSEC_SAMPLE_RATE_ULP_MEASUREMENT_ON_DEMAND) {
+                ctx->output_rate[id] = requested[i].sample_rate;
+            }
+        }
+    }
+
+    return bsec_status;
+}
+
+/*!
+ * @brief        Virtual sensor subscription by default, when bsec_iot_init() is given no list
  *               Please call this function before processing of data using bsec_do_steps function
  *
+ * @param[in]    ctx                 context of the sensor
  * @param[in]    sample_rate         mode to be used (either BSEC_SAMPLE_RATE_ULP or BSEC_SAMPLE_RATE_LP)
  *
  * @return       subscription result, zero when successful
  */
-static bsec_library_return_t bme68x_bsec_update_subscription(float sample_rate) {
+static bsec_library_return_t bme68x_bsec_update_subscription(bsec_iot_ctx_t *ctx, float sample_rate) {
     bsec_sensor_configuration_t requested_virtual_sensors[NUM_USED_OUTPUTS];
     uint8_t n_requested_virtual_sensors = NUM_USED_OUTPUTS;
+    uint8_t i;
 
-    bsec_sensor_configuration_t required_sensor_settings[BSEC_MAX_PHYSICAL_SENSOR];
-    uint8_t n_required_sensor_settings = BSEC_MAX_PHYSICAL_SENSOR;
+    /* BME688 gas scanning: the gas estimates of the trained classes, along with the raw signals they are based on */
+    if (sample_rate == BSEC_SAMPLE_RATE_SCAN) {
+        requested_virtual_sensors[0].sensor_id = BSEC_OUTPUT_GAS_ESTIMATE_1;
+        requested_virtual_sensors[1].sensor_id = BSEC_OUTPUT_GAS_ESTIMATE_2;
+        requested_virtual_sensors[2].sensor_id = BSEC_OUTPUT_GAS_ESTIMATE_3;
+        requested_virtual_sensors[3].sensor_id = BSEC_OUTPUT_GAS_ESTIMATE_4;
+        requested_virtual_sensors[4].sensor_id = BSEC_OUTPUT_RAW_GAS_INDEX;
+        requested_virtual_sensors[5].sensor_id = BSEC_OUTPUT_RAW_TEMPERATURE;
+        requested_virtual_sensors[6].sensor_id = BSEC_OUTPUT_RAW_PRESSURE;
+        requested_virtual_sensors[7].sensor_id = BSEC_OUTPUT_RAW_HUMIDITY;
+        requested_virtual_sensors[8].sensor_id = BSEC_OUTPUT_RAW_GAS;
+        n_requested_virtual_sensors = 9;
+        for (i = 0; i < n_requested_virtual_sensors; i++) {
+            requested_virtual_sensors[i].sample_rate = sample_rate;
+        }
 
-    bsec_library_return_t status = BSEC_OK;
+        return bme68x_bsec_subscribe(ctx, requested_virtual_sensors, n_requested_virtual_sensors);
+    }
 
     /* note: Virtual sensors as desired to be added here */
     requested_virtual_sensors[0].sensor_id = BSEC_OUTPUT_IAQ;
@@ -69,348 +409,1720 @@ static bsec_library_return_t bme68x_bsec_update_subscription(float sample_rate)
 
 
     /* Call bsec_update_subscription() to enable/disable the requested virtual sensors */
-    status = bsec_update_subscription(requested_virtual_sensors, n_requested_virtual_sensors, required_sensor_settings,
-                                      &n_required_sensor_settings);
+    return bme68x_bsec_subscribe(ctx, requested_virtual_sensors, n_requested_virtual_sensors);
+}
+
+/*!
+ * @brief       Size of the arena needed by a number of sensors
+ *
+ * @param[in]   n_sensors           number of sensors sharing the arena
+ *
+ * @return      size of the arena (in bytes)
+ */
+uint32_t bsec_iot_arena_size(uint8_t n_sensors) {
+    return BSEC_IOT_ARENA_SCRATCH_SIZE + n_sensors * ((bsec_get_instance_size_m() + 3) & ~3);
+}
+
+/*!
+ * @brief       Set up an arena from memory provided by the application
+ *
+ * @param[out]  arena               arena to set up
+ * @param[in]   mem                 memory of the arena, aligned on 4 bytes
+ * @param[in]   size                size of the memory
+ *
+ * @return      none
+ */
+void bsec_iot_arena_init(bsec_iot_arena_t *arena, void *mem, uint32_t size) {
+    arena->mem = mem;
+    arena->size = size;
+    arena->used = BSEC_IOT_ARENA_SCRATCH_SIZE;
+    arena->lock = NULL;
+    arena->lock_arg = NULL;
+}
+
+/*!
+ * @brief       Set the function serializing the uses of the scratch area of an arena from different tasks
+ *
+ * @param[in]   arena               arena of the sensors
+ * @param[in]   lock                pointer to the lock function, NULL for none
+ * @param[in]   lock_arg            pointer handed to the lock function
+ *
+ * @return      none
+ */
+void bsec_iot_arena_set_lock(bsec_iot_arena_t *arena, ctx_lock_fct lock, void *lock_arg) {
+    arena->lock = lock;
+    arena->lock_arg = lock_arg;
+}
+
+/*!
+ * @brief       Take or give back the scratch area of an arena, if it has a lock
+ *
+ * @param[in]   arena               arena of the sensors
+ * @param[in]   take                non-zero to take the scratch area, zero to give it back
+ *
+ * @return      none
+ */
+static void bme68x_bsec_arena_lock(const bsec_iot_arena_t *arena, uint8_t take) {
+    if (arena->lock != NULL) {
+        arena->lock(arena->lock_arg, take);
+    }
+}
 
-    return status;
+/*!
+ * @brief       Clear a context, take its BSEC instance from the arena and hook the sensor API to the bus functions
+ *
+ * @param[out]  ctx                 context of the sensor
+ * @param[in]   intf                bus the sensor is on
+ * @param[in]   dev_addr            I2C address of the sensor, or index of its chip select on SPI
+ * @param[in]   intf_ptr            pointer handed to the bus functions, NULL to hand a pointer to ctx->dev_addr
+ * @param[in]   bus_write           pointer to the bus writing function
+ * @param[in]   bus_read            pointer to the bus reading function
+ * @param[in]   sleep               pointer to the system specific sleep function
+ * @param[in]   arena               arena the BSEC instance of the sensor is taken from
+ *
+ * @return      BSEC_OK, BSEC_E_CONFIG_INSUFFICIENTBUFFER if the arena is full
+ */
+static bsec_library_return_t bme68x_bsec_setup(bsec_iot_ctx_t *ctx, enum bme68x_intf intf, uint8_t dev_addr,
+                                               void *intf_ptr, bme68x_write_fptr_t bus_write,
+                                               bme68x_read_fptr_t bus_read, bme68x_delay_us_fptr_t sleep,
+                                               bsec_iot_arena_t *arena) {
+    uint32_t inst_size = (bsec_get_instance_size_m() + 3) & ~3;
+    void *user_data = ctx->user_data;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->user_data = user_data;
+    ctx->dev_addr = dev_addr;
+    ctx->boot_start_us = bme68x_bsec_stat_now_us();
+
+    /* Take the BSEC instance from the arena */
+    if (arena->used + inst_size > arena->size) {
+        return BSEC_E_CONFIG_INSUFFICIENTBUFFER;
+    }
+    ctx->arena = arena;
+    ctx->bsec_inst = arena->mem + arena->used;
+    arena->used += inst_size;
+
+    /* User configurable bus configuration, the bus functions tell the sensors apart through the interface pointer */
+    ctx->intf_ptr = (intf_ptr != NULL) ? intf_ptr : &ctx->dev_addr;
+    ctx->bus_write = bus_write;
+    ctx->bus_read = bus_read;
+    ctx->sleep = sleep;
+
+    /* The sensor API talks to the bus through the context so that the transfers can be accounted for */
+    ctx->bme68x.intf = intf;
+    ctx->bme68x.intf_ptr = ctx;
+    ctx->bme68x.write = bme68x_bsec_bus_write;
+    ctx->bme68x.read = bme68x_bsec_bus_read;
+    ctx->bme68x.delay_us = bme68x_bsec_delay_us;
+
+    ctx->completion_margin_us = BSEC_IOT_INITIAL_MARGIN_US;
+
+    return BSEC_OK;
 }
 
 /*!
- * @brief       Initialize the BME68X sensor and the BSEC library
+ * @brief       Initialize one BME68X sensor and its BSEC instance
  *
+ * @param[out]  ctx                 context of the sensor to initialize
+ * @param[in]   intf                bus the sensor is on (BME68X_I2C_INTF or BME68X_SPI_INTF)
+ * @param[in]   dev_addr            I2C address of the sensor, or index of its chip select on SPI
+ * @param[in]   intf_ptr            pointer handed to the bus functions, NULL to hand a pointer to ctx->dev_addr
  * @param[in]   sample_rate         mode to be used (either BSEC_SAMPLE_RATE_ULP or BSEC_SAMPLE_RATE_LP)
+ * @param[in]   requested           virtual sensors and their sample rates, NULL for the default outputs at sample_rate
+ * @param[in]   n_requested         number of entries in requested
  * @param[in]   temperature_offset  device-specific temperature offset (due to self-heating)
  * @param[in]   bus_write           pointer to the bus writing function
  * @param[in]   bus_read            pointer to the bus reading function
  * @param[in]   sleep               pointer to the system specific sleep function
  * @param[in]   state_load          pointer to the system-specific state load function
  * @param[in]   config_load         pointer to the system-specific config load function
+ * @param[in]   arena               arena the BSEC instance of the sensor is taken from
  *
  * @return      zero if successful, negative otherwise
  */
-return_values_init bsec_iot_init(float sample_rate, float temperature_offset, bme68x_write_fptr_t bus_write,
-                                 bme68x_read_fptr_t bus_read, bme68x_delay_us_fptr_t sleep, state_load_fct state_load,
-                                 config_load_fct config_load) {
+return_values_init bsec_iot_init(bsec_iot_ctx_t *ctx, enum bme68x_intf intf, uint8_t dev_addr, void *intf_ptr,
+                                 float sample_rate, const bsec_sensor_configuration_t *requested, uint8_t n_requested,
+                                 float temperature_offset, bme68x_write_fptr_t bus_write, bme68x_read_fptr_t bus_read,
+                                 bme68x_delay_us_fptr_t sleep, state_load_fct state_load, config_load_fct config_load,
+                                 bsec_iot_arena_t *arena) {
     return_values_init ret = {BME68X_OK, BSEC_OK};
-    bsec_library_return_t bsec_status = BSEC_OK;
 
-    uint8_t bsec_state[BSEC_MAX_STATE_BLOB_SIZE] = {0};
-    uint8_t bsec_config[BSEC_MAX_PROPERTY_BLOB_SIZE] = {0};
-    uint8_t work_buffer[BSEC_MAX_WORKBUFFER_SIZE] = {0};
+    /* The configuration and the state are loaded one after the other through the scratch area of the arena */
+    uint8_t *bsec_blob = arena->mem;
+    uint8_t *work_buffer = arena->mem + (BSEC_IOT_ARENA_SCRATCH_SIZE - BSEC_MAX_WORKBUFFER_SIZE);
     int bsec_state_len, bsec_config_len;
+    int64_t load_start_us;
 
-    /* Fixed I2C configuration */
-    bme68x.variant_id = BME68X_I2C_ADDR_LOW;
-    bme68x.intf = BME68X_I2C_INTF;
-    /* User configurable I2C configuration */
-    bme68x.write = bus_write;
-    bme68x.read = bus_read;
-    bme68x.delay_us = sleep;
+    ret.bsec_status = bme68x_bsec_setup(ctx, intf, dev_addr, intf_ptr, bus_write, bus_read, sleep, arena);
+    if (ret.bsec_status != BSEC_OK) {
+        return ret;
+    }
 
     /* Initialize BME68X API */
-    ret.bme68x_status = bme68x_init(&bme68x);
+    ret.bme68x_status = bme68x_init(&ctx->bme68x);
     if (ret.bme68x_status != BME68X_OK) {
         return ret;
     }
 
     /* Initialize BSEC library */
-    ret.bsec_status = bsec_init();
+    ret.bsec_status = bsec_init_m(ctx->bsec_inst);
     if (ret.bsec_status != BSEC_OK) {
         return ret;
     }
 
-    /* Load library config, if available */
-    bsec_config_len = config_load(bsec_config, sizeof(bsec_config));
+    /* Load library config, if available, and fingerprint it for the state to be checked against */
+    load_start_us = bme68x_bsec_stat_now_us();
+    bme68x_bsec_arena_lock(arena, 1);
+    bsec_config_len = config_load(ctx, bsec_blob, BSEC_MAX_PROPERTY_BLOB_SIZE);
     if (bsec_config_len != 0) {
-        ret.bsec_status = bsec_set_configuration(bsec_config, bsec_config_len, work_buffer, sizeof(work_buffer));
-        if (ret.bsec_status != BSEC_OK) {
-            return ret;
-        }
+        ctx->boot.config_fingerprint = bsec_iot_crc32(0, bsec_blob, bsec_config_len);
+        ret.bsec_status = bsec_set_configuration_m(ctx->bsec_inst, bsec_blob, bsec_config_len, work_buffer,
+                                                   BSEC_MAX_WORKBUFFER_SIZE);
+    }
+    bme68x_bsec_arena_lock(arena, 0);
+    if (ret.bsec_status != BSEC_OK) {
+        return ret;
     }
 
+    ctx->boot.config_us = (uint32_t)(bme68x_bsec_stat_now_us() - load_start_us);
+
     /* Load previous library state, if available */
-    bsec_state_len = state_load(bsec_state, sizeof(bsec_state));
+    load_start_us = bme68x_bsec_stat_now_us();
+    bme68x_bsec_arena_lock(arena, 1);
+    bsec_state_len = state_load(ctx, bsec_blob, BSEC_MAX_STATE_BLOB_SIZE);
     if (bsec_state_len != 0) {
-        ret.bsec_status = bsec_set_state(bsec_state, bsec_state_len, work_buffer, sizeof(work_buffer));
-        if (ret.bsec_status != BSEC_OK) {
-            return ret;
-        }
+        ret.bsec_status = bsec_set_state_m(ctx->bsec_inst, bsec_blob, bsec_state_len, work_buffer,
+                                           BSEC_MAX_WORKBUFFER_SIZE);
+        ctx->boot.state_restored = (ret.bsec_status == BSEC_OK);
     }
+    bme68x_bsec_arena_lock(arena, 0);
+    if (ret.bsec_status != BSEC_OK) {
+        return ret;
+    }
+    ctx->boot.state_us = (uint32_t)(bme68x_bsec_stat_now_us() - load_start_us);
 
     /* Set temperature offset */
-    bme68x_temperature_offset_g = temperature_offset;
+    ctx->temperature_offset = temperature_offset;
 
     /* Call to the function which sets the library with subscription information */
-    ret.bsec_status = bme68x_bsec_update_subscription(sample_rate);
+    ctx->sample_rate = sample_rate;
+    if (requested != NULL) {
+        ret.bsec_status = bme68x_bsec_subscribe(ctx, requested, n_requested);
+    } else {
+        ret.bsec_status = bme68x_bsec_update_subscription(ctx, sample_rate);
+    }
     if (ret.bsec_status != BSEC_OK) {
         return ret;
     }
 
+    ctx->boot.init_us = (uint32_t)(bme68x_bsec_stat_now_us() - ctx->boot_start_us);
     return ret;
 }
 
+
 /*!
- * @brief       Trigger the measurement based on sensor settings
+ * @brief       Change the virtual sensors BSEC computes for a sensor, and the rate of each of them
  *
- * @param[in]   sensor_settings     settings of the BME68X sensor adopted by sensor control function
- * @param[in]   sleep               pointer to the system specific sleep function
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   requested           virtual sensors and their sample rates
+ * @param[in]   n_requested         number of entries in requested
  *
- * @return      none
+ * @return      result of bsec_update_subscription()
  */
-static void bme68x_bsec_trigger_measurement(bsec_bme_settings_t* sensor_settings, bme68x_delay_us_fptr_t sleep) {
-    uint16_t meas_period;
-    uint8_t set_required_settings;
-    int8_t bme68x_status = BME68X_OK;
-    struct bme68x_conf bme68x_sensor_settings;
-    struct bme68x_heatr_conf bme68x_heater_settings;
-
-    /* Check if a forced-mode measurement should be triggered now */
-    if (sensor_settings->trigger_measurement) {
-        /* Set sensor configuration */
-
-        bme68x_sensor_settings.os_hum = sensor_settings->humidity_oversampling;
-        bme68x_sensor_settings.os_pres = sensor_settings->pressure_oversampling;
-        bme68x_sensor_settings.os_temp = sensor_settings->temperature_oversampling;
-
-        bme68x_heater_settings.enable = sensor_settings->run_gas;
-        bme68x_heater_settings.heatr_temp  = sensor_settings->heater_temperature; /* degree Celsius */
-        bme68x_heater_settings.heatr_dur = sensor_settings->heater_duration;    /* milliseconds */
-
-        /* Set the desired sensor configuration */
-        bme68x_status = bme68x_set_conf(&bme68x_sensor_settings, &bme68x);
+bsec_library_return_t bsec_iot_update_subscription(bsec_iot_ctx_t *ctx, const bsec_sensor_configuration_t *requested,
+                                                   uint8_t n_requested) {
+    bsec_library_return_t bsec_status;
 
-        /* Set the desired heater configuration */
-        bme68x_status = bme68x_set_heatr_conf(BME68X_FORCED_MODE, &bme68x_heater_settings, &bme68x);
+    /* Called from output_ready, this runs on the processing task of a pipeline while bsec_iot_step() goes on */
+    bme68x_bsec_lock(ctx, 1);
+    bsec_status = bme68x_bsec_subscribe(ctx, requested, n_requested);
+    bme68x_bsec_lock(ctx, 0);
 
-        /* Set power mode as forced mode and trigger forced mode measurement */
-        bme68x_status = bme68x_set_op_mode(BME68X_FORCED_MODE, &bme68x);
+    return bsec_status;
+}
 
-        /* Get the total measurement duration so as to sleep or wait till the measurement is complete */
-        meas_period = bme68x_get_meas_dur(BME68X_FORCED_MODE, &bme68x_sensor_settings, &bme68x);
+/*!
+ * @brief       Switch all the subscribed outputs of a sensor to the given sample rate
+ *
+ * The caller holds the lock of the sensor, if it needs one.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   sample_rate         new sample rate of the subscribed outputs
+ *
+ * @return      result of bsec_update_subscription()
+ */
+static bsec_library_return_t bme68x_bsec_set_rate(bsec_iot_ctx_t *ctx, float sample_rate) {
+    bsec_sensor_configuration_t requested_virtual_sensors[BSEC_IOT_NUM_OUTPUTS];
+    uint8_t n_requested_virtual_sensors = 0;
+    bsec_library_return_t bsec_status;
+    uint8_t sensor_id;
 
-        /* Delay till the measurement is ready. Timestamp resolution in us */
-        sleep((uint32_t)meas_period, bme68x.intf_ptr);
+    for (sensor_id = 0; sensor_id < sizeof(bsec_iot_output_ids); sensor_id++) {
+        if (bsec_iot_output_ids[sensor_id] != 0 &&
+            (ctx->subscribed_mask & BSEC_IOT_OUTPUT_MASK(bsec_iot_output_ids[sensor_id] - 1))) {
+            requested_virtual_sensors[n_requested_virtual_sensors].sensor_id = sensor_id;
+            requested_virtual_sensors[n_requested_virtual_sensors].sample_rate = sample_rate;
+            n_requested_virtual_sensors++;
+        }
     }
 
-    /* Call the API to get current operation mode of the sensor */
-    uint8_t opmode;
-    bme68x_status = bme68x_get_op_mode(&opmode, &bme68x);
-    /* When the measurement is completed and data is ready for reading, the sensor must be in BME68X_SLEEP_MODE.
-     * Read operation mode to check whether measurement is completely done and wait until the sensor is no more
-     * in BME68X_FORCED_MODE. */
-    while (opmode == BME68X_FORCED_MODE) {
-        /* sleep for 5 ms */
-        sleep(5000, bme68x.intf_ptr);
-        bme68x_status = bme68x_get_op_mode(&opmode, &bme68x);
+    bsec_status = bme68x_bsec_subscribe(ctx, requested_virtual_sensors, n_requested_virtual_sensors);
+    if (bsec_status == BSEC_OK && sample_rate != BSEC_SAMPLE_RATE_ULP_MEASUREMENT_ON_DEMAND) {
+        ctx->sample_rate = sample_rate;
     }
+
+    return bsec_status;
 }
 
 /*!
- * @brief       Read the data from registers and populate the inputs structure to be passed to do_steps function
+ * @brief       Ask for the next call to bsec_sensor_control() to be brought forward to now
  *
- * @param[in]   time_stamp_trigger      settings of the sensor returned from sensor control function
- * @param[in]   inputs                  input structure containing the information on sensors to be passed to do_steps
- * @param[in]   num_bsec_inputs         number of inputs to be passed to do_steps
- * @param[in]   bsec_process_data       process data variable returned from sensor_control
+ * Only posts the request: the processing may run on another task than bsec_iot_step(), which applies it.
+ *
+ * @param[in]   ctx                 context of the sensor
  *
  * @return      none
  */
-static void bme68x_bsec_read_data(int64_t time_stamp_trigger, bsec_input_t* inputs, uint8_t* num_bsec_inputs,
-                                  int32_t bsec_process_data) {
-    static struct bme68x_data data;
-    int8_t bme68x_status = BME68X_OK;
-    uint8_t n_data;
-
-    /* We only have to read data if the previous call the bsec_sensor_control() actually asked for it */
-    if (bsec_process_data) {
-        bme68x_status = bme68x_get_data(BME68X_FORCED_MODE, &data, &n_data, &bme68x);
-
-        if (data.status & BME68X_NEW_DATA_MSK) {
-            /* Pressure to be processed by BSEC */
-            if (bsec_process_data & BSEC_PROCESS_PRESSURE) {
-                /* Place presssure sample into input struct */
-                inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_PRESSURE;
-                inputs[*num_bsec_inputs].signal = data.pressure;
-                inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
-                (*num_bsec_inputs)++;
-            }
-            /* Temperature to be processed by BSEC */
-            if (bsec_process_data & BSEC_PROCESS_TEMPERATURE) {
-                /* Place temperature sample into input struct */
-                inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_TEMPERATURE;
-#ifdef BME68X_USE_FPU
-                inputs[*num_bsec_inputs].signal = data.temperature;
-#else
-                inputs[*num_bsec_inputs].signal = data.temperature / 100.0f;
-#endif
-                inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
-                (*num_bsec_inputs)++;
-
-                /* Also add optional heatsource input which will be subtracted from the temperature reading to
-                 * compensate for device-specific self-heating (supported in BSEC IAQ solution)*/
-                inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_HEATSOURCE;
-                inputs[*num_bsec_inputs].signal = bme68x_temperature_offset_g;
-                inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
-                (*num_bsec_inputs)++;
-            }
-            /* Humidity to be processed by BSEC */
-            if (bsec_process_data & BSEC_PROCESS_HUMIDITY) {
-                /* Place humidity sample into input struct */
-                inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_HUMIDITY;
-#ifdef BME68X_USE_FPU
-                inputs[*num_bsec_inputs].signal = data.humidity;
-#else
-                inputs[*num_bsec_inputs].signal = data.humidity / 1000.0f;
-#endif
-                inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
-                (*num_bsec_inputs)++;
-            }
-            /* Gas to be processed by BSEC */
-            if (bsec_process_data & BSEC_PROCESS_GAS) {
-                /* Check whether gas_valid flag is set */
-                if (data.status & BME68X_GASM_VALID_MSK) {
-                    /* Place sample into input struct */
-                    inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_GASRESISTOR;
-                    inputs[*num_bsec_inputs].signal = data.gas_resistance;
-                    inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
-                    (*num_bsec_inputs)++;
-                }
-            }
-        }
-    }
+static void bme68x_bsec_request_control(bsec_iot_ctx_t *ctx) {
+    __atomic_store_n(&ctx->control_requested, 1, __ATOMIC_RELEASE);
 }
 
 /*!
- * @brief       This function is written to process the sensor data for the requested virtual sensors
+ * @brief       Bring the next call to bsec_sensor_control() forward to now if it was asked for
  *
- * @param[in]   bsec_inputs         input structure containing the information on sensors to be passed to do_steps
- * @param[in]   num_bsec_inputs     number of inputs to be passed to do_steps
- * @param[in]   output_ready        pointer to the function processing obtained BSEC outputs
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
  *
- * @return      none
+ * @return      non-zero if the deadline of the sensor was brought forward
  */
-static void bme68x_bsec_process_data(bsec_input_t* bsec_inputs, uint8_t num_bsec_inputs,
-                                     output_ready_fct output_ready) {
-    /* Output buffer set to the maximum virtual sensor outputs supported */
+uint8_t bsec_iot_apply_control(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    if (!__atomic_exchange_n(&ctx->control_requested, 0, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    /* The cycle brought forward starts a new schedule rather than being late or early on the current one */
+    if (ctx->next_call > now_us * 1000) {
+        ctx->next_call = 0;
+    }
+    if (ctx->phase == BSEC_IOT_PHASE_CONTROL && now_us < ctx->deadline) {
+        ctx->deadline = now_us;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       Enter LP mode, or stay in it, until the hold-off has passed
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      result of bsec_update_subscription()
+ */
+static bsec_library_return_t bme68x_bsec_escalate(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    bsec_library_return_t bsec_status = BSEC_OK;
+
+    ctx->lp_until = now_us + (int64_t)ctx->adaptive.hold_off_s * 1000000;
+    if (ctx->sample_rate != BSEC_SAMPLE_RATE_LP) {
+        bsec_status = bme68x_bsec_set_rate(ctx, BSEC_SAMPLE_RATE_LP);
+        if (bsec_status == BSEC_OK) {
+            ctx->n_rate_switches++;
+            /* Do not wait for the rest of the ULP period before taking the first LP sample */
+            bme68x_bsec_request_control(ctx);
+        }
+    }
+
+    return bsec_status;
+}
+
+/*!
+ * @brief       Adapt the sample rate of a sensor to the change rate of its outputs
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output              outputs of the last processing step
+ *
+ * @return      none
+ */
+static void bme68x_bsec_adapt_rate(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    int64_t now_us = output->timestamp / 1000;
+    float minutes;
+    uint8_t escalate = 0;
+
+    if (!(output->valid_mask & BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_IAQ))) {
+        return;
+    }
+
+    /* Slopes (per minute) since the previous sample, the first sample has none */
+    if (ctx->slope_time > 0 && now_us > ctx->slope_time) {
+        minutes = (float)(now_us - ctx->slope_time) / 60e6f;
+        if (ctx->adaptive.iaq_slope > 0.0f &&
+            fabsf(output->value[BSEC_IOT_OUTPUT_IAQ] - ctx->slope_iaq) > ctx->adaptive.iaq_slope * minutes) {
+            escalate = 1;
+        }
+        if (ctx->adaptive.voc_slope > 0.0f &&
+            (output->valid_mask & BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT)) &&
+            fabsf(output->value[BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT] - ctx->slope_voc) >
+            ctx->adaptive.voc_slope * minutes) {
+            escalate = 1;
+        }
+    }
+    ctx->slope_time = now_us;
+    ctx->slope_iaq = output->value[BSEC_IOT_OUTPUT_IAQ];
+    ctx->slope_voc = output->value[BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT];
+
+    if (escalate) {
+        bme68x_bsec_escalate(ctx, now_us);
+    } else if (ctx->sample_rate == BSEC_SAMPLE_RATE_LP && now_us >= ctx->lp_until) {
+        /* Air quality stable for the whole hold-off, fall back to ULP */
+        if (bme68x_bsec_set_rate(ctx, BSEC_SAMPLE_RATE_ULP) == BSEC_OK) {
+            ctx->n_rate_switches++;
+        }
+    }
+}
+
+/*!
+ * @brief       Let the sample rate of a sensor switch between ULP and LP depending on the air quality changes
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   adaptive            thresholds and hold-off, NULL to keep the current sample rate from now on
+ *
+ * @return      result of bsec_update_subscription()
+ */
+bsec_library_return_t bsec_iot_set_adaptive(bsec_iot_ctx_t *ctx, const bsec_iot_adaptive_t *adaptive) {
+    bsec_library_return_t bsec_status = BSEC_OK;
+
+    bme68x_bsec_lock(ctx, 1);
+    if (adaptive == NULL) {
+        ctx->adaptive_enabled = 0;
+    } else {
+        ctx->adaptive = *adaptive;
+        ctx->adaptive_enabled = 1;
+        ctx->slope_time = 0;
+        ctx->lp_until = 0;
+
+        /* Start in ULP, the first samples tell whether LP is needed */
+        if (ctx->sample_rate != BSEC_SAMPLE_RATE_ULP) {
+            bsec_status = bme68x_bsec_set_rate(ctx, BSEC_SAMPLE_RATE_ULP);
+        }
+    }
+    bme68x_bsec_lock(ctx, 0);
+
+    return bsec_status;
+}
+
+/*!
+ * @brief       Switch a sensor in adaptive mode to LP right away, e.g. when a window is opened or presence is detected
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      result of bsec_update_subscription()
+ */
+bsec_library_return_t bsec_iot_trigger_lp(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    bsec_library_return_t bsec_status;
+
+    if (!ctx->adaptive_enabled) {
+        return BSEC_OK;
+    }
+
+    bme68x_bsec_lock(ctx, 1);
+    bsec_status = bme68x_bsec_escalate(ctx, now_us);
+    bme68x_bsec_lock(ctx, 0);
+    bsec_iot_apply_control(ctx, now_us);
+
+    return bsec_status;
+}
+
+/*!
+ * @brief       Request a single measurement out of the ULP schedule
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      result of bsec_update_subscription()
+ */
+bsec_library_return_t bsec_iot_measure_on_demand(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    bsec_library_return_t bsec_status = BSEC_OK;
+
+    /* LP samples come often enough on their own */
+    if (ctx->sample_rate != BSEC_SAMPLE_RATE_ULP) {
+        return BSEC_OK;
+    }
+
+    bme68x_bsec_lock(ctx, 1);
+    bsec_status = bme68x_bsec_set_rate(ctx, BSEC_SAMPLE_RATE_ULP_MEASUREMENT_ON_DEMAND);
+    bme68x_bsec_lock(ctx, 0);
+    if (bsec_status == BSEC_OK) {
+        bme68x_bsec_request_control(ctx);
+        bsec_iot_apply_control(ctx, now_us);
+    }
+
+    return bsec_status;
+}
+
+/*!
+ * @brief       Write the sensor configuration, unless the sensor already has it
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   conf                sensor configuration
+ *
+ * @return      result of bme68x_set_conf(), BME68X_OK when skipped
+ */
+static int8_t bme68x_bsec_set_conf(bsec_iot_ctx_t *ctx, struct bme68x_conf *conf) {
+    int8_t bme68x_status = BME68X_OK;
+    uint32_t n_transfers;
+
+    if ((ctx->shadow_valid & BSEC_IOT_SHADOW_CONF) && memcmp(conf, &ctx->conf_shadow, sizeof(*conf)) == 0) {
+        ctx->bus_stats.n_config_writes_skipped++;
+        ctx->bus_stats.n_transfers_saved += ctx->conf_shadow_cost;
+        return BME68X_OK;
+    }
+
+    n_transfers = bme68x_bsec_bus_transfers(ctx);
+    ctx->shadow_valid &= ~BSEC_IOT_SHADOW_CONF;
+    bme68x_status = bme68x_set_conf(conf, &ctx->bme68x);
+    if (bme68x_status == BME68X_OK) {
+        ctx->conf_shadow = *conf;
+        ctx->conf_shadow_cost = bme68x_bsec_bus_transfers(ctx) - n_transfers;
+        ctx->shadow_valid |= BSEC_IOT_SHADOW_CONF;
+    }
+
+    return bme68x_status;
+}
+
+/*!
+ * @brief       Write the forced mode heater configuration, unless the sensor already has it
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   heatr_conf          heater configuration
+ *
+ * @return      result of bme68x_set_heatr_conf(), BME68X_OK when skipped
+ */
+static int8_t bme68x_bsec_set_heatr_conf(bsec_iot_ctx_t *ctx, struct bme68x_heatr_conf *heatr_conf) {
+    int8_t bme68x_status = BME68X_OK;
+    uint32_t n_transfers;
+
+    if ((ctx->shadow_valid & BSEC_IOT_SHADOW_HEATR) && heatr_conf->enable == ctx->heatr_shadow.enable &&
+        heatr_conf->heatr_temp == ctx->heatr_shadow.heatr_temp &&
+        heatr_conf->heatr_dur == ctx->heatr_shadow.heatr_dur) {
+        ctx->bus_stats.n_config_writes_skipped++;
+        ctx->bus_stats.n_transfers_saved += ctx->heatr_shadow_cost;
+        return BME68X_OK;
+    }
+
+    n_transfers = bme68x_bsec_bus_transfers(ctx);
+    ctx->shadow_valid &= ~BSEC_IOT_SHADOW_HEATR;
+    bme68x_status = bme68x_set_heatr_conf(BME68X_FORCED_MODE, heatr_conf, &ctx->bme68x);
+    if (bme68x_status == BME68X_OK) {
+        ctx->heatr_shadow = *heatr_conf;
+        ctx->heatr_shadow_cost = bme68x_bsec_bus_transfers(ctx) - n_transfers;
+        ctx->shadow_valid |= BSEC_IOT_SHADOW_HEATR;
+    }
+
+    return bme68x_status;
+}
+
+/*!
+ * @brief       Trigger the measurement based on sensor settings
+ *
+ * The sensor and heater configurations are only written when they differ from the shadow of what was last written
+ * successfully, which is the common case in LP and ULP mode where the settings do not change between samples. In
+ * parallel mode the sensor keeps measuring along the heater profile on its own, so it is only configured when BSEC
+ * switches to that mode.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   sensor_settings     settings of the BME68X sensor adopted by sensor control function
+ *
+ * @return      time (in microseconds) after which the forced mode measurement is expected to be complete, zero if none
+ *              was started
+ */
+static uint32_t bme68x_bsec_trigger_measurement(bsec_iot_ctx_t *ctx, bsec_bme_settings_t* sensor_settings) {
+    uint32_t meas_period = 0;
+    int8_t bme68x_status = BME68X_OK;
+    uint8_t reg_addr;
+    uint8_t ctrl_meas;
+    struct bme68x_conf bme68x_sensor_settings;
+    struct bme68x_heatr_conf bme68x_heater_settings = {0};
+
+    /* Set sensor configuration */
+    bme68x_sensor_settings.os_hum = sensor_settings->humidity_oversampling;
+    bme68x_sensor_settings.os_pres = sensor_settings->pressure_oversampling;
+    bme68x_sensor_settings.os_temp = sensor_settings->temperature_oversampling;
+    bme68x_sensor_settings.filter = BME68X_FILTER_OFF;
+    bme68x_sensor_settings.odr = BME68X_ODR_NONE;
+
+    /* Check if a forced-mode measurement should be triggered now */
+    if (sensor_settings->trigger_measurement && sensor_settings->op_mode == BME68X_FORCED_MODE) {
+        bme68x_heater_settings.enable = sensor_settings->run_gas;
+        bme68x_heater_settings.heatr_temp  = sensor_settings->heater_temperature; /* degree Celsius */
+        bme68x_heater_settings.heatr_dur = sensor_settings->heater_duration;    /* milliseconds */
+
+        /* Set the desired sensor configuration */
+        bme68x_status = bme68x_bsec_set_conf(ctx, &bme68x_sensor_settings);
+
+        /* Set the desired heater configuration */
+        if (bme68x_status == BME68X_OK) {
+            bme68x_status = bme68x_bsec_set_heatr_conf(ctx, &bme68x_heater_settings);
+        }
+
+        /* Set power mode as forced mode and trigger forced mode measurement. Both configurations are either freshly
+         * written, which puts the sensor to sleep, or unchanged since the last forced mode measurement, after which
+         * the sensor went back to sleep. With the oversampling settings known from the shadow, ctrl_meas can then be
+         * written directly instead of being read back first. */
+        if (bme68x_status == BME68X_OK && ctx->op_mode == BME68X_SLEEP_MODE &&
+            (ctx->shadow_valid & (BSEC_IOT_SHADOW_CONF | BSEC_IOT_SHADOW_HEATR)) ==
+            (BSEC_IOT_SHADOW_CONF | BSEC_IOT_SHADOW_HEATR)) {
+            reg_addr = BME68X_REG_CTRL_MEAS;
+            ctrl_meas = (uint8_t)((ctx->conf_shadow.os_temp << BME68X_OST_POS) |
+                                  (ctx->conf_shadow.os_pres << BME68X_OSP_POS) | BME68X_FORCED_MODE);
+            bme68x_status = bme68x_set_regs(&reg_addr, &ctrl_meas, 1, &ctx->bme68x);
+            if (bme68x_status == BME68X_OK) {
+                ctx->bus_stats.n_transfers_saved++;
+            }
+        } else {
+            bme68x_status = bme68x_set_op_mode(BME68X_FORCED_MODE, &ctx->bme68x);
+        }
+
+        /* Without a trigger there is no measurement to wait for, the sample is dropped */
+        if (bme68x_status == BME68X_OK) {
+            ctx->op_mode = BME68X_FORCED_MODE;
+
+            /* Get the total measurement duration, TPH conversion plus heating time, so that the caller can come back
+             * once the measurement is complete */
+            meas_period = bme68x_get_meas_dur(BME68X_FORCED_MODE, &bme68x_sensor_settings, &ctx->bme68x);
+            ctx->activity.n_measurements++;
+            ctx->activity.tph_us += meas_period;
+            if (sensor_settings->run_gas) {
+                meas_period += (uint32_t)sensor_settings->heater_duration * 1000;
+                ctx->activity.heater_us += (uint32_t)sensor_settings->heater_duration * 1000;
+            }
+        }
+    } else if (sensor_settings->trigger_measurement && sensor_settings->op_mode == BME68X_PARALLEL_MODE &&
+               ctx->op_mode != BME68X_PARALLEL_MODE) {
+        /* Set the desired sensor configuration */
+        bme68x_status = bme68x_bsec_set_conf(ctx, &bme68x_sensor_settings);
+
+        /* Set the heater profile. The heating time shared by all the profile steps is what is left of the total
+         * heating duration once the TPH conversion is done. */
+        bme68x_heater_settings.enable = BME68X_ENABLE;
+        bme68x_heater_settings.heatr_temp_prof = sensor_settings->heater_temperature_profile;
+        bme68x_heater_settings.heatr_dur_prof = sensor_settings->heater_duration_profile;
+        bme68x_heater_settings.profile_len = sensor_settings->heater_profile_len;
+        ctx->parallel_tph_us = bme68x_get_meas_dur(BME68X_PARALLEL_MODE, &bme68x_sensor_settings, &ctx->bme68x);
+        bme68x_heater_settings.shared_heatr_dur = (uint16_t)(BSEC_TOTAL_HEAT_DUR - (ctx->parallel_tph_us / 1000));
+        ctx->shadow_valid &= ~BSEC_IOT_SHADOW_HEATR;
+        if (bme68x_status == BME68X_OK) {
+            bme68x_status = bme68x_set_heatr_conf(BME68X_PARALLEL_MODE, &bme68x_heater_settings, &ctx->bme68x);
+        }
+
+        /* Set power mode as parallel mode, the sensor then measures continuously */
+        if (bme68x_status == BME68X_OK) {
+            bme68x_status = bme68x_set_op_mode(BME68X_PARALLEL_MODE, &ctx->bme68x);
+        }
+        if (bme68x_status == BME68X_OK) {
+            ctx->op_mode = BME68X_PARALLEL_MODE;
+        }
+    } else if (sensor_settings->op_mode == BME68X_SLEEP_MODE && ctx->op_mode == BME68X_PARALLEL_MODE) {
+        /* Stop the continuous measurements of parallel mode */
+        bme68x_status = bme68x_set_op_mode(BME68X_SLEEP_MODE, &ctx->bme68x);
+        if (bme68x_status == BME68X_OK) {
+            ctx->op_mode = BME68X_SLEEP_MODE;
+        }
+    }
+
+    /* Forget everything about the sensor registers after a failed transfer */
+    if (bme68x_status != BME68X_OK) {
+        ctx->shadow_valid = 0;
+    }
+    bme68x_bsec_stat_status(ctx, bme68x_status);
+
+    return meas_period;
+}
+
+/*!
+ * @brief       Account for the time spent in parallel mode up to now
+ *
+ * The sensor measures continuously in parallel mode: each field is a TPH conversion followed by heating for the rest
+ * of BSEC_TOTAL_HEAT_DUR.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      none
+ */
+static void bme68x_bsec_account_parallel(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    int64_t elapsed;
+    int64_t tph;
+
+    if (ctx->op_mode == BME68X_PARALLEL_MODE && ctx->parallel_mark_us != 0 && now_us > ctx->parallel_mark_us) {
+        elapsed = now_us - ctx->parallel_mark_us;
+        tph = elapsed * ctx->parallel_tph_us / (BSEC_TOTAL_HEAT_DUR * 1000);
+        ctx->activity.tph_us += tph;
+        ctx->activity.heater_us += elapsed - tph;
+    }
+    ctx->parallel_mark_us = (ctx->op_mode == BME68X_PARALLEL_MODE) ? now_us : 0;
+}
+
+/*!
+ * @brief       Check whether the last triggered measurement is complete
+ *
+ * @param[in]   ctx                 context of the sensor
+ *
+ * @return      non-zero when the data is ready for reading
+ */
+static uint8_t bme68x_bsec_measurement_done(bsec_iot_ctx_t *ctx) {
+    int8_t bme68x_status = BME68X_OK;
+    uint8_t opmode = BME68X_SLEEP_MODE;
+
+    /* Call the API to get current operation mode of the sensor */
+    bme68x_status = bme68x_get_op_mode(&opmode, &ctx->bme68x);
+    if (bme68x_status != BME68X_OK) {
+        ctx->shadow_valid = 0;
+    }
+    bme68x_bsec_stat_status(ctx, bme68x_status);
+    BSEC_IOT_STAT(ctx->stats.n_opmode_polls++);
+    /* When the measurement is completed and data is ready for reading, the sensor must be in BME68X_SLEEP_MODE.
+     * The measurement is only considered running while the sensor is still in BME68X_FORCED_MODE. */
+    return (bme68x_status != BME68X_OK) || (opmode != BME68X_FORCED_MODE);
+}
+
+/*!
+ * @brief       Populate the inputs structure to be passed to do_steps function from one data field of the sensor
+ *
+ * @param[in]   ctx                     context of the sensor
+ * @param[in]   data                    data field read from the sensor
+ * @param[in]   op_mode                 operation mode the data field was measured in
+ * @param[in]   time_stamp_trigger      settings of the sensor returned from sensor control function
+ * @param[in]   inputs                  input structure containing the information on sensors to be passed to do_steps
+ * @param[in]   num_bsec_inputs         number of inputs to be passed to do_steps
+ * @param[in]   bsec_process_data       process data variable returned from sensor_control
+ *
+ * @return      none
+ */
+static void bme68x_bsec_field_inputs(bsec_iot_ctx_t *ctx, const struct bme68x_data *data, uint8_t op_mode,
+                                     int64_t time_stamp_trigger, bsec_input_t* inputs, uint8_t* num_bsec_inputs,
+                                     int32_t bsec_process_data) {
+    if (data->status & BME68X_NEW_DATA_MSK) {
+        /* Pressure to be processed by BSEC */
+        if (bsec_process_data & BSEC_PROCESS_PRESSURE) {
+            /* Place presssure sample into input struct */
+            inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_PRESSURE;
+            inputs[*num_bsec_inputs].signal = data->pressure;
+            inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
+            (*num_bsec_inputs)++;
+        }
+        /* Temperature to be processed by BSEC */
+        if (bsec_process_data & BSEC_PROCESS_TEMPERATURE) {
+            /* Place temperature sample into input struct */
+            inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_TEMPERATURE;
+#ifdef BME68X_USE_FPU
+            inputs[*num_bsec_inputs].signal = data->temperature;
+#else
+            inputs[*num_bsec_inputs].signal = data->temperature / 100.0f;
+#endif
+            inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
+            (*num_bsec_inputs)++;
+
+            /* Also add optional heatsource input which will be subtracted from the temperature reading to
+             * compensate for device-specific self-heating (supported in BSEC IAQ solution)*/
+            inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_HEATSOURCE;
+            inputs[*num_bsec_inputs].signal = ctx->temperature_offset;
+            inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
+            (*num_bsec_inputs)++;
+        }
+        /* Humidity to be processed by BSEC */
+        if (bsec_process_data & BSEC_PROCESS_HUMIDITY) {
+            /* Place humidity sample into input struct */
+            inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_HUMIDITY;
+#ifdef BME68X_USE_FPU
+            inputs[*num_bsec_inputs].signal = data->humidity;
+#else
+            inputs[*num_bsec_inputs].signal = data->humidity / 1000.0f;
+#endif
+            inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
+            (*num_bsec_inputs)++;
+        }
+        /* Gas to be processed by BSEC */
+        if (bsec_process_data & BSEC_PROCESS_GAS) {
+            /* Check whether gas_valid flag is set */
+            if (data->status & BME68X_GASM_VALID_MSK) {
+                /* Place sample into input struct */
+                inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_GASRESISTOR;
+                inputs[*num_bsec_inputs].signal = data->gas_resistance;
+                inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
+                (*num_bsec_inputs)++;
+
+                /* Heater profile step the gas sample was taken at, always the first one in forced mode */
+                if (bsec_process_data & BSEC_PROCESS_PROFILE_PART) {
+                    inputs[*num_bsec_inputs].sensor_id = BSEC_INPUT_PROFILE_PART;
+                    inputs[*num_bsec_inputs].signal = (op_mode == BME68X_FORCED_MODE) ? 0 : data->gas_index;
+                    inputs[*num_bsec_inputs].time_stamp = time_stamp_trigger;
+                    (*num_bsec_inputs)++;
+                }
+            } else {
+                BSEC_IOT_STAT(ctx->stats.n_dropped_gas_invalid++);
+            }
+        }
+    } else {
+        BSEC_IOT_STAT(ctx->stats.n_dropped_new_data++);
+    }
+}
+
+/*!
+ * @brief       Read the data from registers and populate the inputs structures to be passed to do_steps function
+ *
+ * All the fields available are fetched by a single bme68x_get_data() call: one in forced mode, up to BME68X_N_MEAS
+ * in parallel mode. Each field gets its own set of inputs in the context. Unless the completion mode polls the
+ * operation mode first, the new data flag read along with a forced mode measurement tells whether it is complete;
+ * the read then does not wait for it.
+ *
+ * @param[in]   ctx                     context of the sensor
+ * @param[in]   time_stamp_trigger      settings of the sensor returned from sensor control function
+ * @param[in]   bsec_process_data       process data variable returned from sensor_control
+ *
+ * @return      zero if the measurement is not complete yet, non-zero otherwise
+ */
+static uint8_t bme68x_bsec_read_data(bsec_iot_ctx_t *ctx, int64_t time_stamp_trigger, int32_t bsec_process_data) {
+    struct bme68x_data data[BME68X_N_MEAS] = {0};
+    int8_t bme68x_status = BME68X_OK;
+    uint8_t n_data = 0;
+    uint8_t i;
+
+    ctx->n_fields = 0;
+
+    /* We only have to read data if the previous call the bsec_sensor_control() actually asked for it, and only while
+     * the sensor is measuring */
+    if (bsec_process_data && ctx->op_mode != BME68X_SLEEP_MODE) {
+        ctx->read_nonblocking = (ctx->op_mode == BME68X_FORCED_MODE && ctx->completion != BSEC_IOT_COMPLETION_OPMODE);
+        ctx->read_burst = (ctx->bme68x.intf == BME68X_SPI_INTF || ctx->burst_len != 0);
+        bme68x_status = bme68x_get_data(ctx->op_mode, data, &n_data, &ctx->bme68x);
+        ctx->read_nonblocking = 0;
+        ctx->read_burst = 0;
+        ctx->burst_len = 0;
+
+        if (ctx->read_aborted) {
+            /* No new data at the first attempt, the measurement is still running */
+            ctx->read_aborted = 0;
+            return 0;
+        }
+        if (bme68x_status < BME68X_OK) {
+            ctx->shadow_valid = 0;
+        }
+        bme68x_bsec_stat_status(ctx, bme68x_status);
+
+        for (i = 0; i < n_data && i < BME68X_N_MEAS; i++) {
+            ctx->num_bsec_inputs[ctx->n_fields] = 0;
+            bme68x_bsec_field_inputs(ctx, &data[i], ctx->op_mode, time_stamp_trigger, ctx->bsec_inputs[ctx->n_fields],
+                                     &ctx->num_bsec_inputs[ctx->n_fields], bsec_process_data);
+            if (ctx->num_bsec_inputs[ctx->n_fields] > 0) {
+                ctx->n_fields++;
+            }
+        }
+
+        /* A forced mode measurement leaves the sensor sleeping */
+        if (ctx->op_mode == BME68X_FORCED_MODE) {
+            ctx->op_mode = BME68X_SLEEP_MODE;
+        }
+    }
+
+    return 1;
+}
+
+/*!
+ * @brief       Come back to an incomplete measurement a little later, or give it up once it is long overdue
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      absolute timestamp (in microseconds) at which bsec_iot_step() has to be called next
+ */
+static int64_t bme68x_bsec_retry_read(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    ctx->n_retries++;
+    if (ctx->n_retries <= ctx->max_retries) {
+        return now_us + BSEC_IOT_RETRY_PERIOD_US;
+    }
+
+    /* The data never came, e.g. the trigger got lost on the bus: the sample is dropped and the sensor, whose state is
+     * unknown, gets its configuration written anew by the next trigger */
+    ctx->n_completion_retries += ctx->n_retries;
+    ctx->meas_pending = 0;
+    ctx->op_mode = BME68X_SLEEP_MODE;
+    ctx->shadow_valid = 0;
+    ctx->n_fields = 0;
+    ctx->phase = BSEC_IOT_PHASE_CONTROL;
+    BSEC_IOT_STAT(ctx->stats.n_read_timeouts++);
+
+    return ctx->next_call / 1000;
+}
+
+/*!
+ * @brief       Fetch the data and heater registers by an asynchronous read before the sensor API reads them
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ * @param[out]  deadline            time at which the read is given up, when it is still running
+ *
+ * @return      zero while the read runs, non-zero once the data can be read
+ */
+static uint8_t bme68x_bsec_fetch_data(bsec_iot_ctx_t *ctx, int64_t now_us, int64_t *deadline) {
+    BME68X_INTF_RET_TYPE rslt;
+
+    /* Nothing to fetch without an asynchronous read function, or when no data is to be read */
+    if (ctx->bus_read_async == NULL || !ctx->sensor_settings.process_data || ctx->op_mode == BME68X_SLEEP_MODE) {
+        return 1;
+    }
+
+    /* All the registers of the burst are on the SPI memory page the trigger left selected */
+    if (!ctx->async_started) {
+        ctx->async_started = 1;
+        ctx->async_pending = 1;
+        ctx->async_start_us = now_us;
+        ctx->bus_stats.n_reads++;
+        ctx->bus_stats.n_bytes_read += BSEC_IOT_BURST_LEN;
+        ctx->bus_stats.n_async_reads++;
+        rslt = ctx->bus_read_async(ctx->bus_read_async_arg, ctx, bme68x_bsec_burst_addr(ctx), ctx->burst,
+                                   BSEC_IOT_BURST_LEN);
+        if (rslt != BME68X_INTF_RET_SUCCESS) {
+            ctx->async_rslt = rslt;
+            ctx->async_pending = 0;
+        }
+    }
+
+    if (ctx->async_pending) {
+        if (now_us - ctx->async_start_us < BSEC_IOT_BUS_TIMEOUT_US) {
+            *deadline = ctx->async_start_us + BSEC_IOT_BUS_TIMEOUT_US;
+            return 0;
+        }
+        ctx->async_rslt = BME68X_E_COM_FAIL;
+        ctx->async_pending = 0;
+    }
+    ctx->async_started = 0;
+
+    /* A failed read leaves the burst empty, the sensor API then reads through the blocking functions */
+    if (ctx->async_rslt != BME68X_INTF_RET_SUCCESS) {
+        ctx->bus_stats.n_async_failures++;
+        return 1;
+    }
+    ctx->burst_len = BSEC_IOT_BURST_LEN;
+
+    return 1;
+}
+
+/*!
+ * @brief       This function is written to process the sensor data for the requested virtual sensors
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   bsec_inputs         input structure containing the information on sensors to be passed to do_steps
+ * @param[in]   num_bsec_inputs     number of inputs to be passed to do_steps
+ * @param[in]   output_ready        pointer to the function processing obtained BSEC outputs
+ *
+ * @return      none
+ */
+static void bme68x_bsec_process_data(bsec_iot_ctx_t *ctx, const bsec_input_t* bsec_inputs, uint8_t num_bsec_inputs,
+                                     output_ready_fct output_ready) {
+    /* Output buffer set to the maximum virtual sensor outputs supported */
     bsec_output_t bsec_outputs[BSEC_NUMBER_OUTPUTS];
     uint8_t num_bsec_outputs = 0;
     uint8_t index = 0;
+    uint8_t id;
+    bsec_iot_output_t output;
+    int64_t start_us = bme68x_bsec_stat_now_us();
+
+    /* Check if something should be processed by BSEC */
+    if (num_bsec_inputs > 0) {
+        /* Set number of outputs to the size of the allocated buffer */
+        /* BSEC_NUMBER_OUTPUTS to be defined */
+        num_bsec_outputs = BSEC_NUMBER_OUTPUTS;
+
+        bme68x_bsec_lock(ctx, 1);
+        ctx->activity.n_steps++;
+
+        /* Perform processing of the data by BSEC
+           Note:
+           * The number of outputs you get depends on what you asked for during bsec_update_subscription(). This is
+             handled under bme68x_bsec_update_subscription() function in this example file.
+           * The number of actual outputs that are returned is written to num_bsec_outputs. */
+        output.bsec_status = bsec_do_steps_m(ctx->bsec_inst, bsec_inputs, num_bsec_inputs, bsec_outputs,
+                                             &num_bsec_outputs);
+        output.timestamp = 0;
+        output.valid_mask = 0;
+        output.subscribed_mask = ctx->subscribed_mask;
+
+        /* Store each output at its dense index and mark it as produced */
+        for (index = 0; index < num_bsec_outputs; index++) {
+            if (bsec_outputs[index].sensor_id >= sizeof(bsec_iot_output_ids) ||
+                bsec_iot_output_ids[bsec_outputs[index].sensor_id] == 0) {
+                continue;
+            }
+            id = bsec_iot_output_ids[bsec_outputs[index].sensor_id] - 1;
+            output.value[id] = bsec_outputs[index].signal;
+            output.accuracy[id] = bsec_outputs[index].accuracy;
+            output.valid_mask |= BSEC_IOT_OUTPUT_MASK(id);
+
+            /* Assume that all the returned timestamps are the same */
+            output.timestamp = bsec_outputs[index].time_stamp;
+        }
+
+        if (ctx->boot.boot_to_output_us == 0) {
+            ctx->boot.boot_to_output_us = (uint32_t)(bme68x_bsec_stat_now_us() - ctx->boot_start_us);
+        }
+
+        if (ctx->adaptive_enabled) {
+            bme68x_bsec_adapt_rate(ctx, &output);
+        }
+
+        bme68x_bsec_lock(ctx, 0);
+
+        /* Pass the outputs to the user provided output_ready() function, unless the filter holds them back */
+        if (ctx->output_filter == NULL || ctx->output_filter(ctx->output_filter_arg, &output)) {
+            output_ready(ctx, &output);
+        }
+        bme68x_bsec_account_cpu(ctx, start_us, 0);
+    }
+}
+
+
+/*!
+ * @brief       Retrieve the BSEC state of a sensor and hand it to the state save function
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   state_save          pointer to the system-specific state save function
+ *
+ * @return      result of bsec_get_state()
+ */
+bsec_library_return_t bsec_iot_save_state(bsec_iot_ctx_t *ctx, state_save_fct state_save) {
+    /* The state is serialized through the scratch area of the arena */
+    uint8_t *bsec_state = ctx->arena->mem;
+    uint8_t *work_buffer = ctx->arena->mem + (BSEC_IOT_ARENA_SCRATCH_SIZE - BSEC_MAX_WORKBUFFER_SIZE);
+    uint32_t bsec_state_len = 0;
+    bsec_library_return_t bsec_status;
+    int64_t start_us = bme68x_bsec_stat_now_us();
+
+    bme68x_bsec_arena_lock(ctx->arena, 1);
+    bme68x_bsec_lock(ctx, 1);
+    bsec_status = bsec_get_state_m(ctx->bsec_inst, 0, bsec_state, BSEC_MAX_STATE_BLOB_SIZE, work_buffer,
+                                   BSEC_MAX_WORKBUFFER_SIZE, &bsec_state_len);
+    bme68x_bsec_lock(ctx, 0);
+    if (bsec_status == BSEC_OK) {
+        state_save(ctx, bsec_state, bsec_state_len);
+    }
+    bme68x_bsec_arena_lock(ctx->arena, 0);
+    BSEC_IOT_STAT(ctx->stats.n_state_saves++);
+    BSEC_IOT_STAT(bme68x_bsec_stat_time(start_us, &ctx->stats.state_save_time_us, &ctx->stats.state_save_max_us));
+    bme68x_bsec_account_cpu(ctx, start_us, 0);
+
+    return bsec_status;
+}
+
+/*!
+ * @brief       Keep what a sensor needs to resume in a buffer that survives deep sleep, e.g. in RTC memory
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[out]  retained            retained buffer, aligned on 8 bytes
+ * @param[in]   size                size of the buffer, BSEC_IOT_RETAINED_SIZE is always enough
+ *
+ * @return      number of bytes of the image, zero if it could not be written
+ */
+uint32_t bsec_iot_suspend(bsec_iot_ctx_t *ctx, void *retained, uint32_t size) {
+    bsec_iot_retained_t *image = (bsec_iot_retained_t *)retained;
+    uint8_t *config = (uint8_t *)retained + sizeof(bsec_iot_retained_t);
+    uint8_t *work_buffer = ctx->arena->mem + (BSEC_IOT_ARENA_SCRATCH_SIZE - BSEC_MAX_WORKBUFFER_SIZE);
+    uint32_t config_len = 0;
+    uint32_t state_len = 0;
+    uint32_t max_len;
+    bsec_library_return_t bsec_status;
+    uint8_t sensor_id;
+    uint8_t id;
+
+    /* Only between two cycles, a sensor measuring in parallel mode does not sleep */
+    if (ctx->phase != BSEC_IOT_PHASE_CONTROL || ctx->op_mode == BME68X_PARALLEL_MODE ||
+        size < sizeof(bsec_iot_retained_t)) {
+        return 0;
+    }
+
+    /* The configuration does not change while running, the one retained by a previous suspend is kept as it is */
+    if (image->magic == BSEC_IOT_RETAINED_MAGIC && image->config_fingerprint == ctx->boot.config_fingerprint &&
+        image->config_len != 0 && image->config_len <= size - sizeof(bsec_iot_retained_t) &&
+        bsec_iot_crc32(0, config, image->config_len) == image->config_crc) {
+        config_len = image->config_len;
+    }
+
+    /* The image is incomplete from here on */
+    image->magic = 0;
+
+    bme68x_bsec_arena_lock(ctx->arena, 1);
+    bme68x_bsec_lock(ctx, 1);
+    if (config_len == 0 && ctx->boot.config_fingerprint != 0) {
+        max_len = size - sizeof(bsec_iot_retained_t);
+        bsec_status = bsec_get_configuration_m(ctx->bsec_inst, 0, config,
+                                               (max_len < BSEC_MAX_PROPERTY_BLOB_SIZE) ? max_len
+                                                                                       : BSEC_MAX_PROPERTY_BLOB_SIZE,
+                                               work_buffer, BSEC_MAX_WORKBUFFER_SIZE, &config_len);
+        if (bsec_status != BSEC_OK) {
+            config_len = 0;
+        }
+    }
+    max_len = size - sizeof(bsec_iot_retained_t) - config_len;
+    bsec_status = bsec_get_state_m(ctx->bsec_inst, 0, config + config_len,
+                                   (max_len < BSEC_MAX_STATE_BLOB_SIZE) ? max_len : BSEC_MAX_STATE_BLOB_SIZE,
+                                   work_buffer, BSEC_MAX_WORKBUFFER_SIZE, &state_len);
+    bme68x_bsec_lock(ctx, 0);
+    bme68x_bsec_arena_lock(ctx->arena, 0);
+    if (bsec_status != BSEC_OK) {
+        return 0;
+    }
+
+    image->length = sizeof(bsec_iot_retained_t) + config_len + state_len;
+    image->inst_size = (bsec_get_instance_size_m() + 3) & ~3;
+    image->config_crc = bsec_iot_crc32(0, config, config_len);
+    image->config_fingerprint = ctx->boot.config_fingerprint;
+    image->config_len = (uint16_t)config_len;
+    image->state_len = (uint16_t)state_len;
+    /* The pointers of the sensor API are only valid in this boot, they are hooked up again on resume */
+    image->dev = ctx->bme68x;
+    image->dev.intf_ptr = NULL;
+    image->dev.read = NULL;
+    image->dev.write = NULL;
+    image->dev.delay_us = NULL;
+    image->dev_addr = ctx->dev_addr;
+    image->shadow_valid = ctx->shadow_valid;
+    image->conf_shadow = ctx->conf_shadow;
+    image->heatr_shadow = ctx->heatr_shadow;
+    image->conf_shadow_cost = ctx->conf_shadow_cost;
+    image->heatr_shadow_cost = ctx->heatr_shadow_cost;
+    image->completion_margin_us = ctx->completion_margin_us;
+    image->sample_rate = ctx->sample_rate;
+    image->n_subscribed = 0;
+    for (sensor_id = 0; sensor_id < sizeof(bsec_iot_output_ids); sensor_id++) {
+        id = bsec_iot_output_ids[sensor_id];
+        if (id != 0 && (ctx->subscribed_mask & BSEC_IOT_OUTPUT_MASK(id - 1))) {
+            image->subscription[image->n_subscribed].sensor_id = sensor_id;
+            image->subscription[image->n_subscribed].sample_rate = ctx->output_rate[id - 1];
+            image->n_subscribed++;
+        }
+    }
+    image->temperature_offset = ctx->temperature_offset;
+    image->next_call = ctx->next_call;
+    image->period_us = ctx->period_us;
+    image->n_samples = ctx->n_samples;
+    image->activity = ctx->activity;
+    image->bus_stats = ctx->bus_stats;
+    image->crc = bsec_iot_crc32(0, (const uint8_t *)&image->length,
+                                sizeof(bsec_iot_retained_t) - offsetof(bsec_iot_retained_t, length));
+    image->crc = bsec_iot_crc32(image->crc, config + config_len, state_len);
+
+    /* Only a complete image is marked as such */
+    image->magic = BSEC_IOT_RETAINED_MAGIC;
+
+    return image->length;
+}
 
-    bsec_library_return_t bsec_status = BSEC_OK;
+/*!
+ * @brief       Resume a sensor from the image bsec_iot_suspend() kept, instead of bsec_iot_init()
+ *
+ * @param[out]  ctx                 context of the sensor to resume
+ * @param[in]   retained            retained buffer
+ * @param[in]   size                size of the buffer
+ * @param[in]   intf_ptr            pointer handed to the bus functions, NULL to hand a pointer to ctx->dev_addr
+ * @param[in]   bus_write           pointer to the bus writing function
+ * @param[in]   bus_read            pointer to the bus reading function
+ * @param[in]   sleep               pointer to the system-specific sleep function
+ * @param[in]   arena               arena the BSEC instance of the sensor is taken from
+ *
+ * @return      zero if successful, BSEC_E_CONFIG_CRCMISMATCH in bsec_status if the buffer holds no valid image
+ */
+return_values_init bsec_iot_resume(bsec_iot_ctx_t *ctx, const void *retained, uint32_t size, void *intf_ptr,
+                                   bme68x_write_fptr_t bus_write, bme68x_read_fptr_t bus_read,
+                                   bme68x_delay_us_fptr_t sleep, bsec_iot_arena_t *arena) {
+    return_values_init ret = {BME68X_OK, BSEC_OK};
+    const bsec_iot_retained_t *image = (const bsec_iot_retained_t *)retained;
+    const uint8_t *config = (const uint8_t *)retained + sizeof(bsec_iot_retained_t);
+    uint8_t *work_buffer = arena->mem + (BSEC_IOT_ARENA_SCRATCH_SIZE - BSEC_MAX_WORKBUFFER_SIZE);
+    uint32_t crc;
+    int64_t load_start_us;
 
-    int64_t timestamp = 0;
-    float iaq = 0.0f;
-    uint8_t iaq_accuracy = 0;
-    float temp = 0.0f;
-    float raw_temp = 0.0f;
-    float raw_pressure = 0.0f;
-    float humidity = 0.0f;
-    float raw_humidity = 0.0f;
-    float raw_gas = 0.0f;
-    float static_iaq = 0.0f;
-    uint8_t static_iaq_accuracy = 0;
-    float co2_equivalent = 0.0f;
-    uint8_t co2_accuracy = 0;
-    float breath_voc_equivalent = 0.0f;
-    uint8_t breath_voc_accuracy = 0;
-    float comp_gas_value = 0.0f;
-    uint8_t comp_gas_accuracy = 0;
-    float gas_percentage = 0.0f;
-    uint8_t gas_percentage_acccuracy = 0;
+    /* Anything but a complete image of this firmware sends the sensor through bsec_iot_init() */
+    if (size < sizeof(bsec_iot_retained_t) || image->magic != BSEC_IOT_RETAINED_MAGIC || image->length > size ||
+        image->length != sizeof(bsec_iot_retained_t) + image->config_len + image->state_len ||
+        image->inst_size != ((bsec_get_instance_size_m() + 3) & ~3) ||
+        bsec_iot_crc32(0, config, image->config_len) != image->config_crc) {
+        ret.bsec_status = BSEC_E_CONFIG_CRCMISMATCH;
+        return ret;
+    }
+    crc = bsec_iot_crc32(0, (const uint8_t *)&image->length,
+                         sizeof(bsec_iot_retained_t) - offsetof(bsec_iot_retained_t, length));
+    if (bsec_iot_crc32(crc, config + image->config_len, image->state_len) != image->crc) {
+        ret.bsec_status = BSEC_E_CONFIG_CRCMISMATCH;
+        return ret;
+    }
 
-    /* Check if something should be processed by BSEC */
-    if (num_bsec_inputs > 0) {
-        /* Set number of outputs to the size of the allocated buffer */
-        /* BSEC_NUMBER_OUTPUTS to be defined */
-        num_bsec_outputs = BSEC_NUMBER_OUTPUTS;
+    ret.bsec_status = bme68x_bsec_setup(ctx, image->dev.intf, image->dev_addr, intf_ptr, bus_write, bus_read, sleep,
+                                        arena);
+    if (ret.bsec_status != BSEC_OK) {
+        return ret;
+    }
 
-        /* Perform processing of the data by BSEC
-           Note:
-           * The number of outputs you get depends on what you asked for during bsec_update_subscription(). This is
-             handled under bme68x_bsec_update_subscription() function in this example file.
-           * The number of actual outputs that are returned is written to num_bsec_outputs. */
-        bsec_status = bsec_do_steps(bsec_inputs, num_bsec_inputs, bsec_outputs, &num_bsec_outputs);
+    /* The sensor API device comes back with its calibration, hooked to the bus functions of this boot */
+    ctx->bme68x = image->dev;
+    ctx->bme68x.intf_ptr = ctx;
+    ctx->bme68x.write = bme68x_bsec_bus_write;
+    ctx->bme68x.read = bme68x_bsec_bus_read;
+    ctx->bme68x.delay_us = bme68x_bsec_delay_us;
 
-        /* Iterate through the outputs and extract the relevant ones. */
-        for (index = 0; index < num_bsec_outputs; index++) {
-            switch (bsec_outputs[index].sensor_id) {
-            case BSEC_OUTPUT_IAQ:
-                iaq = bsec_outputs[index].signal;
-                iaq_accuracy = bsec_outputs[index].accuracy;
-                break;
-            case BSEC_OUTPUT_STATIC_IAQ:
-                static_iaq = bsec_outputs[index].signal;
-                static_iaq_accuracy = bsec_outputs[index].accuracy;
-                break;
-            case BSEC_OUTPUT_CO2_EQUIVALENT:
-                co2_equivalent = bsec_outputs[index].signal;
-                co2_accuracy = bsec_outputs[index].accuracy;
-                break;
-            case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
-                breath_voc_equivalent = bsec_outputs[index].signal;
-                breath_voc_accuracy = bsec_outputs[index].accuracy;
-                break;
-            case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
-                temp = bsec_outputs[index].signal;
-                break;
-            case BSEC_OUTPUT_RAW_PRESSURE:
-                raw_pressure = bsec_outputs[index].signal;
-                break;
-            case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY:
-                humidity = bsec_outputs[index].signal;
-                break;
-            case BSEC_OUTPUT_RAW_GAS:
-                raw_gas = bsec_outputs[index].signal;
-                break;
-            case BSEC_OUTPUT_RAW_TEMPERATURE:
-                raw_temp = bsec_outputs[index].signal;
+    /* The counters go on from where they were, so that the charge estimate only sees what happened since */
+    ctx->activity = image->activity;
+    ctx->bus_stats = image->bus_stats;
+
+    /* The sensor stayed powered, so what was last written to it still holds */
+    ctx->shadow_valid = image->shadow_valid;
+    ctx->conf_shadow = image->conf_shadow;
+    ctx->heatr_shadow = image->heatr_shadow;
+    ctx->conf_shadow_cost = image->conf_shadow_cost;
+    ctx->heatr_shadow_cost = image->heatr_shadow_cost;
+    ctx->completion_margin_us = image->completion_margin_us;
+    ctx->temperature_offset = image->temperature_offset;
+
+    /* Initialize BSEC library */
+    ret.bsec_status = bsec_init_m(ctx->bsec_inst);
+    if (ret.bsec_status != BSEC_OK) {
+        return ret;
+    }
+
+    /* The blobs are read from the image, only the work buffer comes from the scratch area */
+    load_start_us = bme68x_bsec_stat_now_us();
+    if (image->config_len != 0) {
+        bme68x_bsec_arena_lock(arena, 1);
+        ret.bsec_status = bsec_set_configuration_m(ctx->bsec_inst, config, image->config_len, work_buffer,
+                                                   BSEC_MAX_WORKBUFFER_SIZE);
+        bme68x_bsec_arena_lock(arena, 0);
+        if (ret.bsec_status != BSEC_OK) {
+            return ret;
+        }
+    }
+    ctx->boot.config_fingerprint = image->config_fingerprint;
+    ctx->boot.config_us = (uint32_t)(bme68x_bsec_stat_now_us() - load_start_us);
+
+    load_start_us = bme68x_bsec_stat_now_us();
+    if (image->state_len != 0) {
+        bme68x_bsec_arena_lock(arena, 1);
+        ret.bsec_status = bsec_set_state_m(ctx->bsec_inst, config + image->config_len, image->state_len, work_buffer,
+                                           BSEC_MAX_WORKBUFFER_SIZE);
+        bme68x_bsec_arena_lock(arena, 0);
+        if (ret.bsec_status != BSEC_OK) {
+            return ret;
+        }
+        ctx->boot.state_restored = 1;
+    }
+    ctx->boot.state_us = (uint32_t)(bme68x_bsec_stat_now_us() - load_start_us);
+
+    /* Subscribe the retained outputs again, each at the rate it had */
+    ctx->sample_rate = image->sample_rate;
+    ret.bsec_status = bme68x_bsec_subscribe(ctx, image->subscription, image->n_subscribed);
+    if (ret.bsec_status != BSEC_OK) {
+        return ret;
+    }
+
+    /* Pick the schedule up where it was left */
+    ctx->next_call = image->next_call;
+    ctx->period_us = image->period_us;
+    ctx->n_samples = image->n_samples;
+    ctx->deadline = image->next_call / 1000;
+
+    ctx->boot.resumed = 1;
+    ctx->boot.init_us = (uint32_t)(bme68x_bsec_stat_now_us() - ctx->boot_start_us);
+    return ret;
+}
+
+/*!
+ * @brief       Time stamp the cycle starting now, or postpone it according to the overrun policy
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      zero if the cycle is dropped and postponed to ctx->next_call, non-zero if it runs with ctx->time_stamp
+ */
+static uint8_t bme68x_bsec_start_cycle(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    int64_t late = now_us - ctx->next_call / 1000;
+    int64_t tolerance = (ctx->overrun_tolerance_us != 0) ? ctx->overrun_tolerance_us : ctx->period_us / 16;
+    int64_t n_periods;
+
+    /* Nothing scheduled yet */
+    if (ctx->next_call == 0) {
+        ctx->time_stamp = now_us * 1000;
+        ctx->timing.n_cycles++;
+        return 1;
+    }
+
+    if (late <= tolerance) {
+        if (late > 0) {
+            ctx->timing.jitter_sum_us += late;
+            if (late > ctx->timing.jitter_max_us) {
+                ctx->timing.jitter_max_us = (uint32_t)late;
+            }
+        }
+        ctx->time_stamp = ctx->next_call;
+        ctx->timing.n_cycles++;
+        return 1;
+    }
+
+    ctx->timing.n_overruns++;
+    if (late > ctx->timing.overrun_max_us) {
+        ctx->timing.overrun_max_us = (uint32_t)late;
+    }
+
+    switch (ctx->overrun) {
+    case BSEC_IOT_OVERRUN_SKIP:
+        /* Move on to the first slot of the schedule that is not past yet */
+        if (ctx->period_us > 0) {
+            n_periods = (late + ctx->period_us - 1) / ctx->period_us;
+            ctx->next_call += n_periods * ctx->period_us * 1000;
+            ctx->timing.n_skipped += (uint32_t)n_periods;
+            return 0;
+        }
+        /* Without a known period there is no schedule to go back to */
+        ctx->time_stamp = now_us * 1000;
+        break;
+
+    case BSEC_IOT_OVERRUN_CATCH_UP:
+        ctx->time_stamp = ctx->next_call;
+        break;
+
+    case BSEC_IOT_OVERRUN_RESYNC:
+    default:
+        ctx->time_stamp = now_us * 1000;
+        break;
+    }
+    ctx->timing.n_cycles++;
+
+    return 1;
+}
+
+/*!
+ * @brief       Refine the margin added to the expected measurement duration from an observed completion
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              time (in microseconds) at which the measurement was found complete
+ *
+ * @return      none
+ */
+static void bme68x_bsec_update_margin(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    if (ctx->n_retries == 0) {
+        /* Complete at the first attempt, try a slightly shorter margin next time */
+        ctx->completion_margin_us -= ctx->completion_margin_us / 16;
+    } else {
+        /* Complete only after retrying, the measurement needs at least the observed overrun */
+        ctx->completion_margin_us = (uint32_t)(now_us - ctx->meas_end);
+        ctx->n_completion_retries += ctx->n_retries;
+        ctx->n_retries = 0;
+    }
+}
+
+/*!
+ * @brief       Select how bsec_iot_step() finds out that a measurement is complete
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   completion          completion mode
+ *
+ * @return      none
+ */
+void bsec_iot_set_completion(bsec_iot_ctx_t *ctx, bsec_iot_completion_t completion) {
+    ctx->completion = completion;
+}
+
+/*!
+ * @brief       Tell the integration that the data of the running measurement is ready
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      none
+ */
+void bsec_iot_notify_data_ready(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    if (ctx->phase == BSEC_IOT_PHASE_READ && now_us < ctx->deadline) {
+        ctx->deadline = now_us;
+    }
+}
+
+/*!
+ * @brief       Read the data of the measurements of a sensor asynchronously
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   read_async          pointer to the function starting a read, NULL to go back to blocking reads
+ * @param[in]   read_async_arg      pointer handed to the read function
+ *
+ * @return      none
+ */
+void bsec_iot_set_async_read(bsec_iot_ctx_t *ctx, bus_read_async_fct read_async, void *read_async_arg) {
+    ctx->bus_read_async = read_async;
+    ctx->bus_read_async_arg = read_async_arg;
+}
+
+/*!
+ * @brief       Report the end of the asynchronous read of a sensor
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   rslt                result of the transfer
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      none
+ */
+void bsec_iot_bus_done(bsec_iot_ctx_t *ctx, BME68X_INTF_RET_TYPE rslt, int64_t now_us) {
+    /* A read given up already is not reported any more */
+    if (!ctx->async_pending) {
+        return;
+    }
+    ctx->async_rslt = rslt;
+    ctx->async_pending = 0;
+
+    if (ctx->phase == BSEC_IOT_PHASE_READ && now_us < ctx->deadline) {
+        ctx->deadline = now_us;
+    }
+}
+
+/*!
+ * @brief       Set the functions used by bsec_iot_step() once a sample has been processed
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output_ready        pointer to the function processing obtained BSEC outputs
+ * @param[in]   state_save          pointer to the system-specific state save function
+ * @param[in]   save_intvl          interval at which BSEC state should be saved (in samples)
+ *
+ * @return      none
+ */
+void bsec_iot_set_handlers(bsec_iot_ctx_t *ctx, output_ready_fct output_ready, state_save_fct state_save,
+                           uint32_t save_intvl) {
+    ctx->output_ready = output_ready;
+    ctx->state_save = state_save;
+    ctx->save_intvl = save_intvl;
+}
+
+/*!
+ * @brief       Select what bsec_iot_step() does with a cycle that starts late
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   overrun             policy for the cycles later than the tolerance
+ * @param[in]   tolerance_us        lateness (in microseconds) beyond which a cycle is overrun, zero for the default
+ *
+ * @return      none
+ */
+void bsec_iot_set_overrun(bsec_iot_ctx_t *ctx, bsec_iot_overrun_t overrun, uint32_t tolerance_us) {
+    ctx->overrun = overrun;
+    ctx->overrun_tolerance_us = tolerance_us;
+}
+
+/*!
+ * @brief       Set the function recording each set of inputs before it is handed to BSEC
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   trace               pointer to the trace function, NULL for none
+ * @param[in]   trace_arg           pointer handed to the trace function
+ *
+ * @return      none
+ */
+void bsec_iot_set_trace(bsec_iot_ctx_t *ctx, input_trace_fct trace, void *trace_arg) {
+    ctx->trace = trace;
+    ctx->trace_arg = trace_arg;
+}
+
+/*!
+ * @brief       Set the function run on the outputs of every step before output_ready()
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output_filter       pointer to the filter function, NULL to hand all the outputs over
+ * @param[in]   output_filter_arg   pointer handed to the filter function
+ *
+ * @return      none
+ */
+void bsec_iot_set_output_filter(bsec_iot_ctx_t *ctx, output_filter_fct output_filter, void *output_filter_arg) {
+    ctx->output_filter = output_filter;
+    ctx->output_filter_arg = output_filter_arg;
+}
+
+/*!
+ * @brief       Set the function taking over the inputs read by bsec_iot_step()
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   input_sink          pointer to the sink function, NULL to process the inputs in bsec_iot_step()
+ * @param[in]   input_sink_arg      pointer handed to the sink function
+ *
+ * @return      none
+ */
+void bsec_iot_set_input_sink(bsec_iot_ctx_t *ctx, input_sink_fct input_sink, void *input_sink_arg) {
+    ctx->input_sink = input_sink;
+    ctx->input_sink_arg = input_sink_arg;
+}
+
+/*!
+ * @brief       Set the function serializing the uses of the sensor from different tasks
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   lock                pointer to the lock function, NULL for none
+ * @param[in]   lock_arg            pointer handed to the lock function
+ *
+ * @return      none
+ */
+void bsec_iot_set_lock(bsec_iot_ctx_t *ctx, ctx_lock_fct lock, void *lock_arg) {
+    ctx->lock = lock;
+    ctx->lock_arg = lock_arg;
+}
+
+/*!
+ * @brief       Hand one set of inputs to BSEC and its outputs to the output_ready() function of the sensor
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   inputs              inputs to BSEC
+ * @param[in]   n_inputs            number of inputs
+ *
+ * @return      none
+ */
+void bsec_iot_process_inputs(bsec_iot_ctx_t *ctx, const bsec_input_t *inputs, uint8_t n_inputs) {
+    bme68x_bsec_process_data(ctx, inputs, n_inputs, ctx->output_ready);
+}
+
+/*!
+ * @brief       Lowest free stack of the calling task observed after a phase of the acquisition cycle of a sensor
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   phase               phase of the acquisition cycle
+ *
+ * @return      free stack (in bytes), zero if not measured
+ */
+uint32_t bsec_iot_stack_free(const bsec_iot_ctx_t *ctx, bsec_iot_phase_t phase) {
+    return ctx->stack_free[phase];
+}
+
+/*!
+ * @brief       Continue a CRC-32 (IEEE 802.3) computation over a buffer
+ *
+ * @param[in]   crc                 CRC of the preceding data, zero to start
+ * @param[in]   data                data
+ * @param[in]   length              length of the data
+ *
+ * @return      CRC of the preceding data and the buffer
+ */
+uint32_t bsec_iot_crc32(uint32_t crc, const uint8_t *data, uint32_t length) {
+    uint32_t i;
+    uint8_t bit;
+
+    crc = ~crc;
+    for (i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (UINT32_C(0xEDB88320) & -(crc & 1));
+        }
+    }
+
+    return ~crc;
+}
+
+/*!
+ * @brief       Snapshot of the instrumentation counters of a sensor
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[out]  stats               snapshot of the counters
+ *
+ * @return      zero if successful, negative if the instrumentation is not built in
+ */
+int8_t bsec_iot_get_stats(const bsec_iot_ctx_t *ctx, bsec_iot_stats_t *stats) {
+#if BSEC_IOT_INSTRUMENT
+    *stats = ctx->stats;
+    stats->bus = ctx->bus_stats;
+
+    return 0;
+#else
+    memset(stats, 0, sizeof(*stats));
+    stats->bus = ctx->bus_stats;
+
+    return -1;
+#endif
+}
+
+/*!
+ * @brief       Runs a single phase of the acquisition cycle of a sensor without blocking
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      absolute timestamp (in microseconds) at which bsec_iot_step() has to be called next
+ */
+int64_t bsec_iot_step(bsec_iot_ctx_t *ctx, int64_t now_us) {
+    int64_t deadline = now_us;
+    bsec_iot_phase_t phase = ctx->phase;
+    uint8_t i;
+    uint32_t meas_dur;
+    int64_t cpu_start_us;
+    int64_t start_delay_us;
+#ifdef ESP_PLATFORM
+    uint32_t stack_free;
+#endif
+#if BSEC_IOT_INSTRUMENT
+    int64_t start_us;
+#endif
+
+    /* Nothing to do before the deadline returned by the previous call, unless the processing brought it forward */
+    bsec_iot_apply_control(ctx, now_us);
+    if (now_us < ctx->deadline) {
+        return ctx->deadline;
+    }
+    cpu_start_us = bme68x_bsec_stat_now_us();
+    start_delay_us = ctx->activity.delay_us;
+    ctx->activity.n_phases++;
+
+#if BSEC_IOT_INSTRUMENT
+    start_us = bme68x_bsec_stat_now_us();
+
+    /* Lateness of the cycle versus the next_call of the previous one, which the deadline of this phase stems from */
+    if (ctx->phase == BSEC_IOT_PHASE_CONTROL && ctx->next_call != 0 && now_us > ctx->deadline) {
+        ctx->stats.n_missed_deadlines++;
+        ctx->stats.missed_time_us += now_us - ctx->deadline;
+        if (now_us - ctx->deadline > ctx->stats.missed_max_us) {
+            ctx->stats.missed_max_us = (uint32_t)(now_us - ctx->deadline);
+        }
+    }
+#endif
+
+    switch (ctx->phase) {
+    case BSEC_IOT_PHASE_CONTROL:
+        /* A cycle dropped by the overrun policy waits for its next slot */
+        if (!bme68x_bsec_start_cycle(ctx, now_us)) {
+            deadline = ctx->next_call / 1000;
+            break;
+        }
+
+        /* Retrieve sensor settings to be used in this time instant by calling bsec_sensor_control, the timestamp is
+         * handed over in nanoseconds. The lock is only held while BSEC is called, the bus transfers of the cycle are
+         * done without it so that the processing of another task never holds them up. */
+        bme68x_bsec_lock(ctx, 1);
+        bsec_sensor_control_m(ctx->bsec_inst, ctx->time_stamp, &ctx->sensor_settings);
+        bme68x_bsec_lock(ctx, 0);
+        ctx->next_call = ctx->sensor_settings.next_call;
+        if (ctx->next_call > ctx->time_stamp) {
+            ctx->period_us = (ctx->next_call - ctx->time_stamp) / 1000;
+        }
+        ctx->phase = BSEC_IOT_PHASE_TRIGGER;
+        break;
+
+    case BSEC_IOT_PHASE_TRIGGER:
+        /* Trigger a measurement if necessary and come back once it is expected to be complete. With interrupt
+         * completion this deadline only serves as a timeout, bsec_iot_notify_data_ready() brings it forward. */
+        bme68x_bsec_account_parallel(ctx, now_us);
+        meas_dur = bme68x_bsec_trigger_measurement(ctx, &ctx->sensor_settings);
+        ctx->meas_end = now_us + meas_dur;
+        bme68x_bsec_account_parallel(ctx, now_us);
+        ctx->meas_pending = (ctx->op_mode == BME68X_FORCED_MODE);
+        ctx->n_retries = 0;
+        ctx->max_retries = BSEC_IOT_RETRY_LIMIT * meas_dur / BSEC_IOT_RETRY_PERIOD_US + 1;
+        deadline = ctx->meas_pending ? ctx->meas_end + ctx->completion_margin_us : now_us;
+        ctx->phase = BSEC_IOT_PHASE_READ;
+        break;
+
+    case BSEC_IOT_PHASE_READ:
+        if (ctx->meas_pending) {
+            /* Read data from last measurement, or come back a little later if it turns out not to be complete yet. An
+             * asynchronous read of the data is waited for first, the operation mode having been polled before it. */
+            if (ctx->completion == BSEC_IOT_COMPLETION_OPMODE && !ctx->async_started &&
+                !bme68x_bsec_measurement_done(ctx)) {
+                deadline = bme68x_bsec_retry_read(ctx, now_us);
                 break;
-            case BSEC_OUTPUT_RAW_HUMIDITY:
-                raw_humidity = bsec_outputs[index].signal;
+            }
+            if (!bme68x_bsec_fetch_data(ctx, now_us, &deadline)) {
                 break;
-            case BSEC_OUTPUT_COMPENSATED_GAS:
-                comp_gas_value = bsec_outputs[index].signal;
-                comp_gas_accuracy = bsec_outputs[index].accuracy;
+            }
+            if (!bme68x_bsec_read_data(ctx, ctx->time_stamp, ctx->sensor_settings.process_data)) {
+                deadline = bme68x_bsec_retry_read(ctx, now_us);
                 break;
-            case BSEC_OUTPUT_GAS_PERCENTAGE:
-                gas_percentage = bsec_outputs[index].signal;
-                gas_percentage_acccuracy = bsec_outputs[index].accuracy;
+            }
+            bme68x_bsec_update_margin(ctx, now_us);
+            ctx->meas_pending = 0;
+        } else {
+            /* Read the fields measured so far in parallel mode, if any */
+            if (!bme68x_bsec_fetch_data(ctx, now_us, &deadline)) {
                 break;
-            default:
+            }
+            bme68x_bsec_read_data(ctx, ctx->time_stamp, ctx->sensor_settings.process_data);
+            bme68x_bsec_account_parallel(ctx, now_us);
+        }
+        ctx->phase = BSEC_IOT_PHASE_PROCESS;
+        break;
+
+    case BSEC_IOT_PHASE_PROCESS:
+        /* Time to invoke BSEC to perform the actual processing. BSEC takes a single sample of each input per call, so
+         * the fields read at once in parallel mode are processed one after the other. */
+        for (i = 0; i < ctx->n_fields; i++) {
+            if (ctx->input_sink != NULL) {
+                /* Processed by another task, which also traces them; a set the sink turns down is lost */
+                ctx->input_sink(ctx->input_sink_arg, ctx, &ctx->sensor_settings, ctx->bsec_inputs[i],
+                                ctx->num_bsec_inputs[i]);
                 continue;
             }
+            if (ctx->trace != NULL) {
+                ctx->trace(ctx->trace_arg, &ctx->sensor_settings, ctx->bsec_inputs[i], ctx->num_bsec_inputs[i]);
+            }
+            bme68x_bsec_process_data(ctx, ctx->bsec_inputs[i], ctx->num_bsec_inputs[i], ctx->output_ready);
+        }
 
-            /* Assume that all the returned timestamps are the same */
-            timestamp = bsec_outputs[index].time_stamp;
-        }
-
-        /* Pass the extracted outputs to the user provided output_ready() function. */
-        output_ready(timestamp,
-                     iaq,
-                     iaq_accuracy,
-                     temp,
-                     raw_temp,
-                     raw_pressure,
-                     humidity,
-                     raw_humidity,
-                     raw_gas,
-                     static_iaq,
-                     static_iaq_accuracy,
-                     co2_equivalent,
-                     co2_accuracy,
-                     breath_voc_equivalent,
-                     breath_voc_accuracy,
-                     comp_gas_value,
-                     comp_gas_accuracy,
-                     gas_percentage,
-                     gas_percentage_acccuracy,
-                     bsec_status);
+        /* Increment sample counter and save the state once the save_intvl has passed */
+        ctx->n_samples++;
+        if (ctx->state_save != NULL && ctx->n_samples >= ctx->save_intvl) {
+            ctx->phase = BSEC_IOT_PHASE_SAVE;
+            break;
+        }
+
+        ctx->phase = BSEC_IOT_PHASE_CONTROL;
+        deadline = ctx->next_call / 1000;
+        break;
+
+    case BSEC_IOT_PHASE_SAVE:
+        /* Retrieve and store state, or have the task processing the inputs do it after them */
+        if (ctx->input_sink != NULL) {
+            if (ctx->input_sink(ctx->input_sink_arg, ctx, NULL, NULL, 0)) {
+                ctx->n_samples = 0;
+            }
+        } else {
+            bsec_iot_save_state(ctx, ctx->state_save);
+            ctx->n_samples = 0;
+        }
+
+        ctx->phase = BSEC_IOT_PHASE_CONTROL;
+        deadline = ctx->next_call / 1000;
+        break;
     }
+
+    /* The process and save phases account for their own time */
+    if (phase != BSEC_IOT_PHASE_PROCESS && phase != BSEC_IOT_PHASE_SAVE) {
+        bme68x_bsec_account_cpu(ctx, cpu_start_us, ctx->activity.delay_us - start_delay_us);
+    }
+
+#ifdef ESP_PLATFORM
+    /* On ESP-IDF the high-water mark is given in bytes */
+    stack_free = uxTaskGetStackHighWaterMark(NULL);
+    if (ctx->stack_free[phase] == 0 || stack_free < ctx->stack_free[phase]) {
+        ctx->stack_free[phase] = stack_free;
+    }
+#else
+    (void)phase;
+#endif
+
+#if BSEC_IOT_INSTRUMENT
+    ctx->stats.phase_count[phase]++;
+    bme68x_bsec_stat_time(start_us, &ctx->stats.phase_time_us[phase], &ctx->stats.phase_max_us[phase]);
+#endif
+
+    ctx->deadline = deadline;
+
+    /* The processing just done by this call may have asked for the next cycle right away */
+    bsec_iot_apply_control(ctx, now_us);
+
+    return ctx->deadline;
 }
 
 /*!
  * @brief       Runs the main (endless) loop that queries sensor settings, applies them, and processes the measured data
+ *              for all the given sensors
  *
+ * @param[in]   ctxs                array of initialized sensor contexts
+ * @param[in]   n_ctxs              number of sensor contexts in ctxs
  * @param[in]   sleep               pointer to the system specific sleep function
  * @param[in]   get_timestamp_us    pointer to the system specific timestamp derivation function
  * @param[in]   output_ready        pointer to the function processing obtained BSEC outputs
@@ -419,63 +2131,37 @@ static void bme68x_bsec_process_data(bsec_input_t* bsec_inputs, uint8_t num_bsec
  *
  * @return      none
  */
-_Noreturn void bsec_iot_loop(bme68x_delay_us_fptr_t sleep, get_timestamp_us_fct get_timestamp_us, output_ready_fct output_ready,
+_Noreturn void bsec_iot_loop(bsec_iot_ctx_t *ctxs, uint8_t n_ctxs, bme68x_delay_us_fptr_t sleep,
+                             get_timestamp_us_fct get_timestamp_us, output_ready_fct output_ready,
                              state_save_fct state_save, uint32_t save_intvl) {
     /* Timestamp variables */
-    int64_t time_stamp = 0;
+    int64_t deadline = 0;
+    int64_t next_deadline = 0;
     int64_t time_stamp_interval_us = 0;
+    int64_t now_us;
+    uint8_t i;
 
-    /* Allocate enough memory for up to BSEC_MAX_PHYSICAL_SENSOR physical inputs*/
-    bsec_input_t bsec_inputs[BSEC_MAX_PHYSICAL_SENSOR];
-
-    /* Number of inputs to BSEC */
-    uint8_t num_bsec_inputs = 0;
-
-    /* BSEC sensor settings struct */
-    bsec_bme_settings_t sensor_settings;
-
-    /* Save state variables */
-    uint8_t bsec_state[BSEC_MAX_STATE_BLOB_SIZE];
-    uint8_t work_buffer[BSEC_MAX_WORKBUFFER_SIZE];
-    uint32_t bsec_state_len = 0;
-    uint32_t n_samples = 0;
-
-    bsec_library_return_t bsec_status = BSEC_OK;
+    for (i = 0; i < n_ctxs; i++) {
+        bsec_iot_set_handlers(&ctxs[i], output_ready, state_save, save_intvl);
+    }
 
     while (1) {
-        /* get the timestamp in nanoseconds before calling bsec_sensor_control() */
-        time_stamp = get_timestamp_us() * 1000;
-
-        /* Retrieve sensor settings to be used in this time instant by calling bsec_sensor_control */
-        bsec_sensor_control(time_stamp, &sensor_settings);
-
-        /* Trigger a measurement if necessary */
-        bme68x_bsec_trigger_measurement(&sensor_settings, sleep);
-
-        /* Read data from last measurement */
-        num_bsec_inputs = 0;
-        bme68x_bsec_read_data(time_stamp, bsec_inputs, &num_bsec_inputs, sensor_settings.process_data);
-
-        /* Time to invoke BSEC to perform the actual processing */
-        bme68x_bsec_process_data(bsec_inputs, num_bsec_inputs, output_ready);
-
-        /* Increment sample counter */
-        n_samples++;
-
-        /* Retrieve and store state if the passed save_intvl */
-        if (n_samples >= save_intvl) {
-            bsec_status = bsec_get_state(0, bsec_state, sizeof(bsec_state), work_buffer, sizeof(work_buffer), &bsec_state_len);
-            if (bsec_status == BSEC_OK) {
-                state_save(bsec_state, bsec_state_len);
+        /* Run whatever phase is due for each of the sensors and keep track of the earliest next deadline. The sensors
+         * are all checked against a single reading of the time. */
+        now_us = get_timestamp_us();
+        next_deadline = INT64_MAX;
+        for (i = 0; i < n_ctxs; i++) {
+            deadline = bsec_iot_step(&ctxs[i], now_us);
+            if (deadline < next_deadline) {
+                next_deadline = deadline;
             }
-            n_samples = 0;
         }
 
-        /* Compute how long we can sleep until we need to call bsec_sensor_control() next */
-        /* Time_stamp is converted from microseconds to nanoseconds first and then the difference to microseconds */
-        time_stamp_interval_us = (sensor_settings.next_call - get_timestamp_us() * 1000) / 1000;
+        /* Compute how long we can sleep until one of the sensors needs attention again. The deadlines are absolute, so
+         * the time spent running the phases does not shift the schedule. */
+        time_stamp_interval_us = next_deadline - get_timestamp_us();
         if (time_stamp_interval_us > 0) {
-            sleep((uint32_t)time_stamp_interval_us, bme68x.intf_ptr);
+            sleep((uint32_t)time_stamp_interval_us, ctxs[0].intf_ptr);
         }
     }
 }
@@ -88,45 +88,80 @@ extern "C"
 #include "bsec_interface.h"
 #include "bsec_datatypes.h"
 
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Set to 1 (e.g. with target_compile_definitions()) to keep the counters of bsec_iot_stats_t in each sensor context.
+ * The application has to be built with the same setting as the integration since it changes struct bsec_iot_ctx. */
+#ifndef BSEC_IOT_INSTRUMENT
+#define BSEC_IOT_INSTRUMENT 0
+#endif
+
+/* Functions that never return, declared so that the header can be included from C++ as well */
+#ifdef __cplusplus
+#define BSEC_IOT_NORETURN [[noreturn]]
+#else
+#define BSEC_IOT_NORETURN _Noreturn
+#endif
+
+/* Span of the registers fetched by a single burst read on SPI, or by an asynchronous read on either bus: the three
+ * data fields, followed by the heater current, resistance and duration registers the sensor API reads back along with
+ * them */
+#define BSEC_IOT_BURST_LEN (BME68X_REG_GAS_WAIT0 + 10 - BME68X_REG_FIELD0)
+
+/* Size (in bytes) of a retained buffer holding whatever bsec_iot_suspend() may write: the image, the configuration
+ * and the state of BSEC */
+#define BSEC_IOT_RETAINED_SIZE (sizeof(bsec_iot_retained_t) + BSEC_MAX_PROPERTY_BLOB_SIZE + BSEC_MAX_STATE_BLOB_SIZE)
 
 /**********************************************************************************************************************/
 /* type definitions */
 /**********************************************************************************************************************/
 
+/* per-sensor context, see struct bsec_iot_ctx below */
+typedef struct bsec_iot_ctx bsec_iot_ctx_t;
+
+/* outputs of one processing step, see struct bsec_iot_output below */
+typedef struct bsec_iot_output bsec_iot_output_t;
+
 /* function pointer to the system specific timestamp derivation function */
 typedef int64_t (*get_timestamp_us_fct)();
 
 /* function pointer to the function processing obtained BSEC outputs */
-typedef void (*output_ready_fct)(
-        int64_t timestamp,
-        float iaq,
-        uint8_t iaq_accuracy,
-        float temp,
-        float raw_temp,
-        float raw_pressure,
-        float humidity,
-        float raw_humidity,
-        float raw_gas,
-        float static_iaq,
-        uint8_t static_iaq_accuracy,
-        float co2_equivalent,
-        uint8_t co2_accuracy,
-        float breath_voc_equivalent,
-        uint8_t breath_voc_accuracy,
-        float comp_gas_value,
-        uint8_t comp_gas_accuracy,
-        float gas_percentage,
-        uint8_t gas_percentage_acccuracy,
-        bsec_library_return_t bsec_status);
+typedef void (*output_ready_fct)(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output);
+
+/* function pointer to the function deciding whether obtained BSEC outputs are handed to output_ready, returning
+ * non-zero to hand them over, see bsec_iot_set_output_filter() */
+typedef uint8_t (*output_filter_fct)(void *filter_arg, const bsec_iot_output_t *output);
+
+/* function pointer to the function recording the inputs handed to BSEC along with the settings they were measured
+ * with, see bsec_iot_set_trace() */
+typedef void (*input_trace_fct)(void *trace_arg, const bsec_bme_settings_t *settings, const bsec_input_t *inputs,
+                                uint8_t n_inputs);
+
+/* function pointer to the function taking over the inputs read for a sample from bsec_iot_step(), or the request to
+ * save the state when n_inputs is zero; returns zero if they could not be taken, see bsec_iot_set_input_sink() */
+typedef uint8_t (*input_sink_fct)(void *sink_arg, bsec_iot_ctx_t *ctx, const bsec_bme_settings_t *settings,
+                                  const bsec_input_t *inputs, uint8_t n_inputs);
+
+/* function pointer to the function taking (take non-zero) or giving back (take zero) the lock of a sensor, see
+ * bsec_iot_set_lock() */
+typedef void (*ctx_lock_fct)(void *lock_arg, uint8_t take);
+
+/* function pointer to the function starting a read of length bytes from reg_addr into reg_data and returning without
+ * waiting for it; returns BME68X_INTF_RET_SUCCESS if the read was started, its end being reported with
+ * bsec_iot_bus_done(), see bsec_iot_set_async_read() */
+typedef BME68X_INTF_RET_TYPE (*bus_read_async_fct)(void *read_async_arg, bsec_iot_ctx_t *ctx, uint8_t reg_addr,
+                                                   uint8_t *reg_data, uint32_t length);
 
 /* function pointer to the function loading a previous BSEC state from NVM */
-typedef uint32_t (*state_load_fct)(uint8_t *state_buffer, uint32_t n_buffer);
+typedef uint32_t (*state_load_fct)(bsec_iot_ctx_t *ctx, uint8_t *state_buffer, uint32_t n_buffer);
 
 /* function pointer to the function saving BSEC state to NVM */
-typedef void (*state_save_fct)(const uint8_t *state_buffer, uint32_t length);
+typedef void (*state_save_fct)(bsec_iot_ctx_t *ctx, const uint8_t *state_buffer, uint32_t length);
 
 /* function pointer to the function loading the BSEC configuration string from NVM */
-typedef uint32_t (*config_load_fct)(uint8_t *state_buffer, uint32_t n_buffer);
+typedef uint32_t (*config_load_fct)(bsec_iot_ctx_t *ctx, uint8_t *state_buffer, uint32_t n_buffer);
     
 /* structure definitions */
 
@@ -137,38 +172,895 @@ typedef struct {
 	/*! Result of BSEC library */
 	bsec_library_return_t bsec_status;
 } return_values_init;
+
+/* Phases of the acquisition cycle of a sensor, run one at a time by bsec_iot_step() */
+typedef enum {
+	/*! Query the sensor settings through bsec_sensor_control() */
+	BSEC_IOT_PHASE_CONTROL = 0,
+	/*! Apply the settings and trigger a measurement if requested */
+	BSEC_IOT_PHASE_TRIGGER,
+	/*! Wait for the measurement to complete and read its data */
+	BSEC_IOT_PHASE_READ,
+	/*! Hand the data to BSEC and the outputs to the application */
+	BSEC_IOT_PHASE_PROCESS,
+	/*! Retrieve and store the BSEC state */
+	BSEC_IOT_PHASE_SAVE
+} bsec_iot_phase_t;
+
+/* Number of phases of the acquisition cycle */
+#define BSEC_IOT_NUM_PHASES (BSEC_IOT_PHASE_SAVE + 1)
+
+/* Ways for bsec_iot_step() to find out that a measurement is complete. In both modes the data is first read once the
+ * expected measurement duration plus a margin learned from the observed completion times has passed. */
+typedef enum {
+	/*! Rely on the new data flag read along with the data, no extra bus transfer when the data is ready */
+	BSEC_IOT_COMPLETION_NEW_DATA = 0,
+	/*! Poll the operation mode until the sensor leaves forced mode before reading the data */
+	BSEC_IOT_COMPLETION_OPMODE
+} bsec_iot_completion_t;
+
+/* What bsec_iot_step() does with a cycle that starts later than the overrun tolerance after the next_call requested
+ * by BSEC. Cycles within the tolerance are always handed to BSEC with the time stamp they were scheduled at, so that
+ * wakeup latencies do not accumulate in the time stamps. */
+typedef enum {
+	/*! Run the late cycle at once with its actual time stamp, the following cycles are scheduled from it */
+	BSEC_IOT_OVERRUN_RESYNC = 0,
+	/*! Run the late cycle at once with the time stamp it was scheduled at, the following cycles keep their schedule
+	 * and run back to back until the sensor is on time again */
+	BSEC_IOT_OVERRUN_CATCH_UP,
+	/*! Drop the late cycle and wait for the next slot of the schedule, which runs with its scheduled time stamp */
+	BSEC_IOT_OVERRUN_SKIP
+} bsec_iot_overrun_t;
+
+/* Dense identifiers of the BSEC outputs, used as index into the arrays of bsec_iot_output_t */
+typedef enum {
+	/*! Indoor-air-quality estimate [0-500] */
+	BSEC_IOT_OUTPUT_IAQ = 0,
+	/*! Unscaled indoor-air-quality estimate */
+	BSEC_IOT_OUTPUT_STATIC_IAQ,
+	/*! CO2 equivalent estimate [ppm] */
+	BSEC_IOT_OUTPUT_CO2_EQUIVALENT,
+	/*! Breath VOC concentration estimate [ppm] */
+	BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT,
+	/*! Temperature directly measured by BME68X [degrees Celsius] */
+	BSEC_IOT_OUTPUT_RAW_TEMPERATURE,
+	/*! Pressure directly measured by BME68X [Pa] */
+	BSEC_IOT_OUTPUT_RAW_PRESSURE,
+	/*! Relative humidity directly measured by BME68X [%] */
+	BSEC_IOT_OUTPUT_RAW_HUMIDITY,
+	/*! Gas resistance directly measured by BME68X [Ohm] */
+	BSEC_IOT_OUTPUT_RAW_GAS,
+	/*! Gas sensor stabilization status [boolean] */
+	BSEC_IOT_OUTPUT_STABILIZATION_STATUS,
+	/*! Gas sensor run-in status [boolean] */
+	BSEC_IOT_OUTPUT_RUN_IN_STATUS,
+	/*! Temperature compensated for the heat sources of the device [degrees Celsius] */
+	BSEC_IOT_OUTPUT_TEMPERATURE,
+	/*! Relative humidity compensated for the heat sources of the device [%] */
+	BSEC_IOT_OUTPUT_HUMIDITY,
+	/*! Gas resistance compensated for temperature and humidity influences [log(Ohm)] */
+	BSEC_IOT_OUTPUT_COMPENSATED_GAS,
+	/*! Percentage of the minimum and maximum gas resistance seen [%] */
+	BSEC_IOT_OUTPUT_GAS_PERCENTAGE,
+	/*! Probability of the first trained gas class, followed by the other three classes [%] */
+	BSEC_IOT_OUTPUT_GAS_ESTIMATE_1,
+	BSEC_IOT_OUTPUT_GAS_ESTIMATE_2,
+	BSEC_IOT_OUTPUT_GAS_ESTIMATE_3,
+	BSEC_IOT_OUTPUT_GAS_ESTIMATE_4,
+	/*! Index of the heater profile step the gas sample was taken at */
+	BSEC_IOT_OUTPUT_RAW_GAS_INDEX,
+	/*! Number of outputs, not an output */
+	BSEC_IOT_NUM_OUTPUTS
+} bsec_iot_output_id_t;
+
+/* Bit of an output in the valid_mask of bsec_iot_output_t */
+#define BSEC_IOT_OUTPUT_MASK(id) (UINT32_C(1) << (id))
+
+/* Structure with the outputs of one processing step of BSEC. Only the outputs whose bit is set in valid_mask were
+ * produced by this step; the value and accuracy of the others are left undefined. */
+struct bsec_iot_output {
+	/*! Time stamp (in nanoseconds) of the outputs */
+	int64_t timestamp;
+	/*! Bit mask of the outputs produced, see BSEC_IOT_OUTPUT_MASK() */
+	uint32_t valid_mask;
+	/*! Bit mask of the outputs subscribed to when the step was processed */
+	uint32_t subscribed_mask;
+	/*! Result of bsec_do_steps() */
+	bsec_library_return_t bsec_status;
+	/*! Value of the outputs, indexed by bsec_iot_output_id_t */
+	float value[BSEC_IOT_NUM_OUTPUTS];
+	/*! Accuracy status of the outputs [0-3], indexed by bsec_iot_output_id_t */
+	uint8_t accuracy[BSEC_IOT_NUM_OUTPUTS];
+};
+
+/* Structure with the settings of the adaptive sample rate, see bsec_iot_set_adaptive() */
+typedef struct {
+	/*! IAQ change (in IAQ points per minute) above which LP mode is entered, zero to ignore the IAQ */
+	float iaq_slope;
+	/*! Breath VOC change (in ppm per minute) above which LP mode is entered, zero to ignore the breath VOC */
+	float voc_slope;
+	/*! Time (in seconds) LP mode is kept after the last threshold crossing or trigger */
+	uint32_t hold_off_s;
+} bsec_iot_adaptive_t;
+
+/* Size (in bytes) of the scratch area at the start of an arena, holding the configuration or state blob along with
+ * the work buffer BSEC needs to parse or serialize it */
+#define BSEC_IOT_ARENA_SCRATCH_SIZE \
+	(((BSEC_MAX_PROPERTY_BLOB_SIZE > BSEC_MAX_STATE_BLOB_SIZE ? BSEC_MAX_PROPERTY_BLOB_SIZE : BSEC_MAX_STATE_BLOB_SIZE) + \
+	  BSEC_MAX_WORKBUFFER_SIZE + 3) & ~3)
+
+/* Size (in bytes) of an arena serving n_sensors sensors, for static allocation; see also bsec_iot_arena_size() */
+#define BSEC_IOT_ARENA_SIZE(n_sensors) (BSEC_IOT_ARENA_SCRATCH_SIZE + (n_sensors) * ((BSEC_INSTANCE_SIZE + 3) & ~3))
+
+/* Structure describing the memory provided by the application for the BSEC instances and buffers. The scratch area
+ * is shared by all the sensors of an arena: it is serialized by the lock of the arena when the sensors are initialized,
+ * saved or suspended from different tasks, e.g. with a pipeline. */
+typedef struct {
+	/*! Memory of the arena, aligned on 4 bytes */
+	uint8_t *mem;
+	/*! Size of the memory (in bytes) */
+	uint32_t size;
+	/*! Number of bytes used by the scratch area and the BSEC instances so far */
+	uint32_t used;
+	/*! Function taking or giving back the scratch area, NULL when it is only used from one task */
+	ctx_lock_fct lock;
+	/*! Pointer handed to the lock function */
+	void *lock_arg;
+} bsec_iot_arena_t;
+
+/* Structure with the timing statistics of the cycles of a sensor, relative to the next_call requested by BSEC */
+typedef struct {
+	/*! Number of cycles run */
+	uint32_t n_cycles;
+	/*! Cumulative lateness (in microseconds) of the cycles within the overrun tolerance */
+	int64_t jitter_sum_us;
+	/*! Largest lateness (in microseconds) of a cycle within the overrun tolerance */
+	uint32_t jitter_max_us;
+	/*! Number of cycles later than the overrun tolerance */
+	uint32_t n_overruns;
+	/*! Largest lateness (in microseconds) of a cycle beyond the overrun tolerance */
+	uint32_t overrun_max_us;
+	/*! Number of cycles dropped by BSEC_IOT_OVERRUN_SKIP */
+	uint32_t n_skipped;
+} bsec_iot_timing_stats_t;
+
+/* Structure with the timing of the start of a sensor, measured on the monotonic clock of the system */
+typedef struct {
+	/*! Time (in microseconds) bsec_iot_init() took */
+	uint32_t init_us;
+	/*! Time (in microseconds) spent loading and applying the configuration */
+	uint32_t config_us;
+	/*! Time (in microseconds) spent loading and applying the state */
+	uint32_t state_us;
+	/*! Time (in microseconds) from the start of bsec_iot_init() to the first outputs, zero until then */
+	uint32_t boot_to_output_us;
+	/*! CRC-32 of the configuration applied, zero when BSEC runs its default configuration */
+	uint32_t config_fingerprint;
+	/*! Set when a saved state was restored, i.e. the sensor started warm */
+	uint8_t state_restored;
+	/*! Set when the sensor was resumed by bsec_iot_resume() rather than initialized */
+	uint8_t resumed;
+} bsec_iot_boot_stats_t;
+
+/* Structure with what a sensor did, which its charge consumption is estimated from (see bsec_energy.h). The sensor
+ * times are nominal ones from the settings; the parallel mode ones are taken from the time spent in the mode. */
+typedef struct {
+	/*! Number of forced mode measurements triggered */
+	uint32_t n_measurements;
+	/*! Number of sets of inputs processed by BSEC */
+	uint32_t n_steps;
+	/*! Number of phases run by bsec_iot_step() */
+	uint32_t n_phases;
+	/*! Time (in microseconds) the sensor spent in TPH conversions */
+	int64_t tph_us;
+	/*! Time (in microseconds) the gas sensor heater was on */
+	int64_t heater_us;
+	/*! Time (in microseconds) spent running the integration, bus transfers and BSEC, delays excluded */
+	int64_t cpu_us;
+	/*! Time (in microseconds) the sensor API waited through the sleep function */
+	int64_t delay_us;
+} bsec_iot_activity_t;
+
+/* Structure with the bus traffic counters of a sensor */
+typedef struct {
+	/*! Number of bus read transfers */
+	uint32_t n_reads;
+	/*! Number of bus write transfers */
+	uint32_t n_writes;
+	/*! Number of bytes read from the bus */
+	uint32_t n_bytes_read;
+	/*! Number of bytes written to the bus */
+	uint32_t n_bytes_written;
+	/*! Number of sensor or heater configuration writes skipped because the sensor already had the settings */
+	uint32_t n_config_writes_skipped;
+	/*! Number of bus transfers saved by the register shadow or served from the burst read buffer */
+	uint32_t n_transfers_saved;
+	/*! Number of reads started asynchronously, included in n_reads */
+	uint32_t n_async_reads;
+	/*! Number of asynchronous reads that failed or timed out, the data being read by the blocking functions instead */
+	uint32_t n_async_failures;
+} bsec_iot_bus_stats_t;
+
+/* Structure at the start of a retained buffer written by bsec_iot_suspend(), followed by the configuration and the
+ * state of BSEC. Only meant to be read back by bsec_iot_resume() of the same firmware. */
+typedef struct {
+	/*! Magic number telling a complete image of this layout */
+	uint32_t magic;
+	/*! CRC-32 of the image from length on and of the state, the configuration left out */
+	uint32_t crc;
+	/*! Number of bytes of the image, configuration and state included */
+	uint32_t length;
+	/*! Size (in bytes) of the BSEC instance the image was taken from */
+	uint32_t inst_size;
+	/*! CRC-32 of the retained configuration, so that it is only written once */
+	uint32_t config_crc;
+	/*! Fingerprint of the configuration applied, see bsec_iot_boot_stats_t */
+	uint32_t config_fingerprint;
+	/*! Length of the retained configuration, zero when BSEC runs its default configuration */
+	uint16_t config_len;
+	/*! Length of the retained state */
+	uint16_t state_len;
+	/*! Sensor API device with the calibration of the sensor, the function and interface pointers left out */
+	struct bme68x_dev dev;
+	/*! I2C address or chip select index of the sensor */
+	uint8_t dev_addr;
+	/*! Bit mask of the register groups whose shadow matches the sensor */
+	uint8_t shadow_valid;
+	/*! Sensor configuration last written to the sensor */
+	struct bme68x_conf conf_shadow;
+	/*! Heater configuration last written to the sensor */
+	struct bme68x_heatr_conf heatr_shadow;
+	/*! Number of bus transfers the last sensor configuration write took */
+	uint32_t conf_shadow_cost;
+	/*! Number of bus transfers the last heater configuration write took */
+	uint32_t heatr_shadow_cost;
+	/*! Margin (in microseconds) added to the expected measurement duration */
+	uint32_t completion_margin_us;
+	/*! Sample rate the subscribed outputs were last switched to */
+	float sample_rate;
+	/*! Outputs subscribed to, each with its own sample rate */
+	bsec_sensor_configuration_t subscription[BSEC_IOT_NUM_OUTPUTS];
+	/*! Number of entries in subscription */
+	uint8_t n_subscribed;
+	/*! Device-specific temperature offset */
+	float temperature_offset;
+	/*! Time (in nanoseconds) at which bsec_sensor_control() asked to be called next */
+	int64_t next_call;
+	/*! Sample period (in microseconds) */
+	int64_t period_us;
+	/*! Number of samples processed since the last state save */
+	uint32_t n_samples;
+	/*! Activity counters, carried on for the charge estimate */
+	bsec_iot_activity_t activity;
+	/*! Bus traffic counters, carried on for the charge estimate */
+	bsec_iot_bus_stats_t bus_stats;
+} bsec_iot_retained_t;
+
+/* Structure with the instrumentation counters of a sensor, see bsec_iot_get_stats(). Times are in microseconds. */
+typedef struct {
+	/*! Number of runs of each phase of the acquisition cycle */
+	uint32_t phase_count[BSEC_IOT_NUM_PHASES];
+	/*! Cumulative time spent in each phase */
+	int64_t phase_time_us[BSEC_IOT_NUM_PHASES];
+	/*! Longest run of each phase */
+	uint32_t phase_max_us[BSEC_IOT_NUM_PHASES];
+	/*! Number of operation mode reads polling for the completion of a measurement */
+	uint32_t n_opmode_polls;
+	/*! Bus traffic counters */
+	bsec_iot_bus_stats_t bus;
+	/*! Number of sensor API calls that failed */
+	uint32_t n_bme68x_errors;
+	/*! Last result other than BME68X_OK returned by the sensor API */
+	int8_t last_bme68x_status;
+	/*! Number of cycles that called bsec_sensor_control() later than requested through next_call */
+	uint32_t n_missed_deadlines;
+	/*! Cumulative delay of the late cycles */
+	int64_t missed_time_us;
+	/*! Longest delay of a late cycle */
+	uint32_t missed_max_us;
+	/*! Number of data fields dropped because the new data flag was not set */
+	uint32_t n_dropped_new_data;
+	/*! Number of gas samples dropped because the gas valid flag was not set */
+	uint32_t n_dropped_gas_invalid;
+	/*! Number of forced mode measurements given up because their data never came */
+	uint32_t n_read_timeouts;
+	/*! Number of state saves */
+	uint32_t n_state_saves;
+	/*! Cumulative time spent retrieving and storing the state */
+	int64_t state_save_time_us;
+	/*! Longest state save */
+	uint32_t state_save_max_us;
+} bsec_iot_stats_t;
+
+/* Structure holding one BME68X sensor together with its own BSEC instance. Allocate one per sensor (statically or
+ * on the heap) and pass it to every bsec_iot_*() call; the members are managed by the integration. */
+struct bsec_iot_ctx {
+	/*! Sensor API device structure of this sensor */
+	struct bme68x_dev bme68x;
+	/*! I2C address or SPI chip select of this sensor, handed to the bus functions when no interface pointer is given */
+	uint8_t dev_addr;
+	/*! Interface pointer handed to the user bus and sleep functions */
+	void *intf_ptr;
+	/*! User bus writing function */
+	bme68x_write_fptr_t bus_write;
+	/*! User bus reading function */
+	bme68x_read_fptr_t bus_read;
+	/*! User sleep function */
+	bme68x_delay_us_fptr_t sleep;
+	/*! Bus traffic counters */
+	bsec_iot_bus_stats_t bus_stats;
+	/*! Bit mask of the register groups whose shadow below matches the sensor */
+	uint8_t shadow_valid;
+	/*! Sensor configuration last written to the sensor */
+	struct bme68x_conf conf_shadow;
+	/*! Heater configuration last written to the sensor */
+	struct bme68x_heatr_conf heatr_shadow;
+	/*! Number of bus transfers the last sensor configuration write took */
+	uint32_t conf_shadow_cost;
+	/*! Number of bus transfers the last heater configuration write took */
+	uint32_t heatr_shadow_cost;
+	/*! How the completion of a measurement is detected */
+	bsec_iot_completion_t completion;
+	/*! Time (in microseconds) at which the running measurement is nominally complete */
+	int64_t meas_end;
+	/*! Margin (in microseconds) added to the nominal measurement duration, learned from the observed completions */
+	uint32_t completion_margin_us;
+	/*! Number of completion checks that found the running measurement incomplete */
+	uint32_t n_retries;
+	/*! Number of completion checks after which the running measurement is given up */
+	uint32_t max_retries;
+	/*! Total number of completion checks that found a measurement incomplete */
+	uint32_t n_completion_retries;
+	/*! Set while the data is read only to check for completion */
+	uint8_t read_nonblocking;
+	/*! Set when a completion check read found no new data */
+	uint8_t read_aborted;
+	/*! Set while the data is read through burst below */
+	uint8_t read_burst;
+	/*! Number of valid bytes in burst, zero when it has to be read again */
+	uint8_t burst_len;
+	/*! Data fields and heater registers fetched by the last burst read */
+	uint8_t burst[BSEC_IOT_BURST_LEN];
+	/*! Function starting an asynchronous read of the data registers, NULL to read them through bus_read */
+	bus_read_async_fct bus_read_async;
+	/*! Pointer handed to the asynchronous read function */
+	void *bus_read_async_arg;
+	/*! Set once an asynchronous read was started for the current data read */
+	uint8_t async_started;
+	/*! Set while the asynchronous read runs, cleared by bsec_iot_bus_done() */
+	volatile uint8_t async_pending;
+	/*! Result of the last asynchronous read */
+	BME68X_INTF_RET_TYPE async_rslt;
+	/*! Time (in microseconds) at which the asynchronous read was started */
+	int64_t async_start_us;
+	/*! Device-specific temperature offset to be subtracted (due to self-heating) */
+	float temperature_offset;
+	/*! BSEC instance handle used with the multi-instance (*_m) BSEC API */
+	void *bsec_inst;
+	/*! Bit mask of the outputs currently subscribed to, see BSEC_IOT_OUTPUT_MASK() */
+	uint32_t subscribed_mask;
+	/*! Sample rate each output was last subscribed at, indexed by bsec_iot_output_id_t */
+	float output_rate[BSEC_IOT_NUM_OUTPUTS];
+	/*! Sample rate the subscribed outputs were last switched to */
+	float sample_rate;
+	/*! Set while the sample rate adapts to the air quality changes */
+	uint8_t adaptive_enabled;
+	/*! Settings of the adaptive sample rate */
+	bsec_iot_adaptive_t adaptive;
+	/*! Time (in microseconds) of the sample the slopes are computed from, zero if none */
+	int64_t slope_time;
+	/*! IAQ of the sample the slopes are computed from */
+	float slope_iaq;
+	/*! Breath VOC of the sample the slopes are computed from */
+	float slope_voc;
+	/*! Time (in microseconds) until which LP mode is kept */
+	int64_t lp_until;
+	/*! Number of switches between ULP and LP mode */
+	uint32_t n_rate_switches;
+	/*! Set by the processing of a sample to have the next cycle brought forward, applied by the task running
+	 * bsec_iot_step() which alone writes next_call and deadline; only accessed atomically */
+	volatile uint8_t control_requested;
+	/*! Time (in nanoseconds) at which bsec_sensor_control() has to be called next for this sensor, zero to call it
+	 * as soon as possible and schedule the following cycles from then */
+	int64_t next_call;
+	/*! Time (in microseconds) between the last two calls to bsec_sensor_control() requested by BSEC */
+	int64_t period_us;
+	/*! What bsec_iot_step() does with a cycle later than the overrun tolerance */
+	bsec_iot_overrun_t overrun;
+	/*! Lateness (in microseconds) beyond which a cycle is overrun, zero for 1/16 of the sample period */
+	uint32_t overrun_tolerance_us;
+	/*! Timing statistics of the cycles */
+	bsec_iot_timing_stats_t timing;
+	/*! Timing of the start of the sensor */
+	bsec_iot_boot_stats_t boot;
+	/*! Time (in microseconds, on the clock of the boot timing) at which bsec_iot_init() started */
+	int64_t boot_start_us;
+	/*! Activity counters */
+	bsec_iot_activity_t activity;
+	/*! Time (in microseconds) up to which the time in parallel mode is accounted for, zero out of parallel mode */
+	int64_t parallel_mark_us;
+	/*! Duration (in microseconds) of the TPH conversion of each parallel mode field */
+	uint32_t parallel_tph_us;
+	/*! Number of samples processed since the last state save */
+	uint32_t n_samples;
+	/*! Phase run by the next call to bsec_iot_step() */
+	bsec_iot_phase_t phase;
+	/*! Time (in microseconds) before which bsec_iot_step() has nothing to do */
+	int64_t deadline;
+	/*! Time (in nanoseconds) at which bsec_sensor_control() was called for the current sample */
+	int64_t time_stamp;
+	/*! Sensor settings returned by bsec_sensor_control() for the current sample */
+	bsec_bme_settings_t sensor_settings;
+	/*! Operation mode the sensor is currently in */
+	uint8_t op_mode;
+	/*! Set while a forced mode measurement triggered for the current sample is running */
+	uint8_t meas_pending;
+	/*! Inputs to BSEC read for the current sample, one set per data field */
+	bsec_input_t bsec_inputs[BME68X_N_MEAS][BSEC_MAX_PHYSICAL_SENSOR];
+	/*! Number of inputs in each set of bsec_inputs */
+	uint8_t num_bsec_inputs[BME68X_N_MEAS];
+	/*! Number of sets of bsec_inputs read for the current sample */
+	uint8_t n_fields;
+	/*! Function processing obtained BSEC outputs */
+	output_ready_fct output_ready;
+	/*! Function saving the BSEC state, NULL to never save it */
+	state_save_fct state_save;
+	/*! Interval at which BSEC state should be saved (in samples) */
+	uint32_t save_intvl;
+	/*! Function recording the inputs handed to BSEC, NULL if none */
+	input_trace_fct trace;
+	/*! Pointer handed to the trace function */
+	void *trace_arg;
+	/*! Function deciding which outputs reach output_ready, NULL to hand them all over */
+	output_filter_fct output_filter;
+	/*! Pointer handed to the output filter function */
+	void *output_filter_arg;
+	/*! Function taking over the inputs read, NULL to process them in bsec_iot_step() */
+	input_sink_fct input_sink;
+	/*! Pointer handed to the input sink function */
+	void *input_sink_arg;
+	/*! Function serializing the calls into the BSEC instance of the sensor, NULL if it is only used from one task */
+	ctx_lock_fct lock;
+	/*! Pointer handed to the lock function */
+	void *lock_arg;
+	/*! Arena holding the BSEC instance and the scratch buffers */
+	bsec_iot_arena_t *arena;
+	/*! Lowest free stack (in bytes) of the calling task observed after each phase, zero if not measured yet */
+	uint32_t stack_free[BSEC_IOT_NUM_PHASES];
+#if BSEC_IOT_INSTRUMENT
+	/*! Instrumentation counters, the bus counters are kept in bus_stats */
+	bsec_iot_stats_t stats;
+#endif
+	/*! Free for the application, e.g. to tell sensors apart in the callbacks */
+	void *user_data;
+};
+
 /**********************************************************************************************************************/
 /* function declarations */
 /**********************************************************************************************************************/
 
 /*!
- * @brief       Initialize the BME68X sensor and the BSEC library
+ * @brief       Size of the arena needed by a number of sensors
+ *
+ * @param[in]   n_sensors           number of sensors sharing the arena
+ *
+ * @return      size of the arena (in bytes)
+ */
+uint32_t bsec_iot_arena_size(uint8_t n_sensors);
+
+/*!
+ * @brief       Set up an arena from memory provided by the application, e.g. a static buffer or PSRAM
+ *
+ * The BSEC instances of the sensors initialized with the arena are taken from it, and their configuration and state
+ * are loaded and saved through its scratch area instead of the stack.
+ *
+ * @param[out]  arena               arena to set up
+ * @param[in]   mem                 memory of the arena, aligned on 4 bytes
+ * @param[in]   size                size of the memory, see bsec_iot_arena_size() or BSEC_IOT_ARENA_SIZE()
+ *
+ * @return      none
+ */
+void bsec_iot_arena_init(bsec_iot_arena_t *arena, void *mem, uint32_t size);
+
+/*!
+ * @brief       Set the function serializing the uses of the scratch area of an arena from different tasks
+ *
+ * The lock is held by bsec_iot_init() and bsec_iot_resume() while the configuration and the state are loaded, by
+ * bsec_iot_save_state() up to the return of the state save function, and by bsec_iot_suspend(). It is taken before the
+ * lock of a sensor, never after it. Not needed when all the sensors of the arena are initialized, saved and suspended
+ * from a single task.
+ *
+ * @param[in]   arena               arena of the sensors
+ * @param[in]   lock                pointer to the lock function, NULL for none
+ * @param[in]   lock_arg            pointer handed to the lock function, e.g. a mutex
+ *
+ * @return      none
+ */
+void bsec_iot_arena_set_lock(bsec_iot_arena_t *arena, ctx_lock_fct lock, void *lock_arg);
+
+/*!
+ * @brief       Initialize one BME68X sensor and its BSEC instance
+ *
+ * The virtual sensors requested are subscribed to, by default the outputs of the IAQ solution at sample_rate, or those
+ * of gas scanning with BSEC_SAMPLE_RATE_SCAN. Use bsec_iot_update_subscription() afterwards to change that.
+ *
+ * The configuration is loaded first and its fingerprint kept in ctx->boot, so that state_load can leave out a state
+ * saved under another configuration (see bsec_iot_persist_load()) instead of having BSEC reject it. The time the
+ * start takes, up to the first outputs, is kept in ctx->boot as well.
  *
+ * @param[out]  ctx                 context of the sensor to initialize
+ * @param[in]   intf                bus the sensor is on (BME68X_I2C_INTF or BME68X_SPI_INTF)
+ * @param[in]   dev_addr            I2C address of the sensor (BME68X_I2C_ADDR_LOW or BME68X_I2C_ADDR_HIGH), or index
+ *                                  of its chip select on SPI
+ * @param[in]   intf_ptr            pointer handed to the bus functions, NULL to hand a pointer to ctx->dev_addr
  * @param[in]   sample_rate         mode to be used (either BSEC_SAMPLE_RATE_ULP or BSEC_SAMPLE_RATE_LP)
+ * @param[in]   requested           virtual sensors and their sample rates, NULL for the default outputs at sample_rate
+ * @param[in]   n_requested         number of entries in requested
  * @param[in]   temperature_offset  device-specific temperature offset (due to self-heating)
  * @param[in]   bus_write           pointer to the bus writing function
  * @param[in]   bus_read            pointer to the bus reading function
  * @param[in]   sleep               pointer to the system-specific sleep function
  * @param[in]   state_load          pointer to the system-specific state load function
+ * @param[in]   config_load         pointer to the system-specific config load function
+ * @param[in]   arena               arena the BSEC instance of the sensor is taken from
  *
  * @return      zero if successful, negative otherwise
  */
-return_values_init bsec_iot_init(float sample_rate, float temperature_offset, bme68x_write_fptr_t bus_write, bme68x_read_fptr_t bus_read,
-                                 bme68x_delay_us_fptr_t sleep, state_load_fct state_load, config_load_fct config_load);
+return_values_init bsec_iot_init(bsec_iot_ctx_t *ctx, enum bme68x_intf intf, uint8_t dev_addr, void *intf_ptr,
+                                 float sample_rate, const bsec_sensor_configuration_t *requested, uint8_t n_requested,
+                                 float temperature_offset, bme68x_write_fptr_t bus_write, bme68x_read_fptr_t bus_read,
+                                 bme68x_delay_us_fptr_t sleep, state_load_fct state_load, config_load_fct config_load,
+                                 bsec_iot_arena_t *arena);
+
+/*!
+ * @brief       Keep what a sensor needs to resume in a buffer that survives deep sleep, e.g. in RTC memory
+ *
+ * Meant to be called between two acquisition cycles, i.e. when bsec_iot_step() returned the deadline of the next
+ * bsec_sensor_control() call, with the pipeline drained if there is one. The state of BSEC is written every time; the
+ * configuration only when the buffer does not hold it yet. Nothing is written to flash, so the state should still be
+ * saved there now and then for the cold starts.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[out]  retained            retained buffer, aligned on 8 bytes
+ * @param[in]   size                size of the buffer, BSEC_IOT_RETAINED_SIZE is always enough
+ *
+ * @return      number of bytes of the image, zero if the sensor is in the middle of a cycle or in parallel mode, the
+ *              buffer too small or the state could not be retrieved
+ */
+uint32_t bsec_iot_suspend(bsec_iot_ctx_t *ctx, void *retained, uint32_t size);
+
+/*!
+ * @brief       Resume a sensor from the image bsec_iot_suspend() kept, instead of bsec_iot_init()
+ *
+ * The sensor is neither identified nor are its calibration and configuration read again; the register shadows are
+ * kept as well, the sensor being assumed to stay powered through the sleep. BSEC is initialized from the retained
+ * configuration and state, the outputs subscribed to again at the retained sample rate, and the schedule picks up at
+ * the next_call it was left at, which requires the timestamps to go on across the sleep. The time the resume takes is
+ * kept in ctx->boot. The handlers and the other settings have to be set again as after bsec_iot_init().
+ *
+ * @param[out]  ctx                 context of the sensor to resume
+ * @param[in]   retained            retained buffer
+ * @param[in]   size                size of the buffer
+ * @param[in]   intf_ptr            pointer handed to the bus functions, NULL to hand a pointer to ctx->dev_addr
+ * @param[in]   bus_write           pointer to the bus writing function
+ * @param[in]   bus_read            pointer to the bus reading function
+ * @param[in]   sleep               pointer to the system-specific sleep function
+ * @param[in]   arena               arena the BSEC instance of the sensor is taken from
+ *
+ * @return      zero if successful, BSEC_E_CONFIG_CRCMISMATCH in bsec_status if the buffer holds no valid image, in
+ *              which case bsec_iot_init() has to be called
+ */
+return_values_init bsec_iot_resume(bsec_iot_ctx_t *ctx, const void *retained, uint32_t size, void *intf_ptr,
+                                   bme68x_write_fptr_t bus_write, bme68x_read_fptr_t bus_read,
+                                   bme68x_delay_us_fptr_t sleep, bsec_iot_arena_t *arena);
+
+/*!
+ * @brief       Change the virtual sensors BSEC computes for a sensor, and the rate of each of them
+ *
+ * Only the listed virtual sensors are changed; list one with BSEC_SAMPLE_RATE_DISABLED to stop BSEC from computing
+ * it. Dropping the outputs that are not used saves processing time in bsec_do_steps(). May be called at any time
+ * between two bsec_iot_step() calls, e.g. from the output_ready function, and from another task than bsec_iot_step()
+ * with the lock of the sensor set (see bsec_iot_set_lock()); the new rates apply from the next call to
+ * bsec_sensor_control() on. The subscribed outputs are reported in the subscribed_mask of bsec_iot_output_t.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   requested           virtual sensors and their sample rates
+ * @param[in]   n_requested         number of entries in requested
+ *
+ * @return      result of bsec_update_subscription()
+ */
+bsec_library_return_t bsec_iot_update_subscription(bsec_iot_ctx_t *ctx, const bsec_sensor_configuration_t *requested,
+                                                   uint8_t n_requested);
+
+/*!
+ * @brief       Let the sample rate of a sensor switch between ULP and LP depending on the air quality changes
+ *
+ * The sensor runs in ULP mode while the air quality is stable. It switches to LP mode when the IAQ or breath VOC
+ * changes faster than the given thresholds between two samples, or on bsec_iot_trigger_lp(), and falls back to ULP
+ * mode once neither happened for the hold-off time. All the subscribed outputs are switched together, so this is
+ * meant for the IAQ solution rather than gas scanning.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   adaptive            thresholds and hold-off, NULL to keep the current sample rate from now on
+ *
+ * @return      result of bsec_update_subscription()
+ */
+bsec_library_return_t bsec_iot_set_adaptive(bsec_iot_ctx_t *ctx, const bsec_iot_adaptive_t *adaptive);
+
+/*!
+ * @brief       Switch a sensor in adaptive mode to LP right away, e.g. when a window is opened or presence is detected
+ *
+ * The next sample is taken right away instead of at the end of the ULP period. To be called from the task running
+ * bsec_iot_step(); sensors served by a scheduler have to be put back in order with bsec_iot_sched_reschedule()
+ * afterwards. Does nothing unless adaptive mode is enabled.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      result of bsec_update_subscription()
+ */
+bsec_library_return_t bsec_iot_trigger_lp(bsec_iot_ctx_t *ctx, int64_t now_us);
+
+/*!
+ * @brief       Bring the next cycle forward if the processing of a sample asked for it, e.g. on a switch to LP
+ *
+ * The processing only posts the request, since it may run on another task than bsec_iot_step() in pipeline mode;
+ * bsec_iot_step() and bsec_iot_sched_run() apply it, so in pipeline mode it takes effect at the next wakeup of the
+ * acquisition task. Call it from the task running bsec_iot_step() when driving the sensor without either.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      non-zero if the deadline of the sensor was brought forward
+ */
+uint8_t bsec_iot_apply_control(bsec_iot_ctx_t *ctx, int64_t now_us);
+
+/*!
+ * @brief       Request a single measurement out of the ULP schedule
+ *
+ * Relies on the on-demand measurement of BSEC (BSEC_SAMPLE_RATE_ULP_MEASUREMENT_ON_DEMAND), which BSEC only grants
+ * in ULP mode and at most once per ULP period; the sensor stays in ULP mode afterwards. To be called from the task
+ * running bsec_iot_step(); sensors served by a scheduler have to be put back in order with
+ * bsec_iot_sched_reschedule() afterwards. Does nothing outside ULP mode.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      result of bsec_update_subscription()
+ */
+bsec_library_return_t bsec_iot_measure_on_demand(bsec_iot_ctx_t *ctx, int64_t now_us);
+
+/*!
+ * @brief       Retrieve the BSEC state of a sensor and hand it to the state save function
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   state_save          pointer to the system-specific state save function
+ *
+ * @return      result of bsec_get_state()
+ */
+bsec_library_return_t bsec_iot_save_state(bsec_iot_ctx_t *ctx, state_save_fct state_save);
+
+/*!
+ * @brief       Select how bsec_iot_step() finds out that a measurement is complete
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   completion          completion mode, BSEC_IOT_COMPLETION_NEW_DATA by default
+ *
+ * @return      none
+ */
+void bsec_iot_set_completion(bsec_iot_ctx_t *ctx, bsec_iot_completion_t completion);
+
+/*!
+ * @brief       Tell the integration that the data of the running measurement is ready
+ *
+ * Meant to be called from the event loop when e.g. a GPIO or bus interrupt signals the end of a measurement: the read
+ * phase becomes due right away instead of at the expected completion time. Sensors served by a scheduler have to be
+ * put back in order with bsec_iot_sched_reschedule() afterwards.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      none
+ */
+void bsec_iot_notify_data_ready(bsec_iot_ctx_t *ctx, int64_t now_us);
+
+/*!
+ * @brief       Read the data of the measurements of a sensor asynchronously, e.g. by DMA
+ *
+ * The read phase of bsec_iot_step() then starts a single read of the data and heater registers and returns; the phase
+ * continues once bsec_iot_bus_done() reported its end, the sensor API being served from the registers read. Meanwhile
+ * the other sensors run their phases, e.g. bsec_do_steps(). The configuration writes, the trigger and the operation
+ * mode polls of BSEC_IOT_COMPLETION_OPMODE stay on the blocking bus functions, the sensor API needing their results
+ * at once. A read not reported done within BSEC_IOT_BUS_TIMEOUT_US (10 ms unless defined otherwise at build time) is
+ * given up and done by the blocking functions; the read function must not write to reg_data any later.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   read_async          pointer to the function starting a read, NULL to go back to blocking reads
+ * @param[in]   read_async_arg      pointer handed to the read function
+ *
+ * @return      none
+ */
+void bsec_iot_set_async_read(bsec_iot_ctx_t *ctx, bus_read_async_fct read_async, void *read_async_arg);
+
+/*!
+ * @brief       Report the end of the asynchronous read of a sensor
+ *
+ * Meant to be called from the event loop, e.g. through bsec_iot_bus_dispatch() when the transfer ends in an
+ * interrupt, or from the read function itself when the transfer ended before it returns. The read phase becomes due
+ * right away; sensors served by a scheduler have to be put back in order with bsec_iot_sched_reschedule() afterwards.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   rslt                result of the transfer, BME68X_INTF_RET_SUCCESS if the registers were read
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      none
+ */
+void bsec_iot_bus_done(bsec_iot_ctx_t *ctx, BME68X_INTF_RET_TYPE rslt, int64_t now_us);
+
+/*!
+ * @brief       Set the functions used by bsec_iot_step() once a sample has been processed
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output_ready        pointer to the function processing obtained BSEC outputs
+ * @param[in]   state_save          pointer to the system-specific state save function, NULL to never save the state
+ * @param[in]   save_intvl          interval at which BSEC state should be saved (in samples)
+ *
+ * @return      none
+ */
+void bsec_iot_set_handlers(bsec_iot_ctx_t *ctx, output_ready_fct output_ready, state_save_fct state_save,
+                           uint32_t save_intvl);
+
+/*!
+ * @brief       Select what bsec_iot_step() does with a cycle that starts late
+ *
+ * BSEC flags samples whose time stamps stray too far from the requested cadence (BSEC_W_SC_CALL_TIMING_VIOLATION).
+ * The default tolerance of 1/16 of the sample period matches the deviation BSEC accepts.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   overrun             policy for the cycles later than the tolerance, BSEC_IOT_OVERRUN_RESYNC by default
+ * @param[in]   tolerance_us        lateness (in microseconds) beyond which a cycle is overrun, zero for the default
+ *
+ * @return      none
+ */
+void bsec_iot_set_overrun(bsec_iot_ctx_t *ctx, bsec_iot_overrun_t overrun, uint32_t tolerance_us);
+
+/*!
+ * @brief       Set the function recording each set of inputs before it is handed to BSEC, e.g. bsec_iot_trace_input()
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   trace               pointer to the trace function, NULL for none
+ * @param[in]   trace_arg           pointer handed to the trace function
+ *
+ * @return      none
+ */
+void bsec_iot_set_trace(bsec_iot_ctx_t *ctx, input_trace_fct trace, void *trace_arg);
+
+/*!
+ * @brief       Set the function run on the outputs of every step before output_ready(), e.g. bsec_iot_publish_filter()
+ *
+ * Outputs the filter turns down never reach output_ready().
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output_filter       pointer to the filter function, NULL to hand all the outputs over
+ * @param[in]   output_filter_arg   pointer handed to the filter function
+ *
+ * @return      none
+ */
+void bsec_iot_set_output_filter(bsec_iot_ctx_t *ctx, output_filter_fct output_filter, void *output_filter_arg);
+
+/*!
+ * @brief       Have the inputs read by bsec_iot_step() processed elsewhere, e.g. by bsec_iot_pipeline_process()
+ *
+ * The process phase then hands each set of inputs to the sink instead of BSEC, and the save phase hands it a request
+ * with no inputs, which is repeated on the next sample if turned down. The trace function is not called by
+ * bsec_iot_step() either; whoever processes the inputs does.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   input_sink          pointer to the sink function, NULL to process the inputs in bsec_iot_step()
+ * @param[in]   input_sink_arg      pointer handed to the sink function
+ *
+ * @return      none
+ */
+void bsec_iot_set_input_sink(bsec_iot_ctx_t *ctx, input_sink_fct input_sink, void *input_sink_arg);
+
+/*!
+ * @brief       Set the function serializing the uses of the sensor from different tasks
+ *
+ * The lock is held by bsec_iot_step() while it calls bsec_sensor_control(), the measurement being triggered and read
+ * without it, by bsec_iot_process_inputs() while BSEC processes the inputs and the sample rate is adapted, by
+ * bsec_iot_save_state() while the state is retrieved, and by the functions changing the subscription or the sample
+ * rate. The output_ready, output filter and state save functions run without it, so that they can take their time and
+ * call bsec_iot_update_subscription(). The lock need not be recursive.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   lock                pointer to the lock function, NULL for none
+ * @param[in]   lock_arg            pointer handed to the lock function, e.g. a mutex
+ *
+ * @return      none
+ */
+void bsec_iot_set_lock(bsec_iot_ctx_t *ctx, ctx_lock_fct lock, void *lock_arg);
+
+/*!
+ * @brief       Hand one set of inputs to BSEC and its outputs to the output_ready() function of the sensor
+ *
+ * This is what the process phase of bsec_iot_step() does with each data field read; it lets recorded inputs be
+ * processed again, see bsec_iot_trace_replay().
+ *
+ * @param[in]   ctx                 context of the sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ * @param[in]   inputs              inputs to BSEC
+ * @param[in]   n_inputs            number of inputs
+ *
+ * @return      none
+ */
+void bsec_iot_process_inputs(bsec_iot_ctx_t *ctx, const bsec_input_t *inputs, uint8_t n_inputs);
+
+/*!
+ * @brief       Lowest free stack of the calling task observed after a phase of the acquisition cycle of a sensor
+ *
+ * The free stack is the high-water mark of the task, so it only ever decreases: the phase reporting the lowest value
+ * first is the one that needs the most stack. Only measured on ESP-IDF (FreeRTOS).
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   phase               phase of the acquisition cycle
+ *
+ * @return      free stack (in bytes), zero if not measured
+ */
+uint32_t bsec_iot_stack_free(const bsec_iot_ctx_t *ctx, bsec_iot_phase_t phase);
+
+/*!
+ * @brief       Continue a CRC-32 (IEEE 802.3) computation over a buffer
+ *
+ * @param[in]   crc                 CRC of the preceding data, zero to start
+ * @param[in]   data                data
+ * @param[in]   length              length of the data
+ *
+ * @return      CRC of the preceding data and the buffer
+ */
+uint32_t bsec_iot_crc32(uint32_t crc, const uint8_t *data, uint32_t length);
+
+/*!
+ * @brief       Snapshot of the instrumentation counters of a sensor
+ *
+ * The counters are only kept when the integration is built with BSEC_IOT_INSTRUMENT set to 1; otherwise the snapshot
+ * holds nothing but the bus counters, which are always kept.
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[out]  stats               snapshot of the counters
+ *
+ * @return      zero if successful, negative if the instrumentation is not built in
+ */
+int8_t bsec_iot_get_stats(const bsec_iot_ctx_t *ctx, bsec_iot_stats_t *stats);
+
+/*!
+ * @brief       Runs a single phase of the acquisition cycle of a sensor without blocking
+ *
+ * Call it again at (or after) the returned deadline; it returns right away with the same deadline when called early.
+ * A deadline equal to now_us means the next phase can be run immediately.
+ *
+ * @param[in]   ctx                 context of the sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      absolute timestamp (in microseconds) at which bsec_iot_step() has to be called next
+ */
+int64_t bsec_iot_step(bsec_iot_ctx_t *ctx, int64_t now_us);
 
 /*!
  * @brief       Runs the main (endless) loop that queries sensor settings, applies them, and processes the measured data
+ *              for all the given sensors
  *
+ * @param[in]   ctxs                array of initialized sensor contexts
+ * @param[in]   n_ctxs              number of sensor contexts in ctxs
  * @param[in]   sleep               pointer to the system-specific sleep function
  * @param[in]   get_timestamp_us    pointer to the system-specific timestamp derivation function
  * @param[in]   output_ready        pointer to the function processing obtained BSEC outputs
  * @param[in]   state_save          pointer to the system-specific state save function
  * @param[in]   save_intvl          interval at which BSEC state should be saved (in samples)
  *
- * @return      return_values_init	struct with the result of the API and the BSEC library
+ * @return      none
  */ 
-_Noreturn void bsec_iot_loop(bme68x_delay_us_fptr_t sleep, get_timestamp_us_fct get_timestamp_us, output_ready_fct output_ready,
-                             state_save_fct state_save, uint32_t save_intvl);
+BSEC_IOT_NORETURN void bsec_iot_loop(bsec_iot_ctx_t *ctxs, uint8_t n_ctxs, bme68x_delay_us_fptr_t sleep,
+                                     get_timestamp_us_fct get_timestamp_us, output_ready_fct output_ready,
+                                     state_save_fct state_save, uint32_t save_intvl);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,198 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bsec_persist.h"
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       CRC of a slot, covering its sequence number, length, configuration fingerprint and state
+ *
+ * @param[in]   record              slot
+ *
+ * @return      CRC of the slot
+ */
+static uint32_t bsec_iot_persist_record_crc(const bsec_iot_persist_record_t *record) {
+    uint32_t crc;
+
+    crc = bsec_iot_crc32(0, (const uint8_t *)&record->seq, sizeof(record->seq));
+    crc = bsec_iot_crc32(crc, (const uint8_t *)&record->length, sizeof(record->length));
+    crc = bsec_iot_crc32(crc, (const uint8_t *)&record->config_fingerprint, sizeof(record->config_fingerprint));
+    return bsec_iot_crc32(crc, record->blob, record->length);
+}
+
+/*!
+ * @brief       Initialize the persistence of the BSEC state of a sensor
+ *
+ * @param[out]  persist             persistence to initialize
+ * @param[in]   read                pointer to the function reading a slot
+ * @param[in]   write               pointer to the function writing a slot
+ * @param[in]   storage             pointer handed to the read and write functions
+ * @param[in]   n_slots             number of slots
+ * @param[in]   write_budget_us     idle time (in microseconds) a slot write needs
+ *
+ * @return      zero if successful, negative if there are less than two slots
+ */
+int8_t bsec_iot_persist_init(bsec_iot_persist_t *persist, bsec_iot_persist_read_fct read,
+                            bsec_iot_persist_write_fct write, void *storage, uint8_t n_slots,
+                            int64_t write_budget_us) {
+    memset(persist, 0, sizeof(*persist));
+
+    /* With a single slot, a write failing halfway would destroy the only state */
+    if (n_slots < 2) {
+        return -1;
+    }
+
+    persist->read = read;
+    persist->write = write;
+    persist->storage = storage;
+    persist->n_slots = n_slots;
+    persist->write_budget_us = write_budget_us;
+    persist->stage_index = 0;
+    persist->write_index = 1;
+    persist->handoff = 2;
+
+    return 0;
+}
+
+/*!
+ * @brief       Load the latest valid state from the slots
+ *
+ * @param[in]   persist             persistence of the sensor
+ * @param[in]   config_fingerprint  fingerprint of the configuration the state has to be saved under
+ * @param[out]  state_buffer        buffer to hold the loaded state
+ * @param[in]   n_buffer            size of the allocated state buffer
+ *
+ * @return      number of bytes copied to state_buffer, zero if no valid state was found
+ */
+uint32_t bsec_iot_persist_load(bsec_iot_persist_t *persist, uint32_t config_fingerprint, uint8_t *state_buffer,
+                               uint32_t n_buffer) {
+    bsec_iot_persist_record_t *record = &persist->records[persist->write_index];
+    uint32_t length = 0;
+    uint8_t found = 0;
+    uint8_t slot;
+
+    for (slot = 0; slot < persist->n_slots; slot++) {
+        if (persist->read(persist->storage, slot, (uint8_t *)record, sizeof(*record)) != 0 ||
+            record->magic != BSEC_IOT_PERSIST_MAGIC || record->length > sizeof(record->blob) ||
+            record->length > n_buffer || record->crc != bsec_iot_persist_record_crc(record)) {
+            continue;
+        }
+
+        /* Keep the latest write, sequence numbers compared so that they may wrap around */
+        if (!found || (int32_t)(record->seq - persist->seq) > 0) {
+            found = 1;
+            persist->seq = record->seq;
+            persist->next_slot = (uint8_t)((slot + 1) % persist->n_slots);
+            persist->last_crc = bsec_iot_crc32(0, record->blob, record->length);
+            persist->last_length = record->length;
+            persist->last_fingerprint = record->config_fingerprint;
+            memcpy(state_buffer, record->blob, record->length);
+            length = record->length;
+        }
+    }
+
+    /* The latest state belongs to another configuration: BSEC starts from scratch, the sequence goes on */
+    if (found && persist->last_fingerprint != config_fingerprint) {
+        persist->n_mismatched++;
+        length = 0;
+    }
+
+    /* A state saved right after loading is not written again unless it changed */
+    persist->persisted = found;
+    return length;
+}
+
+/*!
+ * @brief       Hand over a state to be written at the next idle time
+ *
+ * @param[in]   persist             persistence of the sensor
+ * @param[in]   config_fingerprint  fingerprint of the configuration the state was computed under
+ * @param[in]   state_buffer        state to save
+ * @param[in]   length              length of the state
+ *
+ * @return      none
+ */
+void bsec_iot_persist_stage(bsec_iot_persist_t *persist, uint32_t config_fingerprint, const uint8_t *state_buffer,
+                            uint32_t length) {
+    bsec_iot_persist_record_t *record = &persist->records[persist->stage_index];
+
+    persist->n_staged++;
+    if (length > sizeof(record->blob)) {
+        return;
+    }
+
+    /* Fill a record of its own, the sequence number and the CRC are only set by the write */
+    record->magic = BSEC_IOT_PERSIST_MAGIC;
+    record->length = length;
+    record->config_fingerprint = config_fingerprint;
+    memcpy(record->blob, state_buffer, length);
+
+    /* Hand it over in exchange for the record handed over before, which a newer state may overwrite from now on */
+    persist->stage_index = __atomic_exchange_n(&persist->handoff, persist->stage_index | BSEC_IOT_PERSIST_FRESH,
+                                               __ATOMIC_ACQ_REL) & ~BSEC_IOT_PERSIST_FRESH;
+}
+
+/*!
+ * @brief       Write the state handed over, if any, provided there is enough idle time
+ *
+ * @param[in]   persist             persistence of the sensor
+ * @param[in]   idle_us             time (in microseconds) left before the next sensor deadline
+ *
+ * @return      zero if nothing is left to write, positive if the write was deferred, negative if it failed
+ */
+int8_t bsec_iot_persist_flush(bsec_iot_persist_t *persist, int64_t idle_us) {
+    bsec_iot_persist_record_t *record;
+
+    /* Take the latest state handed over, in exchange for the record written before */
+    if (__atomic_load_n(&persist->handoff, __ATOMIC_RELAXED) & BSEC_IOT_PERSIST_FRESH) {
+        persist->write_index = __atomic_exchange_n(&persist->handoff, persist->write_index, __ATOMIC_ACQ_REL) &
+                               ~BSEC_IOT_PERSIST_FRESH;
+        record = &persist->records[persist->write_index];
+
+        /* The CRC of the state along with its length and configuration identifies it, drop it when NVM already holds
+         * it */
+        persist->pending = !(persist->persisted && record->length == persist->last_length &&
+                             record->config_fingerprint == persist->last_fingerprint &&
+                             bsec_iot_crc32(0, record->blob, record->length) == persist->last_crc);
+        if (!persist->pending) {
+            persist->n_skipped++;
+        }
+    }
+    record = &persist->records[persist->write_index];
+
+    if (!persist->pending) {
+        return 0;
+    }
+    if (idle_us < persist->write_budget_us) {
+        return 1;
+    }
+
+    /* Rotate over the slots: the previous state stays intact until the new one is completely written. A failed
+     * write is retried on the same slot, moving on could overwrite the slot holding the latest state. */
+    record->seq = persist->seq + 1;
+    record->crc = bsec_iot_persist_record_crc(record);
+    if (persist->write(persist->storage, persist->next_slot, (const uint8_t *)record, sizeof(*record)) != 0) {
+        persist->n_write_errors++;
+        return -1;
+    }
+
+    persist->n_writes++;
+    persist->seq = record->seq;
+    persist->next_slot = (uint8_t)((persist->next_slot + 1) % persist->n_slots);
+    persist->last_crc = bsec_iot_crc32(0, record->blob, record->length);
+    persist->last_length = record->length;
+    persist->last_fingerprint = record->config_fingerprint;
+    persist->persisted = 1;
+    persist->pending = 0;
+
+    return 0;
+}
+
+/*! @}*/
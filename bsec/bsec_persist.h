@@ -0,0 +1,186 @@
+/*!
+ * @file bsec_persist.h
+ *
+ * @brief
+ * Persistence of the BSEC state in a rotation of CRC-protected slots, written outside of the measurement path
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_PERSIST_H__
+#define __BSEC_PERSIST_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Marker at the start of a valid slot */
+#define BSEC_IOT_PERSIST_MAGIC UINT32_C(0x42534543)
+
+/* Flag of the handed over record telling that it holds a state not taken by bsec_iot_persist_flush() yet */
+#define BSEC_IOT_PERSIST_FRESH UINT8_C(0x80)
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to the function reading a whole slot from NVM, returning zero if successful */
+typedef int8_t (*bsec_iot_persist_read_fct)(void *storage, uint8_t slot, uint8_t *record, uint32_t length);
+
+/* function pointer to the function writing a whole slot to NVM, returning zero if successful */
+typedef int8_t (*bsec_iot_persist_write_fct)(void *storage, uint8_t slot, const uint8_t *record, uint32_t length);
+
+/* Structure of a slot as stored in NVM */
+typedef struct {
+	/*! BSEC_IOT_PERSIST_MAGIC when the slot was ever written */
+	uint32_t magic;
+	/*! Sequence number of the write, the valid slot with the highest one holds the latest state */
+	uint32_t seq;
+	/*! Length of the state in blob */
+	uint32_t length;
+	/*! Fingerprint of the configuration the state was computed under, see bsec_iot_boot_stats_t */
+	uint32_t config_fingerprint;
+	/*! CRC-32 of seq, length, config_fingerprint and the state */
+	uint32_t crc;
+	/*! BSEC state */
+	uint8_t blob[BSEC_MAX_STATE_BLOB_SIZE];
+} bsec_iot_persist_record_t;
+
+/* Structure holding the persisted state of one sensor. bsec_iot_persist_stage() and bsec_iot_persist_flush() may run
+ * on two different tasks, e.g. the processing task of a pipeline and the idle function of the scheduler: each fills
+ * or writes a record of its own, and the states pass between them through a third one without any lock. */
+typedef struct {
+	/*! Function reading a slot */
+	bsec_iot_persist_read_fct read;
+	/*! Function writing a slot */
+	bsec_iot_persist_write_fct write;
+	/*! Pointer handed to the read and write functions, e.g. an NVS handle or a partition */
+	void *storage;
+	/*! Number of slots the writes rotate over */
+	uint8_t n_slots;
+	/*! Slot written next */
+	uint8_t next_slot;
+	/*! Sequence number of the latest write */
+	uint32_t seq;
+	/*! Idle time (in microseconds) a slot write needs */
+	int64_t write_budget_us;
+	/*! Set when the record written by bsec_iot_persist_flush() still has to be written */
+	uint8_t pending;
+	/*! Set when last_crc and last_length describe the state in NVM */
+	uint8_t persisted;
+	/*! CRC-32 of the state in NVM */
+	uint32_t last_crc;
+	/*! Length of the state in NVM */
+	uint32_t last_length;
+	/*! Configuration fingerprint of the state in NVM */
+	uint32_t last_fingerprint;
+	/*! Records of the states: filled by bsec_iot_persist_stage(), handed over, and written or read while loading */
+	bsec_iot_persist_record_t records[3];
+	/*! Record filled by bsec_iot_persist_stage() */
+	uint8_t stage_index;
+	/*! Record written by bsec_iot_persist_flush() */
+	uint8_t write_index;
+	/*! Record handed over, with BSEC_IOT_PERSIST_FRESH while it holds a state not taken yet; only accessed
+	 * atomically */
+	volatile uint8_t handoff;
+	/*! Number of states handed over for saving */
+	uint32_t n_staged;
+	/*! Number of states not written because NVM already held them */
+	uint32_t n_skipped;
+	/*! Number of slot writes */
+	uint32_t n_writes;
+	/*! Number of failed slot writes */
+	uint32_t n_write_errors;
+	/*! Number of loads that left out the latest state because it was saved under another configuration */
+	uint32_t n_mismatched;
+} bsec_iot_persist_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize the persistence of the BSEC state of a sensor
+ *
+ * @param[out]  persist             persistence to initialize
+ * @param[in]   read                pointer to the function reading a slot
+ * @param[in]   write               pointer to the function writing a slot
+ * @param[in]   storage             pointer handed to the read and write functions
+ * @param[in]   n_slots             number of slots, two or more so that a failed write never loses the latest state
+ * @param[in]   write_budget_us     idle time (in microseconds) a slot write needs
+ *
+ * @return      zero if successful, negative if there are less than two slots
+ */
+int8_t bsec_iot_persist_init(bsec_iot_persist_t *persist, bsec_iot_persist_read_fct read,
+                            bsec_iot_persist_write_fct write, void *storage, uint8_t n_slots,
+                            int64_t write_budget_us);
+
+/*!
+ * @brief       Load the latest valid state from the slots
+ *
+ * Meant to be called from the state_load function given to bsec_iot_init(), with ctx->boot.config_fingerprint. Slots
+ * with a wrong marker or CRC, e.g. after a power loss during a write, are ignored. When the latest state was saved
+ * under another configuration, nothing is loaded and BSEC starts from scratch rather than failing to restore it.
+ *
+ * @param[in]   persist             persistence of the sensor
+ * @param[in]   config_fingerprint  fingerprint of the configuration the state has to be saved under
+ * @param[out]  state_buffer        buffer to hold the loaded state
+ * @param[in]   n_buffer            size of the allocated state buffer
+ *
+ * @return      number of bytes copied to state_buffer, zero if no valid state was found
+ */
+uint32_t bsec_iot_persist_load(bsec_iot_persist_t *persist, uint32_t config_fingerprint, uint8_t *state_buffer,
+                               uint32_t n_buffer);
+
+/*!
+ * @brief       Hand over a state to be written at the next idle time
+ *
+ * Meant to be called from the state_save function given to bsec_iot_set_handlers(), with
+ * ctx->boot.config_fingerprint. The state is copied and handed over, nothing is written to NVM yet. It may be called
+ * from another task than bsec_iot_persist_flush(), but always from the same one.
+ *
+ * @param[in]   persist             persistence of the sensor
+ * @param[in]   config_fingerprint  fingerprint of the configuration the state was computed under
+ * @param[in]   state_buffer        state to save
+ * @param[in]   length              length of the state
+ *
+ * @return      none
+ */
+void bsec_iot_persist_stage(bsec_iot_persist_t *persist, uint32_t config_fingerprint, const uint8_t *state_buffer,
+                            uint32_t length);
+
+/*!
+ * @brief       Write the state handed over, if any, provided there is enough idle time
+ *
+ * Meant to be called from the idle function of the scheduler (see bsec_iot_sched_set_idle()), or from any other
+ * place out of the measurement path, always from the same task. Only the latest state handed over is written; a
+ * state identical to the one already in NVM is dropped.
+ *
+ * @param[in]   persist             persistence of the sensor
+ * @param[in]   idle_us             time (in microseconds) left before the next sensor deadline
+ *
+ * @return      zero if nothing is left to write, positive if the write was deferred, negative if it failed
+ */
+int8_t bsec_iot_persist_flush(bsec_iot_persist_t *persist, int64_t idle_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_PERSIST_H__ */
+
+/*! @}*/
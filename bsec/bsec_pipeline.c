@@ -0,0 +1,127 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bsec_pipeline.h"
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an empty pipeline
+ *
+ * @param[out]  pipeline            pipeline to initialize
+ * @param[in]   notify              pointer to the function waking the processing task up, NULL if it polls
+ * @param[in]   notify_arg          pointer handed to the notify function
+ *
+ * @return      none
+ */
+void bsec_iot_pipeline_init(bsec_iot_pipeline_t *pipeline, bsec_iot_pipeline_notify_fct notify, void *notify_arg) {
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->notify = notify;
+    pipeline->notify_arg = notify_arg;
+}
+
+/*!
+ * @brief       Have the inputs read for a sensor by bsec_iot_step() processed through the pipeline
+ *
+ * @param[in]   pipeline            pipeline
+ * @param[in]   ctx                 context of the sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ * @param[in]   lock                pointer to the lock function of the sensor, e.g. taking a mutex
+ * @param[in]   lock_arg            pointer handed to the lock function
+ *
+ * @return      none
+ */
+void bsec_iot_pipeline_add(bsec_iot_pipeline_t *pipeline, bsec_iot_ctx_t *ctx, ctx_lock_fct lock, void *lock_arg) {
+    bsec_iot_set_lock(ctx, lock, lock_arg);
+    bsec_iot_set_input_sink(ctx, bsec_iot_pipeline_sink, pipeline);
+}
+
+/*!
+ * @brief       Input sink function set by bsec_iot_pipeline_add(), queuing the inputs without ever waiting
+ *
+ * @param[in]   sink_arg            pipeline
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   settings            sensor settings the inputs were measured with, NULL for a state save request
+ * @param[in]   inputs              inputs to BSEC
+ * @param[in]   n_inputs            number of inputs, zero for a state save request
+ *
+ * @return      one if the inputs were queued, zero if the queue is full
+ */
+uint8_t bsec_iot_pipeline_sink(void *sink_arg, bsec_iot_ctx_t *ctx, const bsec_bme_settings_t *settings,
+                               const bsec_input_t *inputs, uint8_t n_inputs) {
+    bsec_iot_pipeline_t *pipeline = (bsec_iot_pipeline_t *)sink_arg;
+    unsigned int head = __atomic_load_n(&pipeline->head, __ATOMIC_RELAXED);
+    unsigned int depth = head - __atomic_load_n(&pipeline->tail, __ATOMIC_ACQUIRE);
+    bsec_iot_pipeline_item_t *item;
+
+    /* The acquisition never waits for the processing, a full queue loses the newest inputs */
+    if (depth >= BSEC_IOT_PIPELINE_DEPTH) {
+        pipeline->n_dropped++;
+        return 0;
+    }
+
+    item = &pipeline->items[head % BSEC_IOT_PIPELINE_DEPTH];
+    item->ctx = ctx;
+    item->n_inputs = (n_inputs < BSEC_MAX_PHYSICAL_SENSOR) ? n_inputs : BSEC_MAX_PHYSICAL_SENSOR;
+    if (settings != NULL) {
+        item->settings = *settings;
+    }
+    if (item->n_inputs > 0) {
+        memcpy(item->inputs, inputs, item->n_inputs * sizeof(bsec_input_t));
+    }
+
+    /* Publish the item once it is complete */
+    __atomic_store_n(&pipeline->head, head + 1, __ATOMIC_RELEASE);
+    pipeline->n_queued++;
+    if (depth + 1 > pipeline->max_depth) {
+        pipeline->max_depth = depth + 1;
+    }
+
+    if (pipeline->notify != NULL) {
+        pipeline->notify(pipeline->notify_arg);
+    }
+
+    return 1;
+}
+
+/*!
+ * @brief       Process the sets of inputs queued, in the order they were read
+ *
+ * @param[in]   pipeline            pipeline
+ *
+ * @return      number of sets processed
+ */
+uint32_t bsec_iot_pipeline_process(bsec_iot_pipeline_t *pipeline) {
+    unsigned int tail = __atomic_load_n(&pipeline->tail, __ATOMIC_RELAXED);
+    const bsec_iot_pipeline_item_t *item;
+    uint32_t n_processed = 0;
+
+    while (tail != __atomic_load_n(&pipeline->head, __ATOMIC_ACQUIRE)) {
+        item = &pipeline->items[tail % BSEC_IOT_PIPELINE_DEPTH];
+        if (item->n_inputs == 0) {
+            if (item->ctx->state_save != NULL) {
+                bsec_iot_save_state(item->ctx, item->ctx->state_save);
+            }
+        } else {
+            if (item->ctx->trace != NULL) {
+                item->ctx->trace(item->ctx->trace_arg, &item->settings, item->inputs, item->n_inputs);
+            }
+            bsec_iot_process_inputs(item->ctx, item->inputs, item->n_inputs);
+        }
+
+        /* Hand the slot back to the acquisition task only once the item is no longer used */
+        tail++;
+        __atomic_store_n(&pipeline->tail, tail, __ATOMIC_RELEASE);
+        n_processed++;
+    }
+    pipeline->n_processed += n_processed;
+
+    return n_processed;
+}
+
+/*! @}*/
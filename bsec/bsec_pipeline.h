@@ -0,0 +1,146 @@
+/*!
+ * @file bsec_pipeline.h
+ *
+ * @brief
+ * Hand-over of the inputs read by the acquisition task to a processing task, e.g. on the other core
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_PIPELINE_H__
+#define __BSEC_PIPELINE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Number of sets of inputs the queue holds, a power of two. A sample takes one set per data field read, up to
+ * BME68X_N_MEAS in parallel mode, and one more when the state is due to be saved. */
+#ifndef BSEC_IOT_PIPELINE_DEPTH
+#define BSEC_IOT_PIPELINE_DEPTH 16
+#endif
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to the function waking the processing task up after inputs were queued, e.g. by a task
+ * notification */
+typedef void (*bsec_iot_pipeline_notify_fct)(void *notify_arg);
+
+/* Structure with one set of queued inputs */
+typedef struct {
+	/*! Context of the sensor the inputs were read from */
+	bsec_iot_ctx_t *ctx;
+	/*! Sensor settings the inputs were measured with */
+	bsec_bme_settings_t settings;
+	/*! Inputs to BSEC */
+	bsec_input_t inputs[BSEC_MAX_PHYSICAL_SENSOR];
+	/*! Number of inputs, zero for a request to save the BSEC state */
+	uint8_t n_inputs;
+} bsec_iot_pipeline_item_t;
+
+/* Structure holding the queue between the acquisition task, which runs bsec_iot_step() for all the sensors of the
+ * pipeline, and the processing task, which runs bsec_iot_pipeline_process(). There must be one of each. */
+typedef struct {
+	/*! Queued sets of inputs */
+	bsec_iot_pipeline_item_t items[BSEC_IOT_PIPELINE_DEPTH];
+	/*! Number of sets queued so far, only written by the acquisition task, only accessed atomically */
+	volatile unsigned int head;
+	/*! Number of sets taken off the queue so far, only written by the processing task, only accessed atomically */
+	volatile unsigned int tail;
+	/*! Function waking the processing task up, NULL if it polls */
+	bsec_iot_pipeline_notify_fct notify;
+	/*! Pointer handed to the notify function */
+	void *notify_arg;
+	/*! Number of sets queued */
+	uint32_t n_queued;
+	/*! Number of sets dropped because the queue was full */
+	uint32_t n_dropped;
+	/*! Largest number of sets waiting in the queue */
+	uint32_t max_depth;
+	/*! Number of sets processed */
+	uint32_t n_processed;
+} bsec_iot_pipeline_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an empty pipeline
+ *
+ * @param[out]  pipeline            pipeline to initialize
+ * @param[in]   notify              pointer to the function waking the processing task up, NULL if it polls
+ * @param[in]   notify_arg          pointer handed to the notify function
+ *
+ * @return      none
+ */
+void bsec_iot_pipeline_init(bsec_iot_pipeline_t *pipeline, bsec_iot_pipeline_notify_fct notify, void *notify_arg);
+
+/*!
+ * @brief       Have the inputs read for a sensor by bsec_iot_step() processed through the pipeline
+ *
+ * The BSEC instance of the sensor is then used from both tasks, the lock function serializes these uses (see
+ * bsec_iot_set_lock()). The output_ready, output filter, trace and state save functions of the sensor run in the
+ * processing task, outside the lock. What they hand to bsec_iot_persist_stage() and bsec_iot_history_append() may
+ * still be written to flash from the idle function of the scheduler on the acquisition task, both pass it across
+ * without a lock. The states are saved through the scratch area of the arena: when sensors of the same arena are
+ * initialized, resumed or suspended on the acquisition task meanwhile, the arena needs a lock too (see
+ * bsec_iot_arena_set_lock()).
+ *
+ * @param[in]   pipeline            pipeline
+ * @param[in]   ctx                 context of the sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ * @param[in]   lock                pointer to the lock function of the sensor, e.g. taking a mutex
+ * @param[in]   lock_arg            pointer handed to the lock function
+ *
+ * @return      none
+ */
+void bsec_iot_pipeline_add(bsec_iot_pipeline_t *pipeline, bsec_iot_ctx_t *ctx, ctx_lock_fct lock, void *lock_arg);
+
+/*!
+ * @brief       Input sink function set by bsec_iot_pipeline_add(), queuing the inputs without ever waiting
+ *
+ * @param[in]   sink_arg            pipeline
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   settings            sensor settings the inputs were measured with, NULL for a state save request
+ * @param[in]   inputs              inputs to BSEC
+ * @param[in]   n_inputs            number of inputs, zero for a state save request
+ *
+ * @return      one if the inputs were queued, zero if the queue is full
+ */
+uint8_t bsec_iot_pipeline_sink(void *sink_arg, bsec_iot_ctx_t *ctx, const bsec_bme_settings_t *settings,
+                               const bsec_input_t *inputs, uint8_t n_inputs);
+
+/*!
+ * @brief       Process the sets of inputs queued, in the order they were read
+ *
+ * Meant to be called by the processing task whenever it is notified, it returns once the queue is empty.
+ *
+ * @param[in]   pipeline            pipeline
+ *
+ * @return      number of sets processed
+ */
+uint32_t bsec_iot_pipeline_process(bsec_iot_pipeline_t *pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_PIPELINE_H__ */
+
+/*! @}*/
@@ -0,0 +1,175 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bsec_publish.h"
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+/* Default deadband of each output, about the noise of the output, zero for the outputs whose changes never publish */
+static const float bsec_iot_publish_deadband[BSEC_IOT_NUM_OUTPUTS] = {
+    [BSEC_IOT_OUTPUT_IAQ] = 5.0f,
+    [BSEC_IOT_OUTPUT_STATIC_IAQ] = 5.0f,
+    [BSEC_IOT_OUTPUT_CO2_EQUIVALENT] = 50.0f,
+    [BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT] = 0.1f,
+    [BSEC_IOT_OUTPUT_RAW_PRESSURE] = 50.0f,
+    [BSEC_IOT_OUTPUT_STABILIZATION_STATUS] = 0.5f,
+    [BSEC_IOT_OUTPUT_RUN_IN_STATUS] = 0.5f,
+    [BSEC_IOT_OUTPUT_TEMPERATURE] = 0.2f,
+    [BSEC_IOT_OUTPUT_HUMIDITY] = 1.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_1] = 5.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_2] = 5.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_3] = 5.0f,
+    [BSEC_IOT_OUTPUT_GAS_ESTIMATE_4] = 5.0f,
+};
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Empty a window
+ *
+ * @param[out]  window              window to empty
+ *
+ * @return      none
+ */
+static void bsec_iot_publish_window_reset(bsec_iot_publish_window_t *window) {
+    memset(window, 0, sizeof(*window));
+}
+
+/*!
+ * @brief       Add the outputs of a step to a window
+ *
+ * @param[in]   window              window being filled
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void bsec_iot_publish_window_add(bsec_iot_publish_window_t *window, const bsec_iot_output_t *output) {
+    uint8_t i;
+
+    if (window->n_samples == 0) {
+        window->start = output->timestamp;
+    }
+    window->end = output->timestamp;
+    window->n_samples++;
+    for (i = 0; i < BSEC_IOT_NUM_OUTPUTS; i++) {
+        if (!(output->valid_mask & BSEC_IOT_OUTPUT_MASK(i))) {
+            continue;
+        }
+        if (window->n[i] == 0 || output->value[i] < window->min[i]) {
+            window->min[i] = output->value[i];
+        }
+        if (window->n[i] == 0 || output->value[i] > window->max[i]) {
+            window->max[i] = output->value[i];
+        }
+        window->sum[i] += output->value[i];
+        window->n[i]++;
+    }
+    window->valid_mask |= output->valid_mask;
+}
+
+/*!
+ * @brief       Initialize the publishing stage of a sensor
+ *
+ * @param[out]  publish             publishing stage to initialize
+ * @param[in]   window_s            length (in seconds) of a window, zero to publish on changes only
+ *
+ * @return      none
+ */
+void bsec_iot_publish_init(bsec_iot_publish_t *publish, uint32_t window_s) {
+    memset(publish, 0, sizeof(*publish));
+    publish->window_s = window_s;
+    memcpy(publish->deadband, bsec_iot_publish_deadband, sizeof(publish->deadband));
+    publish->accuracy_mask = BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_IAQ) |
+                             BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_STATIC_IAQ) |
+                             BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_CO2_EQUIVALENT) |
+                             BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_BREATH_VOC_EQUIVALENT);
+}
+
+/*!
+ * @brief       Add the outputs of a step to the window and tell whether they are published
+ *
+ * @param[in]   publish             publishing stage of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      non-zero if the outputs are published
+ */
+uint8_t bsec_iot_publish_update(bsec_iot_publish_t *publish, const bsec_iot_output_t *output) {
+    uint8_t reason = 0;
+    uint8_t i;
+
+    publish->n_samples++;
+    bsec_iot_publish_window_add(&publish->current, output);
+
+    if (output->valid_mask & ~publish->published_mask) {
+        reason |= BSEC_IOT_PUBLISH_FIRST;
+    }
+    if (publish->window_s > 0 &&
+        output->timestamp - publish->current.start >= (int64_t)publish->window_s * INT64_C(1000000000)) {
+        reason |= BSEC_IOT_PUBLISH_WINDOW;
+    }
+    for (i = 0; i < BSEC_IOT_NUM_OUTPUTS; i++) {
+        if (!(output->valid_mask & publish->published_mask & BSEC_IOT_OUTPUT_MASK(i))) {
+            continue;
+        }
+        if (publish->deadband[i] > 0.0f && fabsf(output->value[i] - publish->published[i]) > publish->deadband[i]) {
+            reason |= BSEC_IOT_PUBLISH_DEADBAND;
+        }
+        if ((publish->accuracy_mask & BSEC_IOT_OUTPUT_MASK(i)) &&
+            output->accuracy[i] != publish->published_accuracy[i]) {
+            reason |= BSEC_IOT_PUBLISH_ACCURACY;
+        }
+    }
+    if (reason == 0) {
+        return 0;
+    }
+
+    /* Close the window and remember what was published, the changes are measured from there */
+    publish->window = publish->current;
+    for (i = 0; i < BSEC_IOT_NUM_OUTPUTS; i++) {
+        if (publish->window.n[i] > 0) {
+            publish->window.mean[i] = publish->window.sum[i] / (float)publish->window.n[i];
+        }
+        if (output->valid_mask & BSEC_IOT_OUTPUT_MASK(i)) {
+            publish->published[i] = output->value[i];
+            publish->published_accuracy[i] = output->accuracy[i];
+        }
+    }
+    bsec_iot_publish_window_reset(&publish->current);
+    publish->published_mask |= output->valid_mask;
+    publish->reason = reason;
+
+    publish->n_published++;
+    if (reason & BSEC_IOT_PUBLISH_WINDOW) {
+        publish->n_window++;
+    }
+    if (reason & BSEC_IOT_PUBLISH_DEADBAND) {
+        publish->n_deadband++;
+    }
+    if (reason & BSEC_IOT_PUBLISH_ACCURACY) {
+        publish->n_accuracy++;
+    }
+    return 1;
+}
+
+/*!
+ * @brief       Output filter function to give to bsec_iot_set_output_filter() with the publishing stage as filter_arg
+ *
+ * @param[in]   filter_arg          publishing stage of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      non-zero if the outputs are handed to output_ready
+ */
+uint8_t bsec_iot_publish_filter(void *filter_arg, const bsec_iot_output_t *output) {
+    return bsec_iot_publish_update((bsec_iot_publish_t *)filter_arg, output);
+}
+
+/*! @}*/
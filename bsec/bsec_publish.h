@@ -0,0 +1,143 @@
+/*!
+ * @file bsec_publish.h
+ *
+ * @brief
+ * Aggregation of the BSEC outputs over windows, handing them over only on window close or on a significant change
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_PUBLISH_H__
+#define __BSEC_PUBLISH_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Reasons for handing outputs over, as bits of bsec_iot_publish_t::reason */
+#define BSEC_IOT_PUBLISH_FIRST      UINT8_C(0x01)
+#define BSEC_IOT_PUBLISH_WINDOW     UINT8_C(0x02)
+#define BSEC_IOT_PUBLISH_DEADBAND   UINT8_C(0x04)
+#define BSEC_IOT_PUBLISH_ACCURACY   UINT8_C(0x08)
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* Structure with the statistics of the outputs over the samples since the previous publication */
+typedef struct {
+	/*! Time stamp (in nanoseconds) of the first sample of the window */
+	int64_t start;
+	/*! Time stamp (in nanoseconds) of the last sample of the window */
+	int64_t end;
+	/*! Number of samples in the window */
+	uint32_t n_samples;
+	/*! Bit mask of the outputs seen in the window, see BSEC_IOT_OUTPUT_MASK() */
+	uint32_t valid_mask;
+	/*! Smallest value of each output */
+	float min[BSEC_IOT_NUM_OUTPUTS];
+	/*! Largest value of each output */
+	float max[BSEC_IOT_NUM_OUTPUTS];
+	/*! Mean value of each output, only set once the window is closed */
+	float mean[BSEC_IOT_NUM_OUTPUTS];
+	/*! Sum of the values of each output */
+	float sum[BSEC_IOT_NUM_OUTPUTS];
+	/*! Number of samples of each output */
+	uint32_t n[BSEC_IOT_NUM_OUTPUTS];
+} bsec_iot_publish_window_t;
+
+/* Structure holding the publishing stage of one sensor */
+typedef struct {
+	/*! Length (in seconds) of a window, zero to publish on changes only */
+	uint32_t window_s;
+	/*! Change of each output since its last published value beyond which the outputs are published, zero for an
+	 * output whose changes never publish */
+	float deadband[BSEC_IOT_NUM_OUTPUTS];
+	/*! Bit mask of the outputs whose accuracy changes publish, see BSEC_IOT_OUTPUT_MASK() */
+	uint32_t accuracy_mask;
+	/*! Window being filled */
+	bsec_iot_publish_window_t current;
+	/*! Window closed by the latest publication, to be read from output_ready */
+	bsec_iot_publish_window_t window;
+	/*! Bit mask of BSEC_IOT_PUBLISH_* reasons of the latest publication */
+	uint8_t reason;
+	/*! Bit mask of the outputs published so far */
+	uint32_t published_mask;
+	/*! Value of each output at its latest publication */
+	float published[BSEC_IOT_NUM_OUTPUTS];
+	/*! Accuracy of each output at its latest publication */
+	uint8_t published_accuracy[BSEC_IOT_NUM_OUTPUTS];
+	/*! Number of samples seen */
+	uint32_t n_samples;
+	/*! Number of samples published */
+	uint32_t n_published;
+	/*! Number of publications due to the close of a window */
+	uint32_t n_window;
+	/*! Number of publications due to an output leaving its deadband */
+	uint32_t n_deadband;
+	/*! Number of publications due to an accuracy change */
+	uint32_t n_accuracy;
+} bsec_iot_publish_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize the publishing stage of a sensor
+ *
+ * The deadbands start at about the noise of each output (e.g. 5 IAQ, 0.2 degC, 1 %rH, 50 Pa) and the accuracy changes
+ * of the IAQ outputs publish; both can be changed in the structure afterwards.
+ *
+ * @param[out]  publish             publishing stage to initialize
+ * @param[in]   window_s            length (in seconds) of a window, zero to publish on changes only
+ *
+ * @return      none
+ */
+void bsec_iot_publish_init(bsec_iot_publish_t *publish, uint32_t window_s);
+
+/*!
+ * @brief       Add the outputs of a step to the window and tell whether they are published
+ *
+ * Outputs are published, and the window closed, on the first sample, when the window is over, when an output moved
+ * beyond its deadband since it was last published, or when the accuracy of an output of accuracy_mask changed. The
+ * outputs handed over are the latest sample; publish->window and publish->reason tell the rest.
+ *
+ * @param[in]   publish             publishing stage of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      non-zero if the outputs are published
+ */
+uint8_t bsec_iot_publish_update(bsec_iot_publish_t *publish, const bsec_iot_output_t *output);
+
+/*!
+ * @brief       Output filter function to give to bsec_iot_set_output_filter() with the publishing stage as filter_arg
+ *
+ * @param[in]   filter_arg          publishing stage of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      non-zero if the outputs are handed to output_ready
+ */
+uint8_t bsec_iot_publish_filter(void *filter_arg, const bsec_iot_output_t *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_PUBLISH_H__ */
+
+/*! @}*/
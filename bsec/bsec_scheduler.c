@@ -0,0 +1,235 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+
+#include "bsec_scheduler.h"
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Move the entry at the given position up the heap until its parent is not later than it
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   pos                 position of the entry in the heap
+ *
+ * @return      none
+ */
+static void bsec_iot_sched_sift_up(bsec_iot_sched_t *sched, uint8_t pos) {
+    bsec_iot_ctx_t *ctx = sched->heap[pos];
+    uint8_t parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (sched->heap[parent]->deadline <= ctx->deadline) {
+            break;
+        }
+        sched->heap[pos] = sched->heap[parent];
+        pos = parent;
+    }
+    sched->heap[pos] = ctx;
+}
+
+/*!
+ * @brief       Move the entry at the given position down the heap until none of its children is earlier than it
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   pos                 position of the entry in the heap
+ *
+ * @return      none
+ */
+static void bsec_iot_sched_sift_down(bsec_iot_sched_t *sched, uint8_t pos) {
+    bsec_iot_ctx_t *ctx = sched->heap[pos];
+    uint8_t child;
+
+    while ((child = 2 * pos + 1) < sched->n_ctxs) {
+        if (child + 1 < sched->n_ctxs && sched->heap[child + 1]->deadline < sched->heap[child]->deadline) {
+            child++;
+        }
+        if (ctx->deadline <= sched->heap[child]->deadline) {
+            break;
+        }
+        sched->heap[pos] = sched->heap[child];
+        pos = child;
+    }
+    sched->heap[pos] = ctx;
+}
+
+/*!
+ * @brief       Find the latest deadline of the heap that is not later than a bound
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   pos                 position of the subtree to search
+ * @param[in]   bound               latest deadline to consider
+ * @param[in]   latest              latest deadline found so far
+ *
+ * @return      latest deadline not later than bound
+ */
+static int64_t bsec_iot_sched_latest_within(const bsec_iot_sched_t *sched, uint8_t pos, int64_t bound, int64_t latest) {
+    /* Children are never earlier than their parent, so a subtree can be skipped as soon as its root is too late */
+    if (pos >= sched->n_ctxs || sched->heap[pos]->deadline > bound) {
+        return latest;
+    }
+    if (sched->heap[pos]->deadline > latest) {
+        latest = sched->heap[pos]->deadline;
+    }
+    latest = bsec_iot_sched_latest_within(sched, 2 * pos + 1, bound, latest);
+    return bsec_iot_sched_latest_within(sched, 2 * pos + 2, bound, latest);
+}
+
+/*!
+ * @brief       Initialize an empty scheduler
+ *
+ * @param[out]  sched               scheduler to initialize
+ * @param[in]   slack_us            time (in microseconds) by which a deadline may be postponed to share a wakeup
+ *
+ * @return      none
+ */
+void bsec_iot_sched_init(bsec_iot_sched_t *sched, int64_t slack_us) {
+    sched->n_ctxs = 0;
+    sched->slack_us = slack_us;
+    sched->n_wakeups = 0;
+    sched->n_steps = 0;
+    sched->n_coalesced = 0;
+    sched->idle = NULL;
+    sched->idle_arg = NULL;
+}
+
+/*!
+ * @brief       Add a sensor to the scheduler
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   ctx                 context of the sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ *
+ * @return      zero if successful, negative if the scheduler is full
+ */
+int8_t bsec_iot_sched_add(bsec_iot_sched_t *sched, bsec_iot_ctx_t *ctx) {
+    if (sched->n_ctxs >= BSEC_IOT_SCHED_MAX_SENSORS) {
+        return -1;
+    }
+
+    sched->heap[sched->n_ctxs] = ctx;
+    bsec_iot_sched_sift_up(sched, sched->n_ctxs);
+    sched->n_ctxs++;
+
+    return 0;
+}
+
+/*!
+ * @brief       Put a sensor back in order after its deadline was changed outside of the scheduler
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   ctx                 context of the sensor
+ *
+ * @return      none
+ */
+void bsec_iot_sched_reschedule(bsec_iot_sched_t *sched, bsec_iot_ctx_t *ctx) {
+    uint8_t pos;
+
+    for (pos = 0; pos < sched->n_ctxs; pos++) {
+        if (sched->heap[pos] == ctx) {
+            bsec_iot_sched_sift_up(sched, pos);
+            bsec_iot_sched_sift_down(sched, pos);
+            return;
+        }
+    }
+}
+
+/*!
+ * @brief       Set the function run by bsec_iot_sched_loop() while all the sensors wait for their next deadline
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   idle                pointer to the idle function, NULL for none
+ * @param[in]   idle_arg            pointer handed to the idle function
+ *
+ * @return      none
+ */
+void bsec_iot_sched_set_idle(bsec_iot_sched_t *sched, bsec_iot_idle_fct idle, void *idle_arg) {
+    sched->idle = idle;
+    sched->idle_arg = idle_arg;
+}
+
+/*!
+ * @brief       Run every phase that is due and compute the next wakeup
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      absolute timestamp (in microseconds) at which bsec_iot_sched_run() has to be called next
+ */
+int64_t bsec_iot_sched_run(bsec_iot_sched_t *sched, int64_t now_us) {
+    bsec_iot_ctx_t *first = NULL;
+    uint32_t n_steps = 0;
+    uint8_t pos;
+
+    if (sched->n_ctxs == 0) {
+        return INT64_MAX;
+    }
+
+    /* Apply the cycles brought forward by the processing of the sensors, which may run on another task. A deadline
+     * only moves earlier here, and the entries moved down in its place were already looked at. */
+    for (pos = 0; pos < sched->n_ctxs; pos++) {
+        if (bsec_iot_apply_control(sched->heap[pos], now_us)) {
+            bsec_iot_sched_sift_up(sched, pos);
+        }
+    }
+
+    /* Run the earliest phase and put its sensor back in place according to its new deadline, until nothing is due.
+     * Phases that can follow immediately (deadline equal to now) are run by the same wakeup. */
+    while (sched->heap[0]->deadline <= now_us) {
+        if (first == NULL) {
+            first = sched->heap[0];
+        } else if (sched->heap[0] != first) {
+            sched->n_coalesced++;
+        }
+        bsec_iot_step(sched->heap[0], now_us);
+        bsec_iot_sched_sift_down(sched, 0);
+        n_steps++;
+    }
+
+    if (n_steps > 0) {
+        sched->n_wakeups++;
+        sched->n_steps += n_steps;
+    }
+
+    /* Postpone the earliest deadline to the latest one within the slack window so they are all served together */
+    return bsec_iot_sched_latest_within(sched, 0, sched->heap[0]->deadline + sched->slack_us, sched->heap[0]->deadline);
+}
+
+/*!
+ * @brief       Runs the main (endless) loop serving all the sensors of the scheduler
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   sleep               pointer to the system specific sleep function
+ * @param[in]   get_timestamp_us    pointer to the system specific timestamp derivation function
+ *
+ * @return      none
+ */
+_Noreturn void bsec_iot_sched_loop(bsec_iot_sched_t *sched, bme68x_delay_us_fptr_t sleep,
+                                   get_timestamp_us_fct get_timestamp_us) {
+    int64_t wakeup = 0;
+    int64_t time_stamp_interval_us = 0;
+    int64_t now_us;
+
+    while (1) {
+        wakeup = bsec_iot_sched_run(sched, get_timestamp_us());
+
+        /* Slow work left for the idle time, out of the measurement path */
+        now_us = get_timestamp_us();
+        if (sched->idle != NULL && now_us < wakeup) {
+            sched->idle(sched->idle_arg, now_us, wakeup);
+            now_us = get_timestamp_us();
+        }
+
+        /* Sleep until the next wakeup, a single timer serves all the sensors */
+        time_stamp_interval_us = wakeup - now_us;
+        if (time_stamp_interval_us > 0) {
+            sleep((uint32_t)time_stamp_interval_us, sched->n_ctxs > 0 ? sched->heap[0]->intf_ptr : NULL);
+        }
+    }
+}
+
+/*! @}*/
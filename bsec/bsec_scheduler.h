@@ -0,0 +1,142 @@
+/*!
+ * @file bsec_scheduler.h
+ *
+ * @brief
+ * Deadline scheduler running the acquisition cycle of several sensors from a single task
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_SCHEDULER_H__
+#define __BSEC_SCHEDULER_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Maximum number of sensors a scheduler can serve */
+#ifndef BSEC_IOT_SCHED_MAX_SENSORS
+#define BSEC_IOT_SCHED_MAX_SENSORS 16
+#endif
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to the function run while all the sensors of a scheduler wait for their next deadline */
+typedef void (*bsec_iot_idle_fct)(void *idle_arg, int64_t now_us, int64_t wakeup_us);
+
+/* Structure holding the sensors served by a scheduler, ordered by the deadline of their next phase */
+typedef struct {
+	/*! Min-heap of the sensor contexts keyed by their deadline */
+	bsec_iot_ctx_t *heap[BSEC_IOT_SCHED_MAX_SENSORS];
+	/*! Number of sensor contexts in heap */
+	uint8_t n_ctxs;
+	/*! Time (in microseconds) by which a deadline may be postponed to share a wakeup with later ones */
+	int64_t slack_us;
+	/*! Number of wakeups that ran at least one phase */
+	uint32_t n_wakeups;
+	/*! Number of phases run */
+	uint32_t n_steps;
+	/*! Number of phases that shared a wakeup with another sensor instead of needing their own */
+	uint32_t n_coalesced;
+	/*! Function run before sleeping until the next wakeup, NULL if none */
+	bsec_iot_idle_fct idle;
+	/*! Pointer handed to the idle function */
+	void *idle_arg;
+} bsec_iot_sched_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an empty scheduler
+ *
+ * @param[out]  sched               scheduler to initialize
+ * @param[in]   slack_us            time (in microseconds) by which a deadline may be postponed to share a wakeup
+ *
+ * @return      none
+ */
+void bsec_iot_sched_init(bsec_iot_sched_t *sched, int64_t slack_us);
+
+/*!
+ * @brief       Add a sensor to the scheduler
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   ctx                 context of the sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ *
+ * @return      zero if successful, negative if the scheduler is full
+ */
+int8_t bsec_iot_sched_add(bsec_iot_sched_t *sched, bsec_iot_ctx_t *ctx);
+
+/*!
+ * @brief       Put a sensor back in order after its deadline was changed outside of the scheduler
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   ctx                 context of the sensor, e.g. after bsec_iot_notify_data_ready()
+ *
+ * @return      none
+ */
+void bsec_iot_sched_reschedule(bsec_iot_sched_t *sched, bsec_iot_ctx_t *ctx);
+
+/*!
+ * @brief       Set the function run by bsec_iot_sched_loop() while all the sensors wait for their next deadline
+ *
+ * The idle function is handed the time of the next wakeup so that it can defer slow work such as NVM writes (see
+ * bsec_iot_persist_flush()) to when it does not delay any sensor.
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   idle                pointer to the idle function, NULL for none
+ * @param[in]   idle_arg            pointer handed to the idle function
+ *
+ * @return      none
+ */
+void bsec_iot_sched_set_idle(bsec_iot_sched_t *sched, bsec_iot_idle_fct idle, void *idle_arg);
+
+/*!
+ * @brief       Run every phase that is due and compute the next wakeup
+ *
+ * The returned wakeup is the latest deadline lying within slack_us of the earliest one, so that all of those phases
+ * are run by the same wakeup.
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   now_us              current system timestamp in microseconds
+ *
+ * @return      absolute timestamp (in microseconds) at which bsec_iot_sched_run() has to be called next
+ */
+int64_t bsec_iot_sched_run(bsec_iot_sched_t *sched, int64_t now_us);
+
+/*!
+ * @brief       Runs the main (endless) loop serving all the sensors of the scheduler
+ *
+ * @param[in]   sched               scheduler
+ * @param[in]   sleep               pointer to the system-specific sleep function
+ * @param[in]   get_timestamp_us    pointer to the system-specific timestamp derivation function
+ *
+ * @return      none
+ */
+BSEC_IOT_NORETURN void bsec_iot_sched_loop(bsec_iot_sched_t *sched, bme68x_delay_us_fptr_t sleep,
+                                           get_timestamp_us_fct get_timestamp_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_SCHEDULER_H__ */
+
+/*! @}*/
@@ -0,0 +1,349 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bsec_trace.h"
+
+/**********************************************************************************************************************/
+/* local type definitions */
+/**********************************************************************************************************************/
+
+/* The serialized header and records take the size of the structures, which have no padding */
+typedef char bsec_iot_trace_header_size[(sizeof(bsec_iot_trace_header_t) == 16) ? 1 : -1];
+typedef char bsec_iot_trace_record_size[(sizeof(bsec_iot_trace_record_t) == 60) ? 1 : -1];
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Store a 16-bit value in little-endian byte order
+ *
+ * @param[out]  buf                 destination, advanced past the value
+ * @param[in]   value               value to store
+ *
+ * @return      none
+ */
+static void bsec_iot_trace_put16(uint8_t **buf, uint16_t value) {
+    (*buf)[0] = (uint8_t)value;
+    (*buf)[1] = (uint8_t)(value >> 8);
+    *buf += 2;
+}
+
+/*!
+ * @brief       Store a 32-bit value in little-endian byte order
+ *
+ * @param[out]  buf                 destination, advanced past the value
+ * @param[in]   value               value to store
+ *
+ * @return      none
+ */
+static void bsec_iot_trace_put32(uint8_t **buf, uint32_t value) {
+    bsec_iot_trace_put16(buf, (uint16_t)value);
+    bsec_iot_trace_put16(buf, (uint16_t)(value >> 16));
+}
+
+/*!
+ * @brief       Load a 16-bit value stored in little-endian byte order
+ *
+ * @param[in]   buf                 source, advanced past the value
+ *
+ * @return      value
+ */
+static uint16_t bsec_iot_trace_get16(const uint8_t **buf) {
+    uint16_t value = (uint16_t)((*buf)[0] | ((*buf)[1] << 8));
+
+    *buf += 2;
+    return value;
+}
+
+/*!
+ * @brief       Load a 32-bit value stored in little-endian byte order
+ *
+ * @param[in]   buf                 source, advanced past the value
+ *
+ * @return      value
+ */
+static uint32_t bsec_iot_trace_get32(const uint8_t **buf) {
+    uint32_t value = bsec_iot_trace_get16(buf);
+
+    return value | ((uint32_t)bsec_iot_trace_get16(buf) << 16);
+}
+
+/*!
+ * @brief       Serialize a header, field by field, whatever the byte order of the host
+ *
+ * @param[out]  buf                 destination, sizeof(bsec_iot_trace_header_t) bytes
+ * @param[in]   header              header to serialize
+ *
+ * @return      none
+ */
+static void bsec_iot_trace_put_header(uint8_t *buf, const bsec_iot_trace_header_t *header) {
+    bsec_iot_trace_put32(&buf, header->magic);
+    bsec_iot_trace_put16(&buf, header->version);
+    bsec_iot_trace_put16(&buf, header->record_size);
+    bsec_iot_trace_put32(&buf, (uint32_t)header->start_time_stamp);
+    bsec_iot_trace_put32(&buf, (uint32_t)((uint64_t)header->start_time_stamp >> 32));
+}
+
+/*!
+ * @brief       Deserialize a header
+ *
+ * @param[out]  header              header read
+ * @param[in]   buf                 source, sizeof(bsec_iot_trace_header_t) bytes
+ *
+ * @return      none
+ */
+static void bsec_iot_trace_get_header(bsec_iot_trace_header_t *header, const uint8_t *buf) {
+    uint64_t time_stamp;
+
+    header->magic = bsec_iot_trace_get32(&buf);
+    header->version = bsec_iot_trace_get16(&buf);
+    header->record_size = bsec_iot_trace_get16(&buf);
+    time_stamp = bsec_iot_trace_get32(&buf);
+    time_stamp |= (uint64_t)bsec_iot_trace_get32(&buf) << 32;
+    header->start_time_stamp = (int64_t)time_stamp;
+}
+
+/*!
+ * @brief       Serialize a record, field by field, whatever the byte order of the host
+ *
+ * @param[out]  buf                 destination, sizeof(bsec_iot_trace_record_t) bytes
+ * @param[in]   record              record to serialize
+ *
+ * @return      none
+ */
+static void bsec_iot_trace_put_record(uint8_t *buf, const bsec_iot_trace_record_t *record) {
+    uint32_t signal;
+    uint8_t i;
+
+    bsec_iot_trace_put32(&buf, record->dt_us);
+    bsec_iot_trace_put32(&buf, record->process_data);
+    bsec_iot_trace_put16(&buf, record->heater_temperature);
+    bsec_iot_trace_put16(&buf, record->heater_duration);
+    *buf++ = record->op_mode;
+    *buf++ = record->run_gas;
+    *buf++ = record->temperature_oversampling;
+    *buf++ = record->pressure_oversampling;
+    *buf++ = record->humidity_oversampling;
+    *buf++ = record->n_inputs;
+    memcpy(buf, record->sensor_id, sizeof(record->sensor_id) + sizeof(record->reserved));
+    buf += sizeof(record->sensor_id) + sizeof(record->reserved);
+    for (i = 0; i < BSEC_IOT_TRACE_MAX_INPUTS; i++) {
+        /* IEEE 754 single precision, stored as its bit pattern */
+        memcpy(&signal, &record->signal[i], sizeof(signal));
+        bsec_iot_trace_put32(&buf, signal);
+    }
+}
+
+/*!
+ * @brief       Deserialize a record
+ *
+ * @param[out]  record              record read
+ * @param[in]   buf                 source, sizeof(bsec_iot_trace_record_t) bytes
+ *
+ * @return      none
+ */
+static void bsec_iot_trace_get_record(bsec_iot_trace_record_t *record, const uint8_t *buf) {
+    uint32_t signal;
+    uint8_t i;
+
+    record->dt_us = bsec_iot_trace_get32(&buf);
+    record->process_data = bsec_iot_trace_get32(&buf);
+    record->heater_temperature = bsec_iot_trace_get16(&buf);
+    record->heater_duration = bsec_iot_trace_get16(&buf);
+    record->op_mode = *buf++;
+    record->run_gas = *buf++;
+    record->temperature_oversampling = *buf++;
+    record->pressure_oversampling = *buf++;
+    record->humidity_oversampling = *buf++;
+    record->n_inputs = *buf++;
+    memcpy(record->sensor_id, buf, sizeof(record->sensor_id) + sizeof(record->reserved));
+    buf += sizeof(record->sensor_id) + sizeof(record->reserved);
+    for (i = 0; i < BSEC_IOT_TRACE_MAX_INPUTS; i++) {
+        signal = bsec_iot_trace_get32(&buf);
+        memcpy(&record->signal[i], &signal, sizeof(signal));
+    }
+}
+
+/*!
+ * @brief       Write a record, counting the failures
+ *
+ * @param[in]   trace               recording of the sensor
+ * @param[in]   record              record to write
+ *
+ * @return      zero if successful, negative otherwise
+ */
+static int8_t bsec_iot_trace_write_record(bsec_iot_trace_t *trace, const bsec_iot_trace_record_t *record) {
+    uint8_t buf[sizeof(bsec_iot_trace_record_t)];
+
+    bsec_iot_trace_put_record(buf, record);
+    if (trace->write(trace->storage, buf, sizeof(buf)) != 0) {
+        trace->n_write_errors++;
+        return -1;
+    }
+    trace->n_records++;
+
+    return 0;
+}
+
+/*!
+ * @brief       Initialize the recording of the inputs of a sensor
+ *
+ * @param[out]  trace               recording to initialize
+ * @param[in]   write               pointer to the function appending data to the log
+ * @param[in]   storage             pointer handed to the write function
+ *
+ * @return      none
+ */
+void bsec_iot_trace_init(bsec_iot_trace_t *trace, bsec_iot_trace_write_fct write, void *storage) {
+    memset(trace, 0, sizeof(*trace));
+    trace->write = write;
+    trace->storage = storage;
+}
+
+/*!
+ * @brief       Append one set of inputs to the log
+ *
+ * @param[in]   trace               recording of the sensor
+ * @param[in]   settings            sensor settings the inputs were measured with
+ * @param[in]   inputs              inputs handed to BSEC
+ * @param[in]   n_inputs            number of inputs
+ *
+ * @return      zero if successful, negative if the write failed
+ */
+int8_t bsec_iot_trace_append(bsec_iot_trace_t *trace, const bsec_bme_settings_t *settings, const bsec_input_t *inputs,
+                             uint8_t n_inputs) {
+    bsec_iot_trace_header_t header;
+    bsec_iot_trace_record_t record;
+    uint8_t buf[sizeof(bsec_iot_trace_header_t)];
+    int64_t time_us;
+    uint8_t i;
+
+    if (n_inputs == 0) {
+        return 0;
+    }
+    time_us = inputs[0].time_stamp / 1000;
+
+    if (!trace->started) {
+        header.magic = BSEC_IOT_TRACE_MAGIC;
+        header.version = BSEC_IOT_TRACE_VERSION;
+        header.record_size = sizeof(bsec_iot_trace_record_t);
+        header.start_time_stamp = time_us * 1000;
+        bsec_iot_trace_put_header(buf, &header);
+        if (trace->write(trace->storage, buf, sizeof(buf)) != 0) {
+            trace->n_write_errors++;
+            return -1;
+        }
+        trace->started = 1;
+        trace->last_time_us = time_us;
+    }
+
+    memset(&record, 0, sizeof(record));
+
+    /* A gap longer than a delta can hold is bridged by records without inputs */
+    while (time_us - trace->last_time_us > UINT32_MAX) {
+        record.dt_us = UINT32_MAX;
+        if (bsec_iot_trace_write_record(trace, &record) != 0) {
+            return -1;
+        }
+        trace->last_time_us += UINT32_MAX;
+    }
+
+    record.dt_us = (time_us > trace->last_time_us) ? (uint32_t)(time_us - trace->last_time_us) : 0;
+    record.process_data = (uint32_t)settings->process_data;
+    record.heater_temperature = settings->heater_temperature;
+    record.heater_duration = settings->heater_duration;
+    record.op_mode = settings->op_mode;
+    record.run_gas = settings->run_gas;
+    record.temperature_oversampling = settings->temperature_oversampling;
+    record.pressure_oversampling = settings->pressure_oversampling;
+    record.humidity_oversampling = settings->humidity_oversampling;
+    for (i = 0; i < n_inputs; i++) {
+        if (i >= BSEC_IOT_TRACE_MAX_INPUTS) {
+            trace->n_inputs_dropped += n_inputs - i;
+            break;
+        }
+        record.sensor_id[i] = inputs[i].sensor_id;
+        record.signal[i] = inputs[i].signal;
+        record.n_inputs++;
+    }
+    if (time_us > trace->last_time_us) {
+        trace->last_time_us = time_us;
+    }
+
+    return bsec_iot_trace_write_record(trace, &record);
+}
+
+/*!
+ * @brief       Trace function to give to bsec_iot_set_trace() with the recording as trace_arg
+ *
+ * @param[in]   trace_arg           recording of the sensor
+ * @param[in]   settings            sensor settings the inputs were measured with
+ * @param[in]   inputs              inputs handed to BSEC
+ * @param[in]   n_inputs            number of inputs
+ *
+ * @return      none
+ */
+void bsec_iot_trace_input(void *trace_arg, const bsec_bme_settings_t *settings, const bsec_input_t *inputs,
+                          uint8_t n_inputs) {
+    bsec_iot_trace_append((bsec_iot_trace_t *)trace_arg, settings, inputs, n_inputs);
+}
+
+/*!
+ * @brief       Feed a log through BSEC as fast as possible, with the time stamps of the recording
+ *
+ * @param[in]   ctx                 context of a sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ * @param[in]   log                 log, e.g. a file mapped into memory
+ * @param[in]   size                size of the log (in bytes)
+ * @param[in]   override_offset     non-zero to replace the recorded temperature offset with the one of the context
+ *
+ * @return      number of sets of inputs processed, negative if the log is not valid
+ */
+int32_t bsec_iot_trace_replay(bsec_iot_ctx_t *ctx, const uint8_t *log, uint32_t size, uint8_t override_offset) {
+    bsec_iot_trace_header_t header;
+    bsec_iot_trace_record_t record;
+    bsec_input_t inputs[BSEC_IOT_TRACE_MAX_INPUTS];
+    int64_t time_stamp;
+    uint32_t offset;
+    int32_t n_processed = 0;
+    uint8_t i;
+
+    if (size < sizeof(header)) {
+        return -1;
+    }
+    memset(inputs, 0, sizeof(inputs));
+    bsec_iot_trace_get_header(&header, log);
+    if (header.magic != BSEC_IOT_TRACE_MAGIC || header.version != BSEC_IOT_TRACE_VERSION ||
+        header.record_size != sizeof(record)) {
+        return -1;
+    }
+
+    /* A record cut short at the end of the log, e.g. by a power loss while writing it, is ignored */
+    time_stamp = header.start_time_stamp;
+    for (offset = sizeof(header); offset + sizeof(record) <= size; offset += sizeof(record)) {
+        bsec_iot_trace_get_record(&record, log + offset);
+        time_stamp += (int64_t)record.dt_us * 1000;
+        if (record.n_inputs == 0 || record.n_inputs > BSEC_IOT_TRACE_MAX_INPUTS) {
+            continue;
+        }
+
+        for (i = 0; i < record.n_inputs; i++) {
+            inputs[i].time_stamp = time_stamp;
+            inputs[i].sensor_id = record.sensor_id[i];
+            inputs[i].signal = record.signal[i];
+            if (override_offset && record.sensor_id[i] == BSEC_INPUT_HEATSOURCE) {
+                inputs[i].signal = ctx->temperature_offset;
+            }
+        }
+        bsec_iot_process_inputs(ctx, inputs, record.n_inputs);
+        n_processed++;
+    }
+
+    return n_processed;
+}
+
+/*! @}*/
@@ -0,0 +1,176 @@
+/*!
+ * @file bsec_trace.h
+ *
+ * @brief
+ * Recording of the inputs handed to BSEC into a compact binary log, and offline replay of such a log
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BSEC_TRACE_H__
+#define __BSEC_TRACE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include "bsec_integration.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Marker at the start of a log */
+#define BSEC_IOT_TRACE_MAGIC UINT32_C(0x43525442)
+
+/* Version of the log format */
+#define BSEC_IOT_TRACE_VERSION UINT16_C(1)
+
+/* Number of inputs a record can hold */
+#define BSEC_IOT_TRACE_MAX_INPUTS 8
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to the function appending data to the log, returning zero if successful */
+typedef int8_t (*bsec_iot_trace_write_fct)(void *storage, const void *data, uint32_t length);
+
+/* Structure at the start of a log. The log is a header followed by fixed-size records, so that it can be mapped into
+ * memory and the n-th record found without decoding the ones before it. Both are stored field by field in the order
+ * below, without padding and in little-endian byte order whatever the host, so that a log recorded on the target
+ * replays on any machine. */
+typedef struct {
+	/*! BSEC_IOT_TRACE_MAGIC */
+	uint32_t magic;
+	/*! BSEC_IOT_TRACE_VERSION */
+	uint16_t version;
+	/*! Size (in bytes) of each record */
+	uint16_t record_size;
+	/*! Time stamp (in nanoseconds) the time stamps of the records are relative to */
+	int64_t start_time_stamp;
+} bsec_iot_trace_header_t;
+
+/* Structure of a record, holding one set of inputs and the sensor settings they were measured with */
+typedef struct {
+	/*! Time (in microseconds) elapsed since the previous record, or since the start for the first one */
+	uint32_t dt_us;
+	/*! Process data flags returned by bsec_sensor_control() */
+	uint32_t process_data;
+	/*! Heater temperature (in degrees Celsius) */
+	uint16_t heater_temperature;
+	/*! Heater duration (in milliseconds) */
+	uint16_t heater_duration;
+	/*! Operation mode of the sensor */
+	uint8_t op_mode;
+	/*! Set when the gas was measured */
+	uint8_t run_gas;
+	/*! Temperature oversampling */
+	uint8_t temperature_oversampling;
+	/*! Pressure oversampling */
+	uint8_t pressure_oversampling;
+	/*! Humidity oversampling */
+	uint8_t humidity_oversampling;
+	/*! Number of inputs, zero for a record that only carries time forward */
+	uint8_t n_inputs;
+	/*! Sensor identifier of each input */
+	uint8_t sensor_id[BSEC_IOT_TRACE_MAX_INPUTS];
+	/*! Padding, zero */
+	uint8_t reserved[2];
+	/*! Signal of each input */
+	float signal[BSEC_IOT_TRACE_MAX_INPUTS];
+} bsec_iot_trace_record_t;
+
+/* Structure holding the recording of the inputs of one sensor */
+typedef struct {
+	/*! Function appending data to the log */
+	bsec_iot_trace_write_fct write;
+	/*! Pointer handed to the write function, e.g. a FILE pointer */
+	void *storage;
+	/*! Set once the header has been written */
+	uint8_t started;
+	/*! Time stamp (in microseconds) of the latest record */
+	int64_t last_time_us;
+	/*! Number of records written */
+	uint32_t n_records;
+	/*! Number of inputs left out because a record was full */
+	uint32_t n_inputs_dropped;
+	/*! Number of failed writes */
+	uint32_t n_write_errors;
+} bsec_iot_trace_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize the recording of the inputs of a sensor
+ *
+ * The header is written along with the first record, the log starts at the time stamp of that record.
+ *
+ * @param[out]  trace               recording to initialize
+ * @param[in]   write               pointer to the function appending data to the log
+ * @param[in]   storage             pointer handed to the write function
+ *
+ * @return      none
+ */
+void bsec_iot_trace_init(bsec_iot_trace_t *trace, bsec_iot_trace_write_fct write, void *storage);
+
+/*!
+ * @brief       Append one set of inputs to the log
+ *
+ * All the inputs of a set share the time stamp of the sample, which the integration gives in whole microseconds.
+ *
+ * @param[in]   trace               recording of the sensor
+ * @param[in]   settings            sensor settings the inputs were measured with
+ * @param[in]   inputs              inputs handed to BSEC
+ * @param[in]   n_inputs            number of inputs
+ *
+ * @return      zero if successful, negative if the write failed
+ */
+int8_t bsec_iot_trace_append(bsec_iot_trace_t *trace, const bsec_bme_settings_t *settings, const bsec_input_t *inputs,
+                             uint8_t n_inputs);
+
+/*!
+ * @brief       Trace function to give to bsec_iot_set_trace() with the recording as trace_arg
+ *
+ * @param[in]   trace_arg           recording of the sensor
+ * @param[in]   settings            sensor settings the inputs were measured with
+ * @param[in]   inputs              inputs handed to BSEC
+ * @param[in]   n_inputs            number of inputs
+ *
+ * @return      none
+ */
+void bsec_iot_trace_input(void *trace_arg, const bsec_bme_settings_t *settings, const bsec_input_t *inputs,
+                          uint8_t n_inputs);
+
+/*!
+ * @brief       Feed a log through BSEC as fast as possible, with the time stamps of the recording
+ *
+ * The outputs are handed to the output_ready() function of the sensor as they were in the live run. They are identical
+ * to the live ones when BSEC starts from the same configuration, state and subscription as the recording did.
+ *
+ * @param[in]   ctx                 context of a sensor, initialized with bsec_iot_init() and bsec_iot_set_handlers()
+ * @param[in]   log                 log, e.g. a file mapped into memory
+ * @param[in]   size                size of the log (in bytes)
+ * @param[in]   override_offset     non-zero to replace the recorded temperature offset with the one of the context
+ *
+ * @return      number of sets of inputs processed, negative if the log is not valid
+ */
+int32_t bsec_iot_trace_replay(bsec_iot_ctx_t *ctx, const uint8_t *log, uint32_t size, uint8_t override_offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BSEC_TRACE_H__ */
+
+/*! @}*/
@@ -0,0 +1,450 @@
+/*!
+ * @file batch.c
+ *
+ * @brief
+ * Parallel reprocessing of logs of BSEC inputs (see bsec_trace.h) with one or more BSEC configurations. Each pair of
+ * log and configuration is a job; the jobs are handed out to a pool of worker threads, each with its own arena and
+ * BSEC instance, so that the throughput scales with the cores of the host.
+ *
+ * The outputs of a job are written to <output dir>/<log name>.<configuration index>/ as one file per column, all with
+ * one entry per set of inputs: timestamp.i64 (nanoseconds), valid_mask.u32, then <output>.f32 (NaN when not produced)
+ * and <output>.acc.u8 for each BSEC output. Values are in the byte order of the host.
+ *
+ * Usage: bsec_batch [-j threads] [-c configuration]... [-T temperature offset] -d <output dir> <log>...
+ */
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bsec_trace.h"
+#include "bme68x_emu.h"
+
+/**********************************************************************************************************************/
+/* local macro definitions */
+/**********************************************************************************************************************/
+
+#define BATCH_MAX_THREADS 256
+#define BATCH_MAX_CONFIGS 64
+
+/* Size (in bytes) of the buffer of each column file */
+#define BATCH_COLUMN_BUFFER 65536
+
+/* Number of column files of a job: timestamp, valid mask, then value and accuracy of each output */
+#define BATCH_N_COLUMNS (2 + 2 * BSEC_IOT_NUM_OUTPUTS)
+
+/**********************************************************************************************************************/
+/* local type definitions */
+/**********************************************************************************************************************/
+
+/* Structure holding a file mapped into memory */
+typedef struct {
+	/*! Path of the file */
+	const char *path;
+	/*! Content of the file */
+	const uint8_t *data;
+	/*! Size of the file (in bytes) */
+	uint32_t size;
+} batch_file_t;
+
+/* Structure holding the state of one worker thread */
+typedef struct {
+	/*! Thread running the worker */
+	pthread_t thread;
+	/*! Sensor context, its BSEC instance is reused from one job to the next */
+	bsec_iot_ctx_t ctx;
+	/*! Emulated sensor, only needed by bsec_iot_init() */
+	bme68x_emu_t emu;
+	/*! Arena holding the BSEC instance of the worker */
+	bsec_iot_arena_t arena;
+	/*! Memory of the arena */
+	uint8_t *arena_mem;
+	/*! Configuration of the current job, NULL for the default one */
+	const batch_file_t *config;
+	/*! Column files of the current job */
+	FILE *columns[BATCH_N_COLUMNS];
+	/*! Number of jobs run */
+	uint32_t n_jobs;
+	/*! Number of sets of inputs processed */
+	uint64_t n_samples;
+	/*! Number of jobs that failed */
+	uint32_t n_failed;
+} batch_worker_t;
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+/* File name of each output, indexed by bsec_iot_output_id_t */
+static const char *const batch_output_names[BSEC_IOT_NUM_OUTPUTS] = {
+    "iaq", "static_iaq", "co2_equivalent", "breath_voc_equivalent", "raw_temperature", "raw_pressure", "raw_humidity",
+    "raw_gas", "stabilization_status", "run_in_status", "temperature", "humidity", "compensated_gas", "gas_percentage",
+    "gas_estimate_1", "gas_estimate_2", "gas_estimate_3", "gas_estimate_4", "raw_gas_index",
+};
+
+static batch_file_t logs[4096];
+static uint32_t n_logs;
+static batch_file_t configs[BATCH_MAX_CONFIGS];
+static uint32_t n_configs;
+static const char *out_dir;
+static float temperature_offset;
+static uint8_t override_offset;
+
+/* Index of the next job to hand out, the jobs are taken in order by whichever worker is free first */
+static uint32_t next_job;
+static uint32_t n_jobs;
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Map a file into memory
+ *
+ * @param[out]  file                mapped file
+ * @param[in]   path                path of the file
+ *
+ * @return      zero if successful, negative otherwise
+ */
+static int8_t batch_map(batch_file_t *file, const char *path) {
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > UINT32_MAX) {
+        fprintf(stderr, "%s: cannot be read\n", path);
+        return -1;
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    file->path = path;
+    file->data = data;
+    file->size = (uint32_t)st.st_size;
+
+    return 0;
+}
+
+/*!
+ * @brief       Append the outputs of a set of inputs to the column files of the job
+ *
+ * @param[in]   ctx                 context of the worker
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void batch_output_ready(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    batch_worker_t *worker = ctx->user_data;
+    float value;
+    uint8_t accuracy;
+    uint8_t id;
+
+    fwrite(&output->timestamp, sizeof(output->timestamp), 1, worker->columns[0]);
+    fwrite(&output->valid_mask, sizeof(output->valid_mask), 1, worker->columns[1]);
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        if (output->valid_mask & BSEC_IOT_OUTPUT_MASK(id)) {
+            value = output->value[id];
+            accuracy = output->accuracy[id];
+        } else {
+            value = NAN;
+            accuracy = 0;
+        }
+        fwrite(&value, sizeof(value), 1, worker->columns[2 + 2 * id]);
+        fwrite(&accuracy, sizeof(accuracy), 1, worker->columns[3 + 2 * id]);
+    }
+}
+
+/*!
+ * @brief       Start from the configuration of the job, and without state
+ *
+ * @param[in]   ctx                 context of the worker
+ * @param[out]  config_buffer       buffer to hold the configuration
+ * @param[in]   n_buffer            size of the buffer
+ *
+ * @return      size of the configuration, zero for the default one
+ */
+static uint32_t batch_config_load(bsec_iot_ctx_t *ctx, uint8_t *config_buffer, uint32_t n_buffer) {
+    batch_worker_t *worker = ctx->user_data;
+
+    if (worker->config == NULL || worker->config->size > n_buffer) {
+        return 0;
+    }
+    memcpy(config_buffer, worker->config->data, worker->config->size);
+
+    return worker->config->size;
+}
+
+/*!
+ * @brief       Start without state
+ *
+ * @param[in]   ctx                 context of the worker
+ * @param[out]  state_buffer        buffer to hold the state
+ * @param[in]   n_buffer            size of the buffer
+ *
+ * @return      zero
+ */
+static uint32_t batch_state_load(bsec_iot_ctx_t *ctx, uint8_t *state_buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)state_buffer;
+    (void)n_buffer;
+    return 0;
+}
+
+/*!
+ * @brief       Time of the emulated sensor, which never measures here
+ *
+ * @return      zero
+ */
+static int64_t batch_clock(void) {
+    return 0;
+}
+
+/*!
+ * @brief       Sleep of the emulated sensor, returns at once
+ *
+ * @param[in]   period              time in microseconds
+ * @param[in]   intf_ptr            unused
+ *
+ * @return      none
+ */
+static void batch_sleep(uint32_t period, void *intf_ptr) {
+    (void)period;
+    (void)intf_ptr;
+}
+
+/*!
+ * @brief       Open the column files of a job
+ *
+ * @param[in]   worker              worker running the job
+ * @param[in]   dir                 directory of the job
+ *
+ * @return      zero if successful, negative otherwise
+ */
+static int8_t batch_open_columns(batch_worker_t *worker, const char *dir) {
+    char path[4096 + 64];
+    uint8_t column;
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        perror(dir);
+        return -1;
+    }
+    for (column = 0; column < BATCH_N_COLUMNS; column++) {
+        if (column == 0) {
+            snprintf(path, sizeof(path), "%s/timestamp.i64", dir);
+        } else if (column == 1) {
+            snprintf(path, sizeof(path), "%s/valid_mask.u32", dir);
+        } else {
+            snprintf(path, sizeof(path), (column % 2 == 0) ? "%s/%s.f32" : "%s/%s.acc.u8", dir,
+                     batch_output_names[(column - 2) / 2]);
+        }
+        worker->columns[column] = fopen(path, "wb");
+        if (worker->columns[column] == NULL) {
+            perror(path);
+            return -1;
+        }
+        setvbuf(worker->columns[column], NULL, _IOFBF, BATCH_COLUMN_BUFFER);
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       Close the column files of a job
+ *
+ * @param[in]   worker              worker running the job
+ *
+ * @return      zero if all the data was written, negative otherwise
+ */
+static int8_t batch_close_columns(batch_worker_t *worker) {
+    int8_t result = 0;
+    uint8_t column;
+
+    for (column = 0; column < BATCH_N_COLUMNS; column++) {
+        if (worker->columns[column] != NULL && fclose(worker->columns[column]) != 0) {
+            result = -1;
+        }
+        worker->columns[column] = NULL;
+    }
+
+    return result;
+}
+
+/*!
+ * @brief       Run one job: a fresh BSEC instance with the configuration of the job replays the log of the job
+ *
+ * @param[in]   worker              worker running the job
+ * @param[in]   job                 index of the job
+ *
+ * @return      zero if successful, negative otherwise
+ */
+static int8_t batch_run_job(batch_worker_t *worker, uint32_t job) {
+    const batch_file_t *log = &logs[job / n_configs];
+    const char *name = strrchr(log->path, '/');
+    char dir[4096];
+    return_values_init ret;
+    int32_t n_processed;
+
+    worker->config = configs[job % n_configs].data != NULL ? &configs[job % n_configs] : NULL;
+    snprintf(dir, sizeof(dir), "%s/%s.%u", out_dir, name != NULL ? name + 1 : log->path, job % n_configs);
+    if (batch_open_columns(worker, dir) != 0) {
+        batch_close_columns(worker);
+        return -1;
+    }
+
+    /* The instance of the previous job is given back to the arena */
+    worker->arena.used = 0;
+    worker->ctx.user_data = worker;
+    ret = bsec_iot_init(&worker->ctx, BME68X_I2C_INTF, 0x76, &worker->emu, BSEC_SAMPLE_RATE_LP, NULL, 0,
+                        temperature_offset, bme68x_emu_write, bme68x_emu_read, batch_sleep, batch_state_load,
+                        batch_config_load, &worker->arena);
+    if (ret.bme68x_status != BME68X_OK || ret.bsec_status != BSEC_OK) {
+        fprintf(stderr, "%s: init failed (bme68x %d, bsec %d)\n", dir, ret.bme68x_status, ret.bsec_status);
+        batch_close_columns(worker);
+        return -1;
+    }
+    bsec_iot_set_handlers(&worker->ctx, batch_output_ready, NULL, 0);
+
+    n_processed = bsec_iot_trace_replay(&worker->ctx, log->data, log->size, override_offset);
+    if (batch_close_columns(worker) != 0 || n_processed < 0) {
+        fprintf(stderr, "%s: %s\n", dir, n_processed < 0 ? "not a valid log" : "write failed");
+        return -1;
+    }
+    worker->n_samples += (uint64_t)n_processed;
+
+    return 0;
+}
+
+/*!
+ * @brief       Take jobs until none is left
+ *
+ * @param[in]   arg                 worker
+ *
+ * @return      NULL
+ */
+static void *batch_worker(void *arg) {
+    batch_worker_t *worker = arg;
+    uint32_t job;
+
+    while ((job = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) < n_jobs) {
+        if (batch_run_job(worker, job) != 0) {
+            worker->n_failed++;
+        }
+        worker->n_jobs++;
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief       Run the batch
+ *
+ * @return      zero if all the jobs succeeded, one otherwise
+ */
+int main(int argc, char **argv) {
+    static batch_worker_t workers[BATCH_MAX_THREADS];
+    struct timespec start, end;
+    uint32_t n_threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t n_samples = 0;
+    uint32_t n_failed = 0;
+    double seconds;
+    uint32_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:c:T:d:")) != -1) {
+        switch (opt) {
+        case 'j':
+            n_threads = (uint32_t)atoi(optarg);
+            break;
+        case 'c':
+            if (n_configs >= BATCH_MAX_CONFIGS || batch_map(&configs[n_configs++], optarg) != 0) {
+                return 1;
+            }
+            break;
+        case 'T':
+            temperature_offset = strtof(optarg, NULL);
+            override_offset = 1;
+            break;
+        case 'd':
+            out_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-j threads] [-c configuration]... [-T temperature offset] -d <output dir> "
+                    "<log>...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (out_dir == NULL || optind >= argc) {
+        fprintf(stderr, "usage: %s [-j threads] [-c configuration]... [-T temperature offset] -d <output dir> "
+                "<log>...\n", argv[0]);
+        return 1;
+    }
+    for (; optind < argc && n_logs < sizeof(logs) / sizeof(logs[0]); optind++) {
+        if (batch_map(&logs[n_logs++], argv[optind]) != 0) {
+            return 1;
+        }
+    }
+    if (mkdir(out_dir, 0777) != 0 && errno != EEXIST) {
+        perror(out_dir);
+        return 1;
+    }
+
+    /* Without any configuration given, each log is replayed once with the default configuration */
+    if (n_configs == 0) {
+        n_configs = 1;
+    }
+    n_jobs = n_logs * n_configs;
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
+    if (n_threads > BATCH_MAX_THREADS) {
+        n_threads = BATCH_MAX_THREADS;
+    }
+    if (n_threads > n_jobs) {
+        n_threads = n_jobs;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < n_threads; i++) {
+        workers[i].arena_mem = aligned_alloc(4, BSEC_IOT_ARENA_SIZE(1));
+        if (workers[i].arena_mem == NULL) {
+            return 1;
+        }
+        bsec_iot_arena_init(&workers[i].arena, workers[i].arena_mem, BSEC_IOT_ARENA_SIZE(1));
+        bme68x_emu_init(&workers[i].emu, BME68X_EMU_VARIANT_BME688, batch_clock);
+        pthread_create(&workers[i].thread, NULL, batch_worker, &workers[i]);
+    }
+    for (i = 0; i < n_threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        n_samples += workers[i].n_samples;
+        n_failed += workers[i].n_failed;
+        free(workers[i].arena_mem);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%u jobs (%u failed) on %u threads: %llu samples in %.3f s, %.0f samples/s\n", n_jobs, n_failed, n_threads,
+           (unsigned long long)n_samples, seconds, seconds > 0 ? n_samples / seconds : 0.0);
+    for (i = 0; i < n_threads; i++) {
+        printf("thread %u: %u jobs, %llu samples\n", i, workers[i].n_jobs, (unsigned long long)workers[i].n_samples);
+    }
+
+    return n_failed > 0;
+}
@@ -0,0 +1,319 @@
+/*!
+ * @file bench.c
+ *
+ * @brief
+ * Benchmark of the acquisition cycle: drives one emulated sensor through bsec_iot_step() for a number of cycles in
+ * LP, ULP and parallel (gas scanning) mode, on I2C and SPI, and reports the latency percentiles of each phase, the bus traffic per
+ * sample and the slip of the cycles versus the next_call requested by BSEC. The latencies are wall-clock times of the
+ * host, the cycle timing runs on the virtual clock.
+ *
+ * Usage: bsec_bench [cycles] [-j]; -j prints one JSON object per mode instead of the table
+ */
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bsec_integration.h"
+#include "bme68x_emu.h"
+#include "host_clock.h"
+
+/**********************************************************************************************************************/
+/* local macro definitions */
+/**********************************************************************************************************************/
+
+/* Number of samples between two state saves, low enough for the save path to show in the percentiles */
+#define BENCH_SAVE_INTVL 50
+
+/**********************************************************************************************************************/
+/* local type definitions */
+/**********************************************************************************************************************/
+
+/* Structure describing one benchmarked mode */
+typedef struct {
+	/*! Name of the mode in the report */
+	const char *name;
+	/*! Sample rate requested from BSEC */
+	float sample_rate;
+	/*! Emulated sensor variant */
+	uint8_t variant_id;
+	/*! Bus the emulated sensor is on */
+	enum bme68x_intf intf;
+} bench_mode_t;
+
+/* Structure holding the latencies of one phase */
+typedef struct {
+	/*! Latencies (in nanoseconds) */
+	int64_t *ns;
+	/*! Number of latencies */
+	uint32_t n;
+} bench_samples_t;
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+static const bench_mode_t bench_modes[] = {
+    {"lp", BSEC_SAMPLE_RATE_LP, BME68X_EMU_VARIANT_BME680, BME68X_I2C_INTF},
+    {"ulp", BSEC_SAMPLE_RATE_ULP, BME68X_EMU_VARIANT_BME680, BME68X_I2C_INTF},
+    {"parallel", BSEC_SAMPLE_RATE_SCAN, BME68X_EMU_VARIANT_BME688, BME68X_I2C_INTF},
+    {"lp-spi", BSEC_SAMPLE_RATE_LP, BME68X_EMU_VARIANT_BME680, BME68X_SPI_INTF},
+    {"parallel-spi", BSEC_SAMPLE_RATE_SCAN, BME68X_EMU_VARIANT_BME688, BME68X_SPI_INTF},
+};
+
+static const char *const bench_phase_names[BSEC_IOT_NUM_PHASES] = {"control", "trigger", "read", "process", "save"};
+
+static bsec_iot_ctx_t ctx;
+static bme68x_emu_t emu;
+static uint8_t arena_mem[BSEC_IOT_ARENA_SIZE(1)] __attribute__((aligned(4)));
+static bsec_iot_arena_t arena;
+static uint32_t n_outputs;
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Count the outputs
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void bench_output_ready(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    (void)ctx;
+    (void)output;
+    n_outputs++;
+}
+
+/*!
+ * @brief       Start without state
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   buffer              buffer to hold the loaded string
+ * @param[in]   n_buffer            size of the buffer
+ *
+ * @return      zero
+ */
+static uint32_t bench_load(bsec_iot_ctx_t *ctx, uint8_t *buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)buffer;
+    (void)n_buffer;
+    return 0;
+}
+
+/*!
+ * @brief       Discard the state, only its retrieval is benchmarked
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   state_buffer        buffer holding the state to be stored
+ * @param[in]   length              length of the state string
+ *
+ * @return      none
+ */
+static void bench_state_save(bsec_iot_ctx_t *ctx, const uint8_t *state_buffer, uint32_t length) {
+    (void)ctx;
+    (void)state_buffer;
+    (void)length;
+}
+
+/*!
+ * @brief       Wall-clock time of the host
+ *
+ * @return      time in nanoseconds
+ */
+static int64_t bench_wall_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*!
+ * @brief       Order two latencies for qsort()
+ *
+ * @param[in]   a                   first latency
+ * @param[in]   b                   second latency
+ *
+ * @return      negative, zero or positive as a is lower than, equal to or greater than b
+ */
+static int bench_compare(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*!
+ * @brief       Percentile of sorted latencies
+ *
+ * @param[in]   samples             sorted latencies
+ * @param[in]   percent             percentile [0-100]
+ *
+ * @return      latency (in nanoseconds), zero if there is none
+ */
+static int64_t bench_percentile(const bench_samples_t *samples, uint32_t percent) {
+    if (samples->n == 0) {
+        return 0;
+    }
+    return samples->ns[(uint64_t)(samples->n - 1) * percent / 100];
+}
+
+/*!
+ * @brief       Benchmark one mode and print its report
+ *
+ * @param[in]   mode                mode to benchmark
+ * @param[in]   n_cycles            number of acquisition cycles to run
+ * @param[in]   json                print JSON instead of a table
+ *
+ * @return      zero if successful, negative otherwise
+ */
+static int8_t bench_run(const bench_mode_t *mode, uint32_t n_cycles, uint8_t json) {
+    bench_samples_t samples[BSEC_IOT_NUM_PHASES];
+    return_values_init ret;
+    bsec_iot_phase_t phase;
+    uint32_t n_cycles_done = 0, n_samples = 0, n_late = 0;
+    int64_t slip_sum = 0, slip_max = 0, slip;
+    int64_t expected = -1;
+    int64_t start, deadline;
+    uint8_t p;
+
+    host_clock_reset();
+    bsec_iot_arena_init(&arena, arena_mem, sizeof(arena_mem));
+    bme68x_emu_init(&emu, mode->variant_id, host_clock_now_us);
+    if (mode->intf == BME68X_SPI_INTF) {
+        bme68x_emu_set_spi(&emu);
+    }
+    ret = bsec_iot_init(&ctx, mode->intf, 0x76, &emu, mode->sample_rate, NULL, 0, 0.0f, bme68x_emu_write,
+                        bme68x_emu_read, host_clock_sleep, bench_load, bench_load, &arena);
+    if (ret.bme68x_status != BME68X_OK || ret.bsec_status != BSEC_OK) {
+        fprintf(stderr, "%s: init failed (bme68x %d, bsec %d)\n", mode->name, ret.bme68x_status, ret.bsec_status);
+        return -1;
+    }
+    bsec_iot_set_handlers(&ctx, bench_output_ready, bench_state_save, BENCH_SAVE_INTVL);
+    memset(&ctx.bus_stats, 0, sizeof(ctx.bus_stats));
+    n_outputs = 0;
+
+    /* A cycle has at most one save, every other phase runs once per cycle apart from the read retries */
+    for (p = 0; p < BSEC_IOT_NUM_PHASES; p++) {
+        samples[p].ns = malloc(sizeof(int64_t) * 4 * (n_cycles + 1));
+        samples[p].n = 0;
+        if (samples[p].ns == NULL) {
+            return -1;
+        }
+    }
+
+    while (n_cycles_done < n_cycles) {
+        phase = ctx.phase;
+        if (phase == BSEC_IOT_PHASE_CONTROL) {
+            /* Slip of the cycle versus the time BSEC asked to be called at */
+            if (expected >= 0) {
+                slip = host_clock_now_us() - expected;
+                slip_sum += slip;
+                if (slip > slip_max) {
+                    slip_max = slip;
+                }
+                if (slip > 0) {
+                    n_late++;
+                }
+                n_cycles_done++;
+            }
+        } else if (phase == BSEC_IOT_PHASE_PROCESS) {
+            n_samples++;
+        }
+
+        start = bench_wall_ns();
+        deadline = bsec_iot_step(&ctx, host_clock_now_us());
+        if (samples[phase].n < 4 * (n_cycles + 1)) {
+            samples[phase].ns[samples[phase].n++] = bench_wall_ns() - start;
+        }
+
+        if (phase == BSEC_IOT_PHASE_CONTROL) {
+            expected = ctx.next_call / 1000;
+        }
+        if (deadline > host_clock_now_us()) {
+            host_clock_advance(deadline - host_clock_now_us());
+        }
+    }
+
+    if (json) {
+        printf("{\"mode\":\"%s\",\"cycles\":%u,\"samples\":%u,\"outputs\":%u,\"phases\":{", mode->name, n_cycles_done,
+               n_samples, n_outputs);
+    } else {
+        printf("%s: %u cycles, %u samples, %u outputs\n", mode->name, n_cycles_done, n_samples, n_outputs);
+        printf("  %-8s %8s %10s %10s %10s %10s\n", "phase", "count", "p50 ns", "p90 ns", "p99 ns", "max ns");
+    }
+    for (p = 0; p < BSEC_IOT_NUM_PHASES; p++) {
+        qsort(samples[p].ns, samples[p].n, sizeof(int64_t), bench_compare);
+        if (json) {
+            printf("%s\"%s\":{\"count\":%u,\"p50_ns\":%lld,\"p90_ns\":%lld,\"p99_ns\":%lld,\"max_ns\":%lld}",
+                   p > 0 ? "," : "", bench_phase_names[p], samples[p].n,
+                   (long long)bench_percentile(&samples[p], 50), (long long)bench_percentile(&samples[p], 90),
+                   (long long)bench_percentile(&samples[p], 99), (long long)bench_percentile(&samples[p], 100));
+        } else {
+            printf("  %-8s %8u %10lld %10lld %10lld %10lld\n", bench_phase_names[p], samples[p].n,
+                   (long long)bench_percentile(&samples[p], 50), (long long)bench_percentile(&samples[p], 90),
+                   (long long)bench_percentile(&samples[p], 99), (long long)bench_percentile(&samples[p], 100));
+        }
+        free(samples[p].ns);
+    }
+
+    if (n_samples == 0) {
+        n_samples = 1;
+    }
+    if (n_cycles_done == 0) {
+        n_cycles_done = 1;
+    }
+    if (json) {
+        printf("},\"bus\":{\"reads_per_sample\":%.2f,\"writes_per_sample\":%.2f,\"bytes_read_per_sample\":%.2f,"
+               "\"bytes_written_per_sample\":%.2f,\"config_writes_skipped\":%u},"
+               "\"slip\":{\"mean_us\":%.1f,\"max_us\":%lld,\"late_cycles\":%u}}\n",
+               (double)ctx.bus_stats.n_reads / n_samples, (double)ctx.bus_stats.n_writes / n_samples,
+               (double)ctx.bus_stats.n_bytes_read / n_samples, (double)ctx.bus_stats.n_bytes_written / n_samples,
+               ctx.bus_stats.n_config_writes_skipped, (double)slip_sum / n_cycles_done, (long long)slip_max, n_late);
+    } else {
+        printf("  bus per sample: %.2f reads (%.2f bytes), %.2f writes (%.2f bytes), %u config writes skipped\n",
+               (double)ctx.bus_stats.n_reads / n_samples, (double)ctx.bus_stats.n_bytes_read / n_samples,
+               (double)ctx.bus_stats.n_writes / n_samples, (double)ctx.bus_stats.n_bytes_written / n_samples,
+               ctx.bus_stats.n_config_writes_skipped);
+        printf("  slip versus next_call: mean %.1f us, max %lld us, %u late cycles\n",
+               (double)slip_sum / n_cycles_done, (long long)slip_max, n_late);
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       Run the benchmark
+ *
+ * @return      zero if successful, one otherwise
+ */
+int main(int argc, char **argv) {
+    uint32_t n_cycles = 2000;
+    uint8_t json = 0;
+    uint8_t i;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-j") == 0) {
+            json = 1;
+        } else {
+            n_cycles = (uint32_t)atoi(argv[arg]);
+        }
+    }
+
+    for (i = 0; i < sizeof(bench_modes) / sizeof(bench_modes[0]); i++) {
+        if (bench_run(&bench_modes[i], n_cycles, json) != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,415 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bme68x_emu.h"
+
+/**********************************************************************************************************************/
+/* local macro definitions */
+/**********************************************************************************************************************/
+
+/* Registers of the BME68X as seen over I2C */
+#define BME68X_EMU_REG_FIELD0       UINT8_C(0x1D)
+#define BME68X_EMU_REG_GAS_WAIT0    UINT8_C(0x64)
+#define BME68X_EMU_REG_SHD_HEATR    UINT8_C(0x6E)
+#define BME68X_EMU_REG_CTRL_GAS_1   UINT8_C(0x71)
+#define BME68X_EMU_REG_CTRL_HUM     UINT8_C(0x72)
+#define BME68X_EMU_REG_STATUS       UINT8_C(0x73)
+#define BME68X_EMU_REG_CTRL_MEAS    UINT8_C(0x74)
+#define BME68X_EMU_REG_CHIP_ID      UINT8_C(0xD0)
+#define BME68X_EMU_REG_SOFT_RESET   UINT8_C(0xE0)
+#define BME68X_EMU_REG_VARIANT_ID   UINT8_C(0xF0)
+
+/* SPI read bit and memory page bit of the status register, set for the page holding the registers below 0x80 */
+#define BME68X_EMU_SPI_RD           UINT8_C(0x80)
+#define BME68X_EMU_SPI_MEM_PAGE     UINT8_C(0x10)
+
+/* Length of a data field and number of data fields */
+#define BME68X_EMU_FIELD_LEN        17
+#define BME68X_EMU_N_FIELDS         3
+
+/* Operation modes in the ctrl_meas register */
+#define BME68X_EMU_MODE_MSK         UINT8_C(0x03)
+#define BME68X_EMU_MODE_FORCED      UINT8_C(0x01)
+#define BME68X_EMU_MODE_PARALLEL    UINT8_C(0x02)
+
+/* Bits of the status byte of a data field */
+#define BME68X_EMU_NEW_DATA         UINT8_C(0x80)
+#define BME68X_EMU_GAS_MEASURING    UINT8_C(0x40)
+#define BME68X_EMU_MEASURING        UINT8_C(0x20)
+#define BME68X_EMU_GAS_VALID        UINT8_C(0x20)
+#define BME68X_EMU_HEAT_STAB        UINT8_C(0x10)
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Store a 16-bit calibration parameter, least significant byte first
+ *
+ * @param[in]   emu                 emulated sensor
+ * @param[in]   reg_addr            address of the least significant byte
+ * @param[in]   value               value of the parameter
+ *
+ * @return      none
+ */
+static void bme68x_emu_set_calib16(bme68x_emu_t *emu, uint8_t reg_addr, int32_t value) {
+    emu->regs[reg_addr] = (uint8_t)(value & 0xFF);
+    emu->regs[reg_addr + 1] = (uint8_t)((value >> 8) & 0xFF);
+}
+
+/*!
+ * @brief       Duration (in microseconds) of the TPH conversion for the oversampling settings in the registers
+ *
+ * @param[in]   emu                 emulated sensor
+ * @param[in]   parallel            non-zero in parallel mode, which has no wake up time
+ *
+ * @return      duration of the conversion
+ */
+static uint32_t bme68x_emu_tph_dur(const bme68x_emu_t *emu, uint8_t parallel) {
+    static const uint8_t os_to_meas_cycles[8] = {0, 1, 2, 4, 8, 16, 16, 16};
+    uint8_t ctrl_meas = emu->regs[BME68X_EMU_REG_CTRL_MEAS];
+    uint32_t meas_cycles;
+
+    meas_cycles = os_to_meas_cycles[ctrl_meas >> 5] + os_to_meas_cycles[(ctrl_meas >> 2) & 0x07] +
+                  os_to_meas_cycles[emu->regs[BME68X_EMU_REG_CTRL_HUM] & 0x07];
+
+    /* Same budget as bme68x_get_meas_dur(): conversions, TPH switching, gas measurement and wake up */
+    return meas_cycles * 1963 + 477 * 4 + 477 * 5 + (parallel ? 0 : 1000);
+}
+
+/*!
+ * @brief       Duration (in microseconds) encoded in a heater duration register
+ *
+ * @param[in]   value               register value, 6 bits of duration and 2 bits of multiplication factor
+ * @param[in]   unit_us             unit of the duration
+ *
+ * @return      heater duration
+ */
+static uint32_t bme68x_emu_heatr_dur(uint8_t value, uint32_t unit_us) {
+    static const uint8_t factors[4] = {1, 4, 16, 64};
+
+    return (uint32_t)(value & 0x3F) * factors[value >> 6] * unit_us;
+}
+
+/*!
+ * @brief       Whether the gas measurement is enabled in the registers
+ *
+ * @param[in]   emu                 emulated sensor
+ *
+ * @return      non-zero if the gas is measured
+ */
+static uint8_t bme68x_emu_run_gas(const bme68x_emu_t *emu) {
+    uint8_t run_gas_msk = (emu->regs[BME68X_EMU_REG_VARIANT_ID] == BME68X_EMU_VARIANT_BME688) ? 0x20 : 0x10;
+
+    return (emu->regs[BME68X_EMU_REG_CTRL_GAS_1] & run_gas_msk) != 0;
+}
+
+/*!
+ * @brief       Duration (in microseconds) of a parallel mode heater profile step
+ *
+ * @param[in]   emu                 emulated sensor
+ *
+ * @return      duration of a step
+ */
+static uint32_t bme68x_emu_step_dur(const bme68x_emu_t *emu) {
+    uint32_t dur = bme68x_emu_tph_dur(emu, 1) + emu->meas_extra_us;
+
+    /* The shared heater duration is counted in steps of 477 us */
+    if (bme68x_emu_run_gas(emu)) {
+        dur += bme68x_emu_heatr_dur(emu->regs[BME68X_EMU_REG_SHD_HEATR], 477);
+    }
+
+    return dur;
+}
+
+/*!
+ * @brief       Store the result of a measurement in a data field
+ *
+ * @param[in]   emu                 emulated sensor
+ * @param[in]   field               data field
+ * @param[in]   gas_index           heater set point or profile step the gas was measured at
+ *
+ * @return      none
+ */
+static void bme68x_emu_store_field(bme68x_emu_t *emu, uint8_t field, uint8_t gas_index) {
+    uint8_t *data = &emu->regs[BME68X_EMU_REG_FIELD0 + field * BME68X_EMU_FIELD_LEN];
+    uint8_t gas_lsb = (uint8_t)(((emu->gas_adc & 0x03) << 6) | (emu->gas_range & 0x0F));
+
+    if (bme68x_emu_run_gas(emu)) {
+        gas_lsb |= BME68X_EMU_GAS_VALID | BME68X_EMU_HEAT_STAB;
+    }
+
+    data[0] = BME68X_EMU_NEW_DATA | (gas_index & 0x0F);
+    data[1] = emu->meas_index++;
+    data[2] = (uint8_t)(emu->pres_adc >> 12);
+    data[3] = (uint8_t)(emu->pres_adc >> 4);
+    data[4] = (uint8_t)((emu->pres_adc & 0x0F) << 4);
+    data[5] = (uint8_t)(emu->temp_adc >> 12);
+    data[6] = (uint8_t)(emu->temp_adc >> 4);
+    data[7] = (uint8_t)((emu->temp_adc & 0x0F) << 4);
+    data[8] = (uint8_t)(emu->hum_adc >> 8);
+    data[9] = (uint8_t)(emu->hum_adc & 0xFF);
+
+    /* The two variants report the gas resistance at different places */
+    if (emu->regs[BME68X_EMU_REG_VARIANT_ID] == BME68X_EMU_VARIANT_BME688) {
+        data[15] = (uint8_t)(emu->gas_adc >> 2);
+        data[16] = gas_lsb;
+    } else {
+        data[13] = (uint8_t)(emu->gas_adc >> 2);
+        data[14] = gas_lsb;
+    }
+
+    emu->n_measurements++;
+}
+
+/*!
+ * @brief       Bring the emulated sensor up to the current time, completing the measurements that ended
+ *
+ * @param[in]   emu                 emulated sensor
+ *
+ * @return      none
+ */
+static void bme68x_emu_update(bme68x_emu_t *emu) {
+    int64_t now_us = emu->clock();
+    uint8_t mode = emu->regs[BME68X_EMU_REG_CTRL_MEAS] & BME68X_EMU_MODE_MSK;
+    uint8_t nb_conv = emu->regs[BME68X_EMU_REG_CTRL_GAS_1] & 0x0F;
+
+    if (mode == BME68X_EMU_MODE_FORCED) {
+        if (now_us < emu->meas_end) {
+            emu->regs[BME68X_EMU_REG_FIELD0] |= BME68X_EMU_MEASURING |
+                                                (bme68x_emu_run_gas(emu) ? BME68X_EMU_GAS_MEASURING : 0);
+            return;
+        }
+
+        /* The sensor goes back to sleep once the forced mode measurement is complete */
+        bme68x_emu_store_field(emu, 0, nb_conv);
+        emu->regs[BME68X_EMU_REG_CTRL_MEAS] &= (uint8_t)~BME68X_EMU_MODE_MSK;
+    } else if (mode == BME68X_EMU_MODE_PARALLEL) {
+        /* One field per heater profile step, written to the three data fields in turn */
+        while (now_us >= emu->meas_end) {
+            bme68x_emu_store_field(emu, emu->meas_index % BME68X_EMU_N_FIELDS, emu->gas_index);
+            emu->gas_index = (uint8_t)((emu->gas_index + 1) % (nb_conv > 0 ? nb_conv : 1));
+            emu->meas_end += bme68x_emu_step_dur(emu);
+        }
+    }
+}
+
+/*!
+ * @brief       Register addressed by a bus transfer, resolving the SPI memory page
+ *
+ * @param[in]   emu                 emulated sensor
+ * @param[in]   reg_addr            address sent on the bus
+ *
+ * @return      address of the register in the register file
+ */
+static uint8_t bme68x_emu_reg(const bme68x_emu_t *emu, uint8_t reg_addr) {
+    if (!emu->spi) {
+        return reg_addr;
+    }
+
+    /* The status register holding the page bit is reachable from both pages */
+    reg_addr &= (uint8_t)~BME68X_EMU_SPI_RD;
+    if (reg_addr == BME68X_EMU_REG_STATUS || (emu->regs[BME68X_EMU_REG_STATUS] & BME68X_EMU_SPI_MEM_PAGE)) {
+        return reg_addr;
+    }
+
+    return reg_addr | 0x80;
+}
+
+/*!
+ * @brief       Apply a write to a register
+ *
+ * @param[in]   emu                 emulated sensor
+ * @param[in]   reg_addr            address of the register
+ * @param[in]   value               value written
+ *
+ * @return      none
+ */
+static void bme68x_emu_write_reg(bme68x_emu_t *emu, uint8_t reg_addr, uint8_t value) {
+    int64_t now_us = emu->clock();
+    uint32_t heatr_dur;
+
+    switch (reg_addr) {
+    case BME68X_EMU_REG_SOFT_RESET:
+        /* Soft reset clears the control and data registers, the calibration is kept */
+        if (value == 0xB6) {
+            memset(&emu->regs[BME68X_EMU_REG_FIELD0], 0, BME68X_EMU_REG_CTRL_MEAS + 2 - BME68X_EMU_REG_FIELD0);
+        }
+        return;
+    case BME68X_EMU_REG_CHIP_ID:
+    case BME68X_EMU_REG_VARIANT_ID:
+        return;
+    case BME68X_EMU_REG_CTRL_MEAS:
+        emu->regs[reg_addr] = value;
+        if ((value & BME68X_EMU_MODE_MSK) == BME68X_EMU_MODE_FORCED) {
+            heatr_dur = bme68x_emu_run_gas(emu) ?
+                        bme68x_emu_heatr_dur(emu->regs[BME68X_EMU_REG_GAS_WAIT0 + (emu->regs[BME68X_EMU_REG_CTRL_GAS_1] &
+                                                                                  0x0F)], 1000) : 0;
+            emu->meas_end = now_us + bme68x_emu_tph_dur(emu, 0) + heatr_dur + emu->meas_extra_us;
+            emu->heater_on_us += heatr_dur;
+        } else if ((value & BME68X_EMU_MODE_MSK) == BME68X_EMU_MODE_PARALLEL) {
+            emu->gas_index = 0;
+            emu->meas_end = now_us + bme68x_emu_step_dur(emu);
+        }
+        return;
+    default:
+        emu->regs[reg_addr] = value;
+        return;
+    }
+}
+
+/*!
+ * @brief       Initialize an emulated sensor with a fixed calibration and plausible indoor ADC values
+ *
+ * @param[out]  emu                 emulated sensor to initialize
+ * @param[in]   variant_id          BME68X_EMU_VARIANT_BME680 or BME68X_EMU_VARIANT_BME688
+ * @param[in]   clock               clock the measurements are timed with
+ *
+ * @return      none
+ */
+void bme68x_emu_init(bme68x_emu_t *emu, uint8_t variant_id, bme68x_emu_clock_fct clock) {
+    memset(emu, 0, sizeof(*emu));
+    emu->clock = clock;
+    emu->regs[BME68X_EMU_REG_CHIP_ID] = 0x61;
+    emu->regs[BME68X_EMU_REG_VARIANT_ID] = variant_id;
+
+    /* Temperature calibration */
+    bme68x_emu_set_calib16(emu, 0xE9, 26000);
+    bme68x_emu_set_calib16(emu, 0x8A, 26200);
+    emu->regs[0x8C] = 3;
+
+    /* Pressure calibration */
+    bme68x_emu_set_calib16(emu, 0x8E, 36000);
+    bme68x_emu_set_calib16(emu, 0x90, -10300);
+    emu->regs[0x92] = 88;
+    bme68x_emu_set_calib16(emu, 0x94, 6600);
+    bme68x_emu_set_calib16(emu, 0x96, -140);
+    emu->regs[0x98] = 44;
+    emu->regs[0x99] = 30;
+    bme68x_emu_set_calib16(emu, 0x9C, -2000);
+    bme68x_emu_set_calib16(emu, 0x9E, -3000);
+    emu->regs[0xA0] = 30;
+
+    /* Humidity calibration, par_h1 and par_h2 share a register */
+    emu->regs[0xE1] = (uint8_t)(1000 >> 4);
+    emu->regs[0xE2] = (uint8_t)(((1000 & 0x0F) << 4) | (770 & 0x0F));
+    emu->regs[0xE3] = (uint8_t)(770 >> 4);
+    emu->regs[0xE4] = 0;
+    emu->regs[0xE5] = 45;
+    emu->regs[0xE6] = 20;
+    emu->regs[0xE7] = 120;
+    emu->regs[0xE8] = (uint8_t)-100;
+
+    /* Gas heater calibration */
+    emu->regs[0xED] = (uint8_t)-30;
+    bme68x_emu_set_calib16(emu, 0xEB, -12000);
+    emu->regs[0xEE] = 18;
+    emu->regs[0x00] = 40;
+    emu->regs[0x02] = 0x10;
+    emu->regs[0x04] = 0x00;
+
+    /* About 25 degC, 1000 hPa, 45 %rH and 235 kOhm with the calibration above */
+    bme68x_emu_set_adc(emu, 496032, 366689, 21230, 600, 8);
+}
+
+/*!
+ * @brief       Put an emulated sensor on SPI
+ *
+ * @param[in]   emu                 emulated sensor
+ *
+ * @return      none
+ */
+void bme68x_emu_set_spi(bme68x_emu_t *emu) {
+    emu->spi = 1;
+}
+
+/*!
+ * @brief       Set the raw ADC values returned by the next measurements
+ *
+ * @param[in]   emu                 emulated sensor
+ * @param[in]   temp_adc            raw temperature (20 bits)
+ * @param[in]   pres_adc            raw pressure (20 bits)
+ * @param[in]   hum_adc             raw humidity (16 bits)
+ * @param[in]   gas_adc             raw gas resistance (10 bits)
+ * @param[in]   gas_range           gas range (4 bits)
+ *
+ * @return      none
+ */
+void bme68x_emu_set_adc(bme68x_emu_t *emu, uint32_t temp_adc, uint32_t pres_adc, uint16_t hum_adc, uint16_t gas_adc,
+                        uint8_t gas_range) {
+    emu->temp_adc = temp_adc;
+    emu->pres_adc = pres_adc;
+    emu->hum_adc = hum_adc;
+    emu->gas_adc = gas_adc;
+    emu->gas_range = gas_range;
+}
+
+/*!
+ * @brief       Bus read function of the emulated sensor, reading consecutive registers
+ *
+ * @param[in]   reg_addr            address of the first register
+ * @param[out]  reg_data            register values
+ * @param[in]   length              number of registers
+ * @param[in]   intf_ptr            emulated sensor
+ *
+ * @return      zero
+ */
+int8_t bme68x_emu_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t length, void *intf_ptr) {
+    bme68x_emu_t *emu = intf_ptr;
+    uint32_t i;
+    uint8_t addr;
+    uint8_t field;
+
+    bme68x_emu_update(emu);
+    emu->n_reads++;
+    emu->n_bytes_read += length;
+
+    for (i = 0; i < length; i++) {
+        addr = bme68x_emu_reg(emu, (uint8_t)(reg_addr + i));
+        reg_data[i] = emu->regs[addr];
+
+        /* Reading the status of a data field acknowledges its new data */
+        for (field = 0; field < BME68X_EMU_N_FIELDS; field++) {
+            if (addr == BME68X_EMU_REG_FIELD0 + field * BME68X_EMU_FIELD_LEN) {
+                emu->regs[addr] &= (uint8_t)~BME68X_EMU_NEW_DATA;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       Bus write function of the emulated sensor, taking burst writes of address and value pairs
+ *
+ * @param[in]   reg_addr            address of the first register
+ * @param[in]   reg_data            value of the first register, followed by address and value pairs
+ * @param[in]   length              number of bytes in reg_data
+ * @param[in]   intf_ptr            emulated sensor
+ *
+ * @return      zero
+ */
+int8_t bme68x_emu_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t length, void *intf_ptr) {
+    bme68x_emu_t *emu = intf_ptr;
+    uint32_t i;
+
+    bme68x_emu_update(emu);
+    emu->n_writes++;
+    emu->n_bytes_written += length;
+
+    if (length == 0) {
+        return 0;
+    }
+    bme68x_emu_write_reg(emu, bme68x_emu_reg(emu, reg_addr), reg_data[0]);
+    for (i = 1; i + 1 < length; i += 2) {
+        bme68x_emu_write_reg(emu, bme68x_emu_reg(emu, reg_data[i]), reg_data[i + 1]);
+    }
+
+    return 0;
+}
+
+/*! @}*/
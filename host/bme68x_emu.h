@@ -0,0 +1,153 @@
+/*!
+ * @file bme68x_emu.h
+ *
+ * @brief
+ * Register-level BME68X emulator behind the bus functions of the sensor API, for host builds
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __BME68X_EMU_H__
+#define __BME68X_EMU_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Variant identifiers as read from the variant id register */
+#define BME68X_EMU_VARIANT_BME680 UINT8_C(0x00)
+#define BME68X_EMU_VARIANT_BME688 UINT8_C(0x01)
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to the clock the emulated measurements are timed with */
+typedef int64_t (*bme68x_emu_clock_fct)(void);
+
+/* Structure holding the state of one emulated sensor. Hand a pointer to it as interface pointer of the bus
+ * functions. */
+typedef struct {
+	/*! Register file, indexed by register address */
+	uint8_t regs[256];
+	/*! Set when the sensor is on SPI, where the registers are addressed through two memory pages */
+	uint8_t spi;
+	/*! Clock the measurements are timed with */
+	bme68x_emu_clock_fct clock;
+	/*! Time (in microseconds) at which the running forced mode measurement, or the next parallel mode field, ends */
+	int64_t meas_end;
+	/*! Extra time (in microseconds) every measurement takes over the nominal duration */
+	uint32_t meas_extra_us;
+	/*! Index of the next measurement */
+	uint8_t meas_index;
+	/*! Heater profile step of the next parallel mode field */
+	uint8_t gas_index;
+	/*! Raw temperature ADC value of the measurements */
+	uint32_t temp_adc;
+	/*! Raw pressure ADC value of the measurements */
+	uint32_t pres_adc;
+	/*! Raw humidity ADC value of the measurements */
+	uint16_t hum_adc;
+	/*! Raw gas ADC value of the measurements */
+	uint16_t gas_adc;
+	/*! Gas range of the measurements */
+	uint8_t gas_range;
+	/*! Number of read transfers */
+	uint32_t n_reads;
+	/*! Number of write transfers */
+	uint32_t n_writes;
+	/*! Number of bytes read */
+	uint32_t n_bytes_read;
+	/*! Number of bytes written */
+	uint32_t n_bytes_written;
+	/*! Number of measurements completed */
+	uint32_t n_measurements;
+	/*! Time (in microseconds) the heater was on */
+	int64_t heater_on_us;
+} bme68x_emu_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an emulated sensor with a fixed calibration and plausible indoor ADC values
+ *
+ * @param[out]  emu                 emulated sensor to initialize
+ * @param[in]   variant_id          BME68X_EMU_VARIANT_BME680 or BME68X_EMU_VARIANT_BME688
+ * @param[in]   clock               clock the measurements are timed with
+ *
+ * @return      none
+ */
+void bme68x_emu_init(bme68x_emu_t *emu, uint8_t variant_id, bme68x_emu_clock_fct clock);
+
+/*!
+ * @brief       Put an emulated sensor on SPI: addresses are 7 bits within the memory page selected by the status
+ *              register, with the read bit set on reads
+ *
+ * @param[in]   emu                 emulated sensor
+ *
+ * @return      none
+ */
+void bme68x_emu_set_spi(bme68x_emu_t *emu);
+
+/*!
+ * @brief       Set the raw ADC values returned by the next measurements
+ *
+ * @param[in]   emu                 emulated sensor
+ * @param[in]   temp_adc            raw temperature (20 bits)
+ * @param[in]   pres_adc            raw pressure (20 bits)
+ * @param[in]   hum_adc             raw humidity (16 bits)
+ * @param[in]   gas_adc             raw gas resistance (10 bits)
+ * @param[in]   gas_range           gas range (4 bits)
+ *
+ * @return      none
+ */
+void bme68x_emu_set_adc(bme68x_emu_t *emu, uint32_t temp_adc, uint32_t pres_adc, uint16_t hum_adc, uint16_t gas_adc,
+                        uint8_t gas_range);
+
+/*!
+ * @brief       Bus read function of the emulated sensor, reading consecutive registers
+ *
+ * @param[in]   reg_addr            address of the first register
+ * @param[out]  reg_data            register values
+ * @param[in]   length              number of registers
+ * @param[in]   intf_ptr            emulated sensor
+ *
+ * @return      zero
+ */
+int8_t bme68x_emu_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t length, void *intf_ptr);
+
+/*!
+ * @brief       Bus write function of the emulated sensor, taking burst writes of address and value pairs
+ *
+ * @param[in]   reg_addr            address of the first register
+ * @param[in]   reg_data            value of the first register, followed by address and value pairs
+ * @param[in]   length              number of bytes in reg_data
+ * @param[in]   intf_ptr            emulated sensor
+ *
+ * @return      zero
+ */
+int8_t bme68x_emu_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t length, void *intf_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BME68X_EMU_H__ */
+
+/*! @}*/
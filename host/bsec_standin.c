@@ -0,0 +1,384 @@
+/*!
+ * @file bsec_standin.c
+ *
+ * @brief
+ * Stand-in for the multi-instance BSEC API in host builds without the Linux build of the BSEC library. It follows the
+ * sampling schedule of BSEC (LP, ULP, on-demand and gas scanning) and returns outputs of plausible magnitude derived
+ * from the inputs, but does not implement the BSEC algorithms.
+ */
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bme68x_defs.h"
+#include "bsec_interface.h"
+#include "bsec_datatypes.h"
+
+/**********************************************************************************************************************/
+/* local macro definitions */
+/**********************************************************************************************************************/
+
+/* Tolerance (in nanoseconds) on the time bsec_sensor_control() is called at */
+#define BSEC_STANDIN_TOLERANCE_NS INT64_C(50000000)
+
+/* Heater settings of the forced mode samples, in degrees Celsius and milliseconds */
+#define BSEC_STANDIN_HEATER_TEMP    UINT16_C(320)
+#define BSEC_STANDIN_HEATER_DUR_LP  UINT16_C(197)
+#define BSEC_STANDIN_HEATER_DUR_ULP UINT16_C(1943)
+
+/* Marker at the start of a serialized state */
+#define BSEC_STANDIN_STATE_MAGIC    UINT32_C(0x53544E44)
+
+/**********************************************************************************************************************/
+/* local type definitions */
+/**********************************************************************************************************************/
+
+/* Structure held in the instance memory */
+typedef struct {
+	/*! Bit mask of the subscribed outputs, indexed by sensor identifier */
+	uint32_t subscribed;
+	/*! Sample rate of the subscribed outputs */
+	float sample_rate;
+	/*! Set when a ULP measurement on demand is requested */
+	uint8_t on_demand;
+	/*! Time (in nanoseconds) of the next sample, zero to sample at the next call */
+	int64_t next_call;
+	/*! Number of samples processed */
+	uint32_t n_samples;
+	/*! Highest gas resistance seen, standing in for the clean-air baseline */
+	float gas_baseline;
+} bsec_standin_t;
+
+/* The instance memory has to be large enough for the stand-in */
+typedef char bsec_standin_fits[(sizeof(bsec_standin_t) <= BSEC_INSTANCE_SIZE) ? 1 : -1];
+
+/* Structure of a serialized state */
+typedef struct {
+	uint32_t magic;
+	uint32_t n_samples;
+	float gas_baseline;
+} bsec_standin_state_t;
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Append an output if it is subscribed and there is room left
+ *
+ * @param[in]   standin             stand-in instance
+ * @param[out]  outputs             outputs
+ * @param[in]   n_max               size of outputs
+ * @param[in,out] n_outputs         number of outputs so far
+ * @param[in]   sensor_id           virtual sensor identifier
+ * @param[in]   signal              value of the output
+ * @param[in]   accuracy            accuracy of the output
+ * @param[in]   time_stamp          time stamp of the output
+ *
+ * @return      none
+ */
+static void bsec_standin_output(const bsec_standin_t *standin, bsec_output_t *outputs, uint8_t n_max,
+                                uint8_t *n_outputs, uint8_t sensor_id, float signal, uint8_t accuracy,
+                                int64_t time_stamp) {
+    if (!(standin->subscribed & (UINT32_C(1) << sensor_id)) || *n_outputs >= n_max) {
+        return;
+    }
+
+    outputs[*n_outputs].time_stamp = time_stamp;
+    outputs[*n_outputs].signal = signal;
+    outputs[*n_outputs].signal_dimensions = 1;
+    outputs[*n_outputs].sensor_id = sensor_id;
+    outputs[*n_outputs].accuracy = accuracy;
+    (*n_outputs)++;
+}
+
+uint32_t bsec_get_instance_size_m(void) {
+    return BSEC_INSTANCE_SIZE;
+}
+
+bsec_library_return_t bsec_get_version_m(void *inst, bsec_version_t *bsec_version_p) {
+    (void)inst;
+    memset(bsec_version_p, 0, sizeof(*bsec_version_p));
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_init_m(void *inst) {
+    memset(inst, 0, sizeof(bsec_standin_t));
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_update_subscription_m(void *inst,
+                                                 const bsec_sensor_configuration_t *const requested_virtual_sensors,
+                                                 const uint8_t n_requested_virtual_sensors,
+                                                 bsec_sensor_configuration_t *required_sensor_settings,
+                                                 uint8_t *n_required_sensor_settings) {
+    bsec_standin_t *standin = inst;
+    float sample_rate = BSEC_SAMPLE_RATE_DISABLED;
+    float rate;
+    uint8_t i;
+
+    (void)required_sensor_settings;
+
+    for (i = 0; i < n_requested_virtual_sensors; i++) {
+        rate = requested_virtual_sensors[i].sample_rate;
+        if (requested_virtual_sensors[i].sensor_id >= 32) {
+            return BSEC_E_SU_WRONGDATARATE;
+        }
+        if (rate == BSEC_SAMPLE_RATE_ULP_MEASUREMENT_ON_DEMAND) {
+            if (standin->sample_rate != BSEC_SAMPLE_RATE_ULP) {
+                return BSEC_E_SU_SAMPLERATELIMITS;
+            }
+            standin->on_demand = 1;
+            continue;
+        }
+        if (rate != BSEC_SAMPLE_RATE_DISABLED && rate != BSEC_SAMPLE_RATE_ULP && rate != BSEC_SAMPLE_RATE_LP &&
+            rate != BSEC_SAMPLE_RATE_CONT && rate != BSEC_SAMPLE_RATE_SCAN) {
+            return BSEC_E_SU_SAMPLERATELIMITS;
+        }
+        if (rate == BSEC_SAMPLE_RATE_DISABLED) {
+            standin->subscribed &= ~(UINT32_C(1) << requested_virtual_sensors[i].sensor_id);
+        } else {
+            standin->subscribed |= UINT32_C(1) << requested_virtual_sensors[i].sensor_id;
+            sample_rate = rate;
+        }
+    }
+
+    /* A new sample rate restarts the schedule from the next call */
+    if (sample_rate != BSEC_SAMPLE_RATE_DISABLED && sample_rate != standin->sample_rate) {
+        standin->sample_rate = sample_rate;
+        standin->next_call = 0;
+    }
+    *n_required_sensor_settings = 0;
+
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_sensor_control_m(void *inst, const int64_t time_stamp, bsec_bme_settings_t *sensor_settings) {
+    /* Heater profile of the gas scanning mode, durations in multiples of the parallel mode step */
+    static const uint16_t scan_temp[10] = {320, 100, 100, 100, 200, 200, 200, 320, 320, 320};
+    static const uint16_t scan_dur[10] = {5, 2, 10, 30, 5, 5, 5, 5, 5, 5};
+    bsec_standin_t *standin = inst;
+    bsec_library_return_t status = BSEC_OK;
+    int64_t period;
+
+    memset(sensor_settings, 0, sizeof(*sensor_settings));
+    if (standin->sample_rate == BSEC_SAMPLE_RATE_DISABLED || standin->sample_rate <= 0.0f) {
+        sensor_settings->next_call = time_stamp + INT64_C(1000000000);
+        return BSEC_OK;
+    }
+    period = (int64_t)(1e9 / standin->sample_rate);
+    if (standin->sample_rate == BSEC_SAMPLE_RATE_SCAN) {
+        /* The fields of a scan are collected every few seconds */
+        period = INT64_C(3000000000);
+    }
+
+    if (standin->next_call == 0 || standin->on_demand) {
+        standin->next_call = time_stamp;
+        standin->on_demand = 0;
+    }
+
+    if (time_stamp + BSEC_STANDIN_TOLERANCE_NS < standin->next_call) {
+        /* Too early, nothing to do */
+        sensor_settings->next_call = standin->next_call;
+        if (standin->sample_rate == BSEC_SAMPLE_RATE_SCAN) {
+            sensor_settings->op_mode = BME68X_PARALLEL_MODE;
+        }
+        return BSEC_OK;
+    }
+    if (time_stamp > standin->next_call + period / 2) {
+        status = BSEC_W_SC_CALL_TIMING_VIOLATION;
+    }
+    while (standin->next_call <= time_stamp + BSEC_STANDIN_TOLERANCE_NS) {
+        standin->next_call += period;
+    }
+
+    sensor_settings->next_call = standin->next_call;
+    sensor_settings->trigger_measurement = 1;
+    sensor_settings->run_gas = 1;
+    sensor_settings->temperature_oversampling = BME68X_OS_2X;
+    sensor_settings->pressure_oversampling = BME68X_OS_16X;
+    sensor_settings->humidity_oversampling = BME68X_OS_1X;
+    sensor_settings->process_data = BSEC_PROCESS_TEMPERATURE | BSEC_PROCESS_PRESSURE | BSEC_PROCESS_HUMIDITY |
+                                    BSEC_PROCESS_GAS;
+
+    if (standin->sample_rate == BSEC_SAMPLE_RATE_SCAN) {
+        sensor_settings->op_mode = BME68X_PARALLEL_MODE;
+        sensor_settings->process_data |= BSEC_PROCESS_PROFILE_PART;
+        memcpy(sensor_settings->heater_temperature_profile, scan_temp, sizeof(scan_temp));
+        memcpy(sensor_settings->heater_duration_profile, scan_dur, sizeof(scan_dur));
+        sensor_settings->heater_profile_len = 10;
+    } else {
+        sensor_settings->op_mode = BME68X_FORCED_MODE;
+        sensor_settings->heater_temperature = BSEC_STANDIN_HEATER_TEMP;
+        sensor_settings->heater_duration = (standin->sample_rate == BSEC_SAMPLE_RATE_ULP) ?
+                                           BSEC_STANDIN_HEATER_DUR_ULP : BSEC_STANDIN_HEATER_DUR_LP;
+    }
+
+    return status;
+}
+
+bsec_library_return_t bsec_do_steps_m(void *inst, const bsec_input_t *const inputs, const uint8_t n_inputs,
+                                      bsec_output_t *outputs, uint8_t *n_outputs) {
+    bsec_standin_t *standin = inst;
+    uint8_t n_max = *n_outputs;
+    float temperature = NAN, pressure = NAN, humidity = NAN, gas = NAN, heatsource = 0.0f, profile_part = 0.0f;
+    float iaq;
+    int64_t time_stamp = 0;
+    uint8_t accuracy;
+    uint8_t i;
+
+    *n_outputs = 0;
+    for (i = 0; i < n_inputs; i++) {
+        time_stamp = inputs[i].time_stamp;
+        switch (inputs[i].sensor_id) {
+        case BSEC_INPUT_TEMPERATURE:
+            temperature = inputs[i].signal;
+            break;
+        case BSEC_INPUT_PRESSURE:
+            pressure = inputs[i].signal;
+            break;
+        case BSEC_INPUT_HUMIDITY:
+            humidity = inputs[i].signal;
+            break;
+        case BSEC_INPUT_GASRESISTOR:
+            gas = inputs[i].signal;
+            break;
+        case BSEC_INPUT_HEATSOURCE:
+            heatsource = inputs[i].signal;
+            break;
+        case BSEC_INPUT_PROFILE_PART:
+            profile_part = inputs[i].signal;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!isnan(temperature)) {
+        bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_RAW_TEMPERATURE, temperature, 0,
+                            time_stamp);
+        bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE,
+                            temperature - heatsource, 0, time_stamp);
+    }
+    if (!isnan(pressure)) {
+        bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_RAW_PRESSURE, pressure, 0, time_stamp);
+    }
+    if (!isnan(humidity)) {
+        bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_RAW_HUMIDITY, humidity, 0, time_stamp);
+        bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY,
+                            humidity, 0, time_stamp);
+    }
+    if (isnan(gas) || gas <= 0.0f) {
+        return BSEC_OK;
+    }
+
+    /* The IAQ rises as the gas resistance falls below the highest one seen, the accuracy grows with the samples */
+    standin->n_samples++;
+    if (gas > standin->gas_baseline) {
+        standin->gas_baseline = gas;
+    }
+    iaq = 25.0f + 475.0f * (1.0f - gas / standin->gas_baseline);
+    accuracy = (standin->n_samples < 10) ? 0 : (standin->n_samples < 100) ? 1 : (standin->n_samples < 1000) ? 2 : 3;
+
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_RAW_GAS, gas, 0, time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_IAQ, iaq, accuracy, time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_STATIC_IAQ, iaq, accuracy, time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_CO2_EQUIVALENT, 500.0f + 10.0f * iaq,
+                        accuracy, time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_BREATH_VOC_EQUIVALENT, 0.5f + iaq / 50.0f,
+                        accuracy, time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_COMPENSATED_GAS, logf(gas), accuracy,
+                        time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_GAS_PERCENTAGE,
+                        100.0f * gas / standin->gas_baseline, accuracy, time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_STABILIZATION_STATUS,
+                        standin->n_samples >= 10 ? 1.0f : 0.0f, 0, time_stamp);
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_RUN_IN_STATUS,
+                        standin->n_samples >= 100 ? 1.0f : 0.0f, 0, time_stamp);
+    for (i = 0; i < 4; i++) {
+        bsec_standin_output(standin, outputs, n_max, n_outputs, (uint8_t)(BSEC_OUTPUT_GAS_ESTIMATE_1 + i), 25.0f,
+                            accuracy, time_stamp);
+    }
+    bsec_standin_output(standin, outputs, n_max, n_outputs, BSEC_OUTPUT_RAW_GAS_INDEX, profile_part, 0, time_stamp);
+
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_reset_output_m(void *inst, uint8_t sensor_id) {
+    (void)inst;
+    (void)sensor_id;
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_configuration_m(void *inst, const uint8_t *const serialized_settings,
+                                               const uint32_t n_serialized_settings, uint8_t *work_buffer,
+                                               const uint32_t n_work_buffer_size) {
+    (void)inst;
+    (void)serialized_settings;
+    (void)n_serialized_settings;
+    (void)work_buffer;
+    (void)n_work_buffer_size;
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_configuration_m(void *inst, const uint8_t config_id, uint8_t *serialized_settings,
+                                               const uint32_t n_serialized_settings_max, uint8_t *work_buffer,
+                                               const uint32_t n_work_buffer, uint32_t *n_serialized_settings) {
+    (void)inst;
+    (void)config_id;
+    (void)serialized_settings;
+    (void)n_serialized_settings_max;
+    (void)work_buffer;
+    (void)n_work_buffer;
+    *n_serialized_settings = 0;
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_state_m(void *inst, const uint8_t *const serialized_state,
+                                       const uint32_t n_serialized_state, uint8_t *work_buffer,
+                                       const uint32_t n_work_buffer_size) {
+    bsec_standin_t *standin = inst;
+    bsec_standin_state_t state;
+
+    (void)work_buffer;
+    (void)n_work_buffer_size;
+
+    if (n_serialized_state < sizeof(state)) {
+        return BSEC_E_CONFIG_INVALIDSTRINGSIZE;
+    }
+    memcpy(&state, serialized_state, sizeof(state));
+    if (state.magic != BSEC_STANDIN_STATE_MAGIC) {
+        return BSEC_E_CONFIG_CRCMISMATCH;
+    }
+    standin->n_samples = state.n_samples;
+    standin->gas_baseline = state.gas_baseline;
+
+    return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_state_m(void *inst, const uint8_t state_set_id, uint8_t *serialized_state,
+                                       const uint32_t n_serialized_state_max, uint8_t *work_buffer,
+                                       const uint32_t n_work_buffer, uint32_t *n_serialized_state) {
+    bsec_standin_t *standin = inst;
+    bsec_standin_state_t state;
+
+    (void)state_set_id;
+    (void)work_buffer;
+    (void)n_work_buffer;
+
+    if (n_serialized_state_max < sizeof(state)) {
+        return BSEC_E_CONFIG_INSUFFICIENTBUFFER;
+    }
+    state.magic = BSEC_STANDIN_STATE_MAGIC;
+    state.n_samples = standin->n_samples;
+    state.gas_baseline = standin->gas_baseline;
+    memcpy(serialized_state, &state, sizeof(state));
+    *n_serialized_state = sizeof(state);
+
+    return BSEC_OK;
+}
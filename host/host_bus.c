@@ -0,0 +1,109 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "host_bus.h"
+#include "host_clock.h"
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an idle simulated bus
+ *
+ * @param[out]  bus                 simulated bus to initialize
+ * @param[in]   setup_us            duration (in microseconds) of the start of a transfer
+ * @param[in]   byte_us             duration (in microseconds) of each byte transferred
+ * @param[in]   completions         completion queue the ends of the reads are reported to
+ *
+ * @return      none
+ */
+void host_bus_init(host_bus_t *bus, uint32_t setup_us, uint32_t byte_us, bsec_iot_bus_t *completions) {
+    memset(bus, 0, sizeof(*bus));
+    bus->setup_us = setup_us;
+    bus->byte_us = byte_us;
+    bus->completions = completions;
+}
+
+/*!
+ * @brief       Queue a read behind the ones already on the bus
+ *
+ * @param[in]   read_async_arg      simulated bus
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   reg_addr            register address
+ * @param[out]  reg_data            buffer receiving the register data
+ * @param[in]   length              number of bytes to read
+ *
+ * @return      BME68X_INTF_RET_SUCCESS if the read was queued, BME68X_E_COM_FAIL if the queue is full
+ */
+BME68X_INTF_RET_TYPE host_bus_read_async(void *read_async_arg, bsec_iot_ctx_t *ctx, uint8_t reg_addr,
+                                         uint8_t *reg_data, uint32_t length) {
+    host_bus_t *bus = (host_bus_t *)read_async_arg;
+    host_bus_transfer_t *transfer;
+    int64_t duration = bus->setup_us + (int64_t)length * bus->byte_us;
+
+    if (bus->n_transfers >= HOST_BUS_MAX_TRANSFERS) {
+        return BME68X_E_COM_FAIL;
+    }
+
+    /* The transfer starts once the bus is free */
+    if (bus->free_us < host_clock_now_us()) {
+        bus->free_us = host_clock_now_us();
+    }
+    bus->free_us += duration;
+    bus->busy_us += duration;
+
+    transfer = &bus->transfers[bus->n_transfers++];
+    transfer->ctx = ctx;
+    transfer->reg_addr = reg_addr;
+    transfer->reg_data = reg_data;
+    transfer->length = length;
+    transfer->done_us = bus->free_us;
+
+    return BME68X_INTF_RET_SUCCESS;
+}
+
+/*!
+ * @brief       End the reads whose transfer is over on the virtual clock
+ *
+ * @param[in]   bus                 simulated bus
+ *
+ * @return      number of reads ended
+ */
+uint32_t host_bus_poll(host_bus_t *bus) {
+    const host_bus_transfer_t *transfer;
+    BME68X_INTF_RET_TYPE rslt;
+    uint32_t n_done = 0;
+
+    /* The transfers end in the order they were queued */
+    while (n_done < bus->n_transfers && bus->transfers[n_done].done_us <= host_clock_now_us()) {
+        transfer = &bus->transfers[n_done];
+        rslt = transfer->ctx->bus_read(transfer->reg_addr, transfer->reg_data, transfer->length,
+                                       transfer->ctx->intf_ptr);
+        bsec_iot_bus_complete(bus->completions, transfer->ctx, rslt);
+        n_done++;
+    }
+
+    bus->n_transfers -= (uint8_t)n_done;
+    memmove(bus->transfers, &bus->transfers[n_done], bus->n_transfers * sizeof(host_bus_transfer_t));
+    bus->n_reads += n_done;
+
+    return n_done;
+}
+
+/*!
+ * @brief       Time at which the next transfer ends
+ *
+ * @param[in]   bus                 simulated bus
+ *
+ * @return      time in microseconds, INT64_MAX if no read is queued
+ */
+int64_t host_bus_next_us(const host_bus_t *bus) {
+    return (bus->n_transfers > 0) ? bus->transfers[0].done_us : INT64_MAX;
+}
+
+/*! @}*/
@@ -0,0 +1,130 @@
+/*!
+ * @file host_bus.h
+ *
+ * @brief
+ * Simulated bus doing the asynchronous reads of the sensors on the virtual clock, one transfer after the other
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __HOST_BUS_H__
+#define __HOST_BUS_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+
+#include "bsec_bus.h"
+
+/**********************************************************************************************************************/
+/* macro definitions */
+/**********************************************************************************************************************/
+
+/* Number of reads the simulated bus can have queued */
+#define HOST_BUS_MAX_TRANSFERS 8
+
+/**********************************************************************************************************************/
+/* type definitions */
+/**********************************************************************************************************************/
+
+/* Structure with one queued read */
+typedef struct {
+	/*! Context of the sensor read */
+	bsec_iot_ctx_t *ctx;
+	/*! Register address */
+	uint8_t reg_addr;
+	/*! Buffer receiving the register data */
+	uint8_t *reg_data;
+	/*! Number of bytes to read */
+	uint32_t length;
+	/*! Time (in microseconds) at which the transfer ends */
+	int64_t done_us;
+} host_bus_transfer_t;
+
+/* Structure holding the simulated bus */
+typedef struct {
+	/*! Queued reads, in the order they are done */
+	host_bus_transfer_t transfers[HOST_BUS_MAX_TRANSFERS];
+	/*! Number of queued reads */
+	uint8_t n_transfers;
+	/*! Duration (in microseconds) of the start of a transfer, e.g. the start condition and the addresses on I2C */
+	uint32_t setup_us;
+	/*! Duration (in microseconds) of each byte transferred */
+	uint32_t byte_us;
+	/*! Time (in microseconds) at which the bus is free again */
+	int64_t free_us;
+	/*! Completion queue the ends of the reads are reported to, as the interrupt of a real bus would */
+	bsec_iot_bus_t *completions;
+	/*! Number of reads done */
+	uint32_t n_reads;
+	/*! Time (in microseconds) the bus spent transferring */
+	int64_t busy_us;
+} host_bus_t;
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Initialize an idle simulated bus
+ *
+ * @param[out]  bus                 simulated bus to initialize
+ * @param[in]   setup_us            duration (in microseconds) of the start of a transfer
+ * @param[in]   byte_us             duration (in microseconds) of each byte transferred
+ * @param[in]   completions         completion queue the ends of the reads are reported to
+ *
+ * @return      none
+ */
+void host_bus_init(host_bus_t *bus, uint32_t setup_us, uint32_t byte_us, bsec_iot_bus_t *completions);
+
+/*!
+ * @brief       Queue a read, matches bus_read_async_fct with the simulated bus as read_async_arg
+ *
+ * The registers are read through the blocking bus_read function of the sensor once the transfer ends.
+ *
+ * @param[in]   read_async_arg      simulated bus
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   reg_addr            register address
+ * @param[out]  reg_data            buffer receiving the register data
+ * @param[in]   length              number of bytes to read
+ *
+ * @return      BME68X_INTF_RET_SUCCESS if the read was queued, BME68X_E_COM_FAIL if the queue is full
+ */
+BME68X_INTF_RET_TYPE host_bus_read_async(void *read_async_arg, bsec_iot_ctx_t *ctx, uint8_t reg_addr,
+                                         uint8_t *reg_data, uint32_t length);
+
+/*!
+ * @brief       End the reads whose transfer is over on the virtual clock
+ *
+ * @param[in]   bus                 simulated bus
+ *
+ * @return      number of reads ended
+ */
+uint32_t host_bus_poll(host_bus_t *bus);
+
+/*!
+ * @brief       Time at which the next transfer ends
+ *
+ * @param[in]   bus                 simulated bus
+ *
+ * @return      time in microseconds, INT64_MAX if no read is queued
+ */
+int64_t host_bus_next_us(const host_bus_t *bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_BUS_H__ */
+
+/*! @}*/
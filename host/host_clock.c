@@ -0,0 +1,76 @@
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+
+#include "host_clock.h"
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+/* Current time of the virtual clock (in microseconds) */
+static int64_t host_clock_time_us;
+
+/* Total time spent in host_clock_sleep() (in microseconds) */
+static int64_t host_clock_sleep_us;
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Set the virtual clock back to zero
+ *
+ * @return      none
+ */
+void host_clock_reset(void) {
+    host_clock_time_us = 0;
+    host_clock_sleep_us = 0;
+}
+
+/*!
+ * @brief       Current time of the virtual clock
+ *
+ * @return      time in microseconds
+ */
+int64_t host_clock_now_us(void) {
+    return host_clock_time_us;
+}
+
+/*!
+ * @brief       Move the virtual clock forward
+ *
+ * @param[in]   period              time in microseconds
+ *
+ * @return      none
+ */
+void host_clock_advance(int64_t period) {
+    host_clock_time_us += period;
+}
+
+/*!
+ * @brief       Sleep on the virtual clock
+ *
+ * @param[in]   period              time in microseconds
+ * @param[in]   intf_ptr            unused
+ *
+ * @return      none
+ */
+void host_clock_sleep(uint32_t period, void *intf_ptr) {
+    (void)intf_ptr;
+    host_clock_time_us += period;
+    host_clock_sleep_us += period;
+}
+
+/*!
+ * @brief       Total time spent sleeping
+ *
+ * @return      time in microseconds
+ */
+int64_t host_clock_slept_us(void) {
+    return host_clock_sleep_us;
+}
+
+/*! @}*/
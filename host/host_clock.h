@@ -0,0 +1,77 @@
+/*!
+ * @file host_clock.h
+ *
+ * @brief
+ * Deterministic virtual clock standing in for the system timer and sleep functions in host builds
+ */
+
+/*!
+ * @addtogroup bsec_examples BSEC Examples
+ * @brief BSEC usage examples
+ * @{*/
+
+#ifndef __HOST_CLOCK_H__
+#define __HOST_CLOCK_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+
+/**********************************************************************************************************************/
+/* function declarations */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Set the virtual clock back to zero
+ *
+ * @return      none
+ */
+void host_clock_reset(void);
+
+/*!
+ * @brief       Current time of the virtual clock, matches get_timestamp_us_fct
+ *
+ * @return      time in microseconds
+ */
+int64_t host_clock_now_us(void);
+
+/*!
+ * @brief       Move the virtual clock forward
+ *
+ * @param[in]   period              time in microseconds
+ *
+ * @return      none
+ */
+void host_clock_advance(int64_t period);
+
+/*!
+ * @brief       Sleep on the virtual clock, matches bme68x_delay_us_fptr_t; returns at once with the clock moved forward
+ *
+ * @param[in]   period              time in microseconds
+ * @param[in]   intf_ptr            unused
+ *
+ * @return      none
+ */
+void host_clock_sleep(uint32_t period, void *intf_ptr);
+
+/*!
+ * @brief       Total time spent sleeping, i.e. time the processor could have been idle
+ *
+ * @return      time in microseconds
+ */
+int64_t host_clock_slept_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_CLOCK_H__ */
+
+/*! @}*/
@@ -0,0 +1,425 @@
+/*!
+ * @file main.c
+ *
+ * @brief
+ * Host demo running several emulated BME68X sensors through the scheduler on the virtual clock
+ */
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsec_scheduler.h"
+#include "bsec_trace.h"
+#include "bsec_history.h"
+#include "bsec_publish.h"
+#include "bsec_pipeline.h"
+#include "bsec_energy.h"
+#include "bme68x_emu.h"
+#include "host_bus.h"
+#include "host_clock.h"
+
+/**********************************************************************************************************************/
+/* local macro definitions */
+/**********************************************************************************************************************/
+
+#define HOST_MAX_SENSORS 8
+
+/* Memory and block size of the output history of each sensor */
+#define HOST_HISTORY_SIZE 16384
+#define HOST_HISTORY_BLOCK_SIZE 1024
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+static bsec_iot_ctx_t ctxs[HOST_MAX_SENSORS];
+static bme68x_emu_t emus[HOST_MAX_SENSORS];
+static uint8_t arena_mem[BSEC_IOT_ARENA_SIZE(HOST_MAX_SENSORS)] __attribute__((aligned(4)));
+static bsec_iot_arena_t arena;
+static bsec_iot_sched_t sched;
+static uint32_t n_outputs;
+static uint8_t verbose;
+static bsec_iot_trace_t trace;
+static bsec_iot_history_t histories[HOST_MAX_SENSORS];
+static uint8_t history_mem[HOST_MAX_SENSORS][HOST_HISTORY_SIZE] __attribute__((aligned(8)));
+static bsec_iot_publish_t publishes[HOST_MAX_SENSORS];
+static bsec_iot_pipeline_t pipeline;
+static bsec_iot_energy_t energies[HOST_MAX_SENSORS];
+static uint8_t retained[HOST_MAX_SENSORS][BSEC_IOT_RETAINED_SIZE] __attribute__((aligned(8)));
+static bsec_iot_bus_t bus_completions;
+static host_bus_t bus;
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Keep the outputs of a sensor in its history, charge the sample and print its IAQ outputs
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void output_ready(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    n_outputs++;
+    bsec_iot_history_append(&histories[ctx - ctxs], output);
+    bsec_iot_energy_update(&energies[ctx - ctxs], ctx, output->timestamp / 1000);
+    if (!verbose || !(output->valid_mask & BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_IAQ))) {
+        return;
+    }
+
+    printf("%10.3f s  sensor %d  IAQ %6.1f (%d)  T %5.2f degC  H %5.2f %%rH  P %7.2f hPa  G %8.0f Ohm\n",
+           output->timestamp / 1e9, (int)(ctx - ctxs), output->value[BSEC_IOT_OUTPUT_IAQ],
+           output->accuracy[BSEC_IOT_OUTPUT_IAQ], output->value[BSEC_IOT_OUTPUT_TEMPERATURE],
+           output->value[BSEC_IOT_OUTPUT_HUMIDITY], output->value[BSEC_IOT_OUTPUT_RAW_PRESSURE] / 100.0f,
+           output->value[BSEC_IOT_OUTPUT_RAW_GAS]);
+}
+
+/*!
+ * @brief       No state is kept between runs of the demo
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   state_buffer        buffer to hold the loaded state string
+ * @param[in]   n_buffer            size of the allocated state buffer
+ *
+ * @return      zero
+ */
+static uint32_t state_load(bsec_iot_ctx_t *ctx, uint8_t *state_buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)state_buffer;
+    (void)n_buffer;
+    return 0;
+}
+
+/*!
+ * @brief       Discard the state
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   state_buffer        buffer holding the state to be stored
+ * @param[in]   length              length of the state string
+ *
+ * @return      none
+ */
+static void state_save(bsec_iot_ctx_t *ctx, const uint8_t *state_buffer, uint32_t length) {
+    (void)ctx;
+    (void)state_buffer;
+    (void)length;
+}
+
+/*!
+ * @brief       Keep the default configuration of BSEC
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   config_buffer       buffer to hold the loaded config string
+ * @param[in]   n_buffer            size of the allocated config buffer
+ *
+ * @return      zero
+ */
+static uint32_t config_load(bsec_iot_ctx_t *ctx, uint8_t *config_buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)config_buffer;
+    (void)n_buffer;
+    return 0;
+}
+
+/*!
+ * @brief       Append to the trace file
+ *
+ * @param[in]   storage             trace file
+ * @param[in]   data                data to append
+ * @param[in]   length              length of the data
+ *
+ * @return      zero if successful, negative otherwise
+ */
+static int8_t trace_write(void *storage, const void *data, uint32_t length) {
+    return (fwrite(data, 1, length, (FILE *)storage) == length) ? 0 : -1;
+}
+
+/*!
+ * @brief       Print how much of the outputs of a sensor its history holds
+ *
+ * @param[in]   sensor              index of the sensor
+ *
+ * @return      none
+ */
+static void print_history(uint32_t sensor) {
+    const bsec_iot_history_t *hist = &histories[sensor];
+    bsec_iot_history_iter_t iter;
+    bsec_iot_output_t output;
+    int64_t first = -1, last = 0;
+    uint32_t n_kept = 0;
+
+    bsec_iot_history_iter_init(&iter, hist, 0, INT64_MAX);
+    while (bsec_iot_history_next(&iter, &output)) {
+        if (first < 0) {
+            first = output.timestamp;
+        }
+        last = output.timestamp;
+        n_kept++;
+    }
+
+    printf("history %u: %u samples kept in %u bytes, %.1f bytes per sample (%u raw), %.0f s to %.0f s\n", sensor,
+           n_kept, HOST_HISTORY_SIZE, hist->n_samples ? (double)hist->n_bytes / hist->n_samples : 0.0,
+           (unsigned)(sizeof(output.value) + sizeof(output.accuracy) + sizeof(output.timestamp) +
+                      sizeof(output.valid_mask)),
+           first / 1e9, last / 1e9);
+}
+
+/*!
+ * @brief       Print the estimated charge of a sensor, per part and per mode
+ *
+ * @param[in]   sensor              index of the sensor
+ *
+ * @return      none
+ */
+static void print_energy(uint32_t sensor) {
+    static const char *const mode_names[BSEC_IOT_ENERGY_NUM_MODES + 1] = { "ULP", "LP", "CONT", "SCAN", "all" };
+    bsec_iot_energy_report_t report;
+    uint32_t mode;
+
+    for (mode = 0; mode <= BSEC_IOT_ENERGY_NUM_MODES; mode++) {
+        bsec_iot_energy_get(&energies[sensor], (bsec_iot_energy_mode_t)mode, &report);
+        if (report.time_us == 0) {
+            continue;
+        }
+        printf("energy %u %-4s: %.0f s, %u samples, %.1f uC/sample, %.1f uAh/h (heater %.0f, TPH %.0f, bus %.0f, "
+               "CPU %.0f, sleep %.1f uC)\n",
+               sensor, mode_names[mode], report.time_us / 1e6, report.n_steps, report.per_sample_uc,
+               report.per_hour_uah, report.charge_uc[BSEC_IOT_ENERGY_HEATER], report.charge_uc[BSEC_IOT_ENERGY_TPH],
+               report.charge_uc[BSEC_IOT_ENERGY_BUS], report.charge_uc[BSEC_IOT_ENERGY_CPU],
+               report.charge_uc[BSEC_IOT_ENERGY_SLEEP]);
+    }
+}
+
+/*!
+ * @brief       Hand the outputs and the inputs of a sensor to the stages of the demo
+ *
+ * @param[in]   sensor              index of the sensor
+ * @param[in]   window_s            publishing window in seconds, negative to hand over all the outputs
+ * @param[in]   pipelined           non-zero to process the inputs through the pipeline
+ * @param[in]   async               non-zero to read the data through the simulated asynchronous bus
+ *
+ * @return      none
+ */
+static void attach_sensor(uint32_t sensor, int32_t window_s, uint8_t pipelined, uint8_t async) {
+    bsec_iot_set_handlers(&ctxs[sensor], output_ready, state_save, 10000);
+    if (window_s >= 0) {
+        bsec_iot_set_output_filter(&ctxs[sensor], bsec_iot_publish_filter, &publishes[sensor]);
+    }
+    if (pipelined) {
+        /* Both stages run in this thread, nothing to lock */
+        bsec_iot_pipeline_add(&pipeline, &ctxs[sensor], NULL, NULL);
+    }
+    if (async) {
+        bsec_iot_set_async_read(&ctxs[sensor], host_bus_read_async, &bus);
+    }
+}
+
+/*!
+ * @brief       Suspend all the sensors, as before a deep sleep, and resume them from the retained buffers as after it
+ *
+ * @param[in]   n_sensors           number of sensors
+ * @param[in]   window_s            publishing window in seconds, negative to hand over all the outputs
+ * @param[in]   pipelined           non-zero to process the inputs through the pipeline
+ * @param[in]   async               non-zero to read the data through the simulated asynchronous bus
+ *
+ * @return      zero if successful, one otherwise
+ */
+static int sleep_and_resume(uint32_t n_sensors, int32_t window_s, uint8_t pipelined, uint8_t async) {
+    return_values_init ret;
+    uint32_t length;
+    uint32_t i;
+
+    for (i = 0; i < n_sensors; i++) {
+        length = bsec_iot_suspend(&ctxs[i], retained[i], sizeof(retained[i]));
+        if (length == 0) {
+            fprintf(stderr, "sensor %u: suspend failed\n", i);
+            return 1;
+        }
+        printf("suspend %u: %u bytes retained at %.0f s\n", i, length, host_clock_now_us() / 1e6);
+    }
+
+    /* Whatever is not retained is lost in deep sleep, the BSEC instances included */
+    bsec_iot_arena_init(&arena, arena_mem, sizeof(arena_mem));
+    for (i = 0; i < n_sensors; i++) {
+        ret = bsec_iot_resume(&ctxs[i], retained[i], sizeof(retained[i]), &emus[i], bme68x_emu_write,
+                              bme68x_emu_read, host_clock_sleep, &arena);
+        if (ret.bme68x_status != BME68X_OK || ret.bsec_status != BSEC_OK) {
+            fprintf(stderr, "sensor %u: resume failed (bme68x %d, bsec %d)\n", i, ret.bme68x_status,
+                    ret.bsec_status);
+            return 1;
+        }
+        attach_sensor(i, window_s, pipelined, async);
+    }
+    if (trace.write != NULL) {
+        bsec_iot_set_trace(&ctxs[0], bsec_iot_trace_input, &trace);
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       Run the demo
+ *
+ * Usage: bsec_host [n_sensors] [simulated seconds] [-v] [-s] [-q] [-p window in seconds] [-t trace file of the first
+ * sensor] [-r] [-a]; -s puts the sensors on SPI, one chip select each, -q processes the inputs through a pipeline
+ * drained after each wakeup, -p only hands over the outputs on window close or change, -r suspends the sensors halfway
+ * and resumes them as after a deep sleep, -a reads the data through a simulated asynchronous bus
+ *
+ * @return      zero if successful, one otherwise
+ */
+int main(int argc, char **argv) {
+    return_values_init ret;
+    uint32_t n_sensors = 2;
+    int64_t duration_us = INT64_C(3600000000);
+    int64_t wakeup;
+    FILE *trace_file = NULL;
+    enum bme68x_intf intf = BME68X_I2C_INTF;
+    uint32_t n_args = 0;
+    int32_t window_s = -1;
+    uint8_t pipelined = 0;
+    uint8_t suspend = 0;
+    uint8_t async = 0;
+    uint32_t i;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[arg], "-s") == 0) {
+            intf = BME68X_SPI_INTF;
+        } else if (strcmp(argv[arg], "-q") == 0) {
+            pipelined = 1;
+        } else if (strcmp(argv[arg], "-r") == 0) {
+            suspend = 1;
+        } else if (strcmp(argv[arg], "-a") == 0) {
+            async = 1;
+        } else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) {
+            window_s = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+            trace_file = fopen(argv[++arg], "wb");
+            if (trace_file == NULL) {
+                perror(argv[arg]);
+                return 1;
+            }
+        } else if (n_args++ == 0) {
+            n_sensors = (uint32_t)atoi(argv[arg]);
+        } else {
+            duration_us = (int64_t)atoll(argv[arg]) * 1000000;
+        }
+    }
+    if (n_sensors < 1 || n_sensors > HOST_MAX_SENSORS) {
+        fprintf(stderr, "number of sensors must be within 1 and %d\n", HOST_MAX_SENSORS);
+        return 1;
+    }
+
+    host_clock_reset();
+    bsec_iot_arena_init(&arena, arena_mem, sizeof(arena_mem));
+    bsec_iot_sched_init(&sched, 5000);
+    bsec_iot_pipeline_init(&pipeline, NULL, NULL);
+    bsec_iot_bus_init(&bus_completions, NULL, NULL);
+    /* I2C at 400 kHz takes 9 bit times per byte and about three bytes to address a register, SPI at 8 MHz 1 us */
+    if (intf == BME68X_SPI_INTF) {
+        host_bus_init(&bus, 2, 1, &bus_completions);
+    } else {
+        host_bus_init(&bus, 70, 23, &bus_completions);
+    }
+
+    for (i = 0; i < n_sensors; i++) {
+        bme68x_emu_init(&emus[i], BME68X_EMU_VARIANT_BME680, host_clock_now_us);
+        if (intf == BME68X_SPI_INTF) {
+            bme68x_emu_set_spi(&emus[i]);
+        }
+        ret = bsec_iot_init(&ctxs[i], intf, (intf == BME68X_SPI_INTF) ? (uint8_t)i : 0x76, &emus[i],
+                            BSEC_SAMPLE_RATE_LP, NULL, 0, 0.0f, bme68x_emu_write, bme68x_emu_read, host_clock_sleep,
+                            state_load, config_load, &arena);
+        if (ret.bme68x_status != BME68X_OK || ret.bsec_status != BSEC_OK) {
+            fprintf(stderr, "sensor %u: init failed (bme68x %d, bsec %d)\n", i, ret.bme68x_status, ret.bsec_status);
+            return 1;
+        }
+        bsec_iot_history_init(&histories[i], history_mem[i], HOST_HISTORY_SIZE, HOST_HISTORY_BLOCK_SIZE);
+        bsec_iot_energy_init(&energies[i], NULL);
+        if (window_s >= 0) {
+            bsec_iot_publish_init(&publishes[i], (uint32_t)window_s);
+        }
+        attach_sensor(i, window_s, pipelined, async);
+        bsec_iot_sched_add(&sched, &ctxs[i]);
+    }
+    if (trace_file != NULL) {
+        bsec_iot_trace_init(&trace, trace_write, trace_file);
+        bsec_iot_set_trace(&ctxs[0], bsec_iot_trace_input, &trace);
+    }
+
+    /* The virtual clock jumps straight to each wakeup */
+    while (host_clock_now_us() < duration_us) {
+        /* The reads that ended are reported as their interrupt would, before the phases they make due */
+        if (host_bus_poll(&bus) > 0) {
+            bsec_iot_bus_dispatch(&bus_completions, &sched, host_clock_now_us());
+        }
+        wakeup = bsec_iot_sched_run(&sched, host_clock_now_us());
+        bsec_iot_pipeline_process(&pipeline);
+
+        /* Sleep halfway, as soon as no sensor is in the middle of a cycle */
+        if (suspend && host_clock_now_us() >= duration_us / 2) {
+            for (i = 0; i < n_sensors && ctxs[i].phase == BSEC_IOT_PHASE_CONTROL; i++) {
+            }
+            if (i == n_sensors) {
+                if (sleep_and_resume(n_sensors, window_s, pipelined, async) != 0) {
+                    return 1;
+                }
+                suspend = 0;
+            }
+        }
+        if (host_bus_next_us(&bus) < wakeup) {
+            wakeup = host_bus_next_us(&bus);
+        }
+        if (wakeup > host_clock_now_us()) {
+            host_clock_sleep((uint32_t)(wakeup - host_clock_now_us()), NULL);
+        }
+    }
+
+    printf("simulated %.0f s: %u outputs, %u wakeups, %u phases, %u coalesced\n", host_clock_now_us() / 1e6,
+           n_outputs, sched.n_wakeups, sched.n_steps, sched.n_coalesced);
+    for (i = 0; i < n_sensors; i++) {
+        printf("sensor %u: %u reads (%u bytes), %u writes (%u bytes), %u config writes skipped, %u measurements, "
+               "heater on %.1f s\n",
+               i, ctxs[i].bus_stats.n_reads, ctxs[i].bus_stats.n_bytes_read, ctxs[i].bus_stats.n_writes,
+               ctxs[i].bus_stats.n_bytes_written, ctxs[i].bus_stats.n_config_writes_skipped,
+               emus[i].n_measurements, emus[i].heater_on_us / 1e6);
+        printf("boot %u: %s %u us (configuration %u us, state %u us), first outputs %u us after the start\n", i,
+               ctxs[i].boot.resumed ? "resume" : "init", ctxs[i].boot.init_us, ctxs[i].boot.config_us,
+               ctxs[i].boot.state_us, ctxs[i].boot.boot_to_output_us);
+        print_history(i);
+        print_energy(i);
+        if (window_s >= 0) {
+            printf("publish %u: %u of %u outputs handed over (%.1f %% suppressed): %u window, %u deadband, "
+                   "%u accuracy\n",
+                   i, publishes[i].n_published, publishes[i].n_samples,
+                   publishes[i].n_samples
+                       ? 100.0 * (publishes[i].n_samples - publishes[i].n_published) / publishes[i].n_samples
+                       : 0.0,
+                   publishes[i].n_window, publishes[i].n_deadband, publishes[i].n_accuracy);
+        }
+    }
+    if (pipelined) {
+        printf("pipeline: %u sets queued, %u dropped, %u processed, at most %u waiting\n", pipeline.n_queued,
+               pipeline.n_dropped, pipeline.n_processed, pipeline.max_depth);
+    }
+    if (async) {
+        printf("bus: %u asynchronous reads, %.3f s of transfers off the processor, %u completions dropped\n",
+               bus.n_reads, bus.busy_us / 1e6, bus_completions.n_dropped);
+    }
+    if (trace_file != NULL) {
+        printf("trace: %u records, %u write errors\n", trace.n_records, trace.n_write_errors);
+        fclose(trace_file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*!
+ * @file replay.c
+ *
+ * @brief
+ * Offline replay of a log of BSEC inputs recorded with bsec_iot_trace_input(), e.g. by bsec_host -t. The outputs are
+ * printed as CSV, one line per set of inputs.
+ *
+ * Usage: bsec_replay <log> [temperature offset]; the recorded temperature offset is kept unless one is given
+ */
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bsec_trace.h"
+#include "bme68x_emu.h"
+#include "host_clock.h"
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+static bsec_iot_ctx_t ctx;
+static bme68x_emu_t emu;
+static uint8_t arena_mem[BSEC_IOT_ARENA_SIZE(1)] __attribute__((aligned(4)));
+static bsec_iot_arena_t arena;
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Print the outputs of a set of inputs
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void output_ready(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    uint8_t id;
+
+    (void)ctx;
+    printf("%lld,%d,0x%05x", (long long)output->timestamp, output->bsec_status, (unsigned)output->valid_mask);
+    for (id = 0; id < BSEC_IOT_NUM_OUTPUTS; id++) {
+        if (output->valid_mask & BSEC_IOT_OUTPUT_MASK(id)) {
+            printf(",%.9g,%u", output->value[id], output->accuracy[id]);
+        } else {
+            printf(",,");
+        }
+    }
+    printf("\n");
+}
+
+/*!
+ * @brief       Start from the default configuration and without state, as bsec_host does
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   buffer              buffer to hold the loaded string
+ * @param[in]   n_buffer            size of the buffer
+ *
+ * @return      zero
+ */
+static uint32_t blob_load(bsec_iot_ctx_t *ctx, uint8_t *buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)buffer;
+    (void)n_buffer;
+    return 0;
+}
+
+/*!
+ * @brief       Replay a log
+ *
+ * @return      zero if successful, one otherwise
+ */
+int main(int argc, char **argv) {
+    return_values_init ret;
+    struct stat st;
+    const uint8_t *log;
+    float temperature_offset = 0.0f;
+    int32_t n_processed;
+    int fd;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <log> [temperature offset]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2) {
+        temperature_offset = strtof(argv[2], NULL);
+    }
+
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    log = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (log == MAP_FAILED) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    /* The sensor is only needed by bsec_iot_init(), the inputs come from the log */
+    bsec_iot_arena_init(&arena, arena_mem, sizeof(arena_mem));
+    bme68x_emu_init(&emu, BME68X_EMU_VARIANT_BME680, host_clock_now_us);
+    ret = bsec_iot_init(&ctx, BME68X_I2C_INTF, 0x76, &emu, BSEC_SAMPLE_RATE_LP, NULL, 0, temperature_offset,
+                        bme68x_emu_write, bme68x_emu_read, host_clock_sleep, blob_load, blob_load, &arena);
+    if (ret.bme68x_status != BME68X_OK || ret.bsec_status != BSEC_OK) {
+        fprintf(stderr, "init failed (bme68x %d, bsec %d)\n", ret.bme68x_status, ret.bsec_status);
+        return 1;
+    }
+    bsec_iot_set_handlers(&ctx, output_ready, NULL, 0);
+
+    n_processed = bsec_iot_trace_replay(&ctx, log, (uint32_t)st.st_size, argc > 2);
+    if (n_processed < 0) {
+        fprintf(stderr, "%s: not a valid log\n", argv[1]);
+        return 1;
+    }
+    fprintf(stderr, "%d sets of inputs replayed\n", n_processed);
+
+    munmap((void *)log, (size_t)st.st_size);
+    close(fd);
+
+    return 0;
+}
@@ -0,0 +1,1183 @@
+/*!
+ * @file tests.c
+ *
+ * @brief
+ * Checks of the integration and of its stages, run by CTest: emulated sensors on the virtual clock for the acquisition
+ * cycle, the scheduler, the pipeline (also run by two threads), the asynchronous bus and the resumption after a deep
+ * sleep, plain buffers for the persistence, the trace, the history and the publishing filter.
+ *
+ * Usage: bsec_tests <step|sched|persist|trace|history|publish|pipeline|tasks|bus|resume>
+ */
+
+/**********************************************************************************************************************/
+/* header files */
+/**********************************************************************************************************************/
+
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bsec_scheduler.h"
+#include "bsec_persist.h"
+#include "bsec_trace.h"
+#include "bsec_history.h"
+#include "bsec_publish.h"
+#include "bsec_pipeline.h"
+#include "bsec_bus.h"
+#include "bsec_energy.h"
+#include "bme68x_emu.h"
+#include "host_bus.h"
+#include "host_clock.h"
+
+/**********************************************************************************************************************/
+/* local macro definitions */
+/**********************************************************************************************************************/
+
+#define TESTS_MAX_SENSORS 3
+
+/* Size of the in-memory log of the trace check */
+#define TESTS_TRACE_SIZE (1 << 20)
+
+/* Memory and block size of the history check */
+#define TESTS_HISTORY_SIZE 8192
+#define TESTS_HISTORY_BLOCK_SIZE 512
+
+/* Number of samples appended in the history check */
+#define TESTS_HISTORY_SAMPLES 5000
+
+/* Number of samples between two state saves in the two-task check */
+#define TESTS_TASKS_SAVE_INTVL 10
+
+/* Number of outputs after which the two-task check unsubscribes the gas percentage from output_ready */
+#define TESTS_TASKS_UNSUBSCRIBE_AT 100
+
+/* Fail the running check, with the condition that did not hold */
+#define TESTS_CHECK(cond)                                                                                              \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                  \
+            return 1;                                                                                                  \
+        }                                                                                                              \
+    } while (0)
+
+/**********************************************************************************************************************/
+/* local type definitions */
+/**********************************************************************************************************************/
+
+/* function pointer to a check, returning zero if it passed */
+typedef int (*tests_fct)(void);
+
+/* Structure describing one check */
+typedef struct {
+	/*! Name of the check on the command line */
+	const char *name;
+	/*! Function running the check */
+	tests_fct run;
+} tests_entry_t;
+
+/* Structure with what a sensor handed to output_ready */
+typedef struct {
+	/*! Number of outputs */
+	uint32_t n_outputs;
+	/*! FNV-1a hash of the time stamps, values and accuracies of the valid outputs */
+	uint64_t hash;
+	/*! Time stamp (in nanoseconds) of the latest outputs, zero if none */
+	int64_t last_timestamp;
+	/*! Shortest time (in nanoseconds) between two outputs */
+	int64_t min_gap;
+	/*! Longest time (in nanoseconds) between two outputs */
+	int64_t max_gap;
+} tests_outputs_t;
+
+/* Structure holding the slots of the persistence check */
+typedef struct {
+	/*! Content of each slot */
+	bsec_iot_persist_record_t slots[3];
+	/*! Number of writes to each slot */
+	uint32_t n_writes[3];
+	/*! Set to make the writes fail */
+	uint8_t fail;
+} tests_nvm_t;
+
+/* Structure shared by the acquisition and the processing threads of the two-task check */
+typedef struct {
+	/*! Queue between the threads */
+	bsec_iot_pipeline_t pipeline;
+	/*! Lock of the sensor */
+	pthread_mutex_t lock;
+	/*! Lock of the scratch area of the arena */
+	pthread_mutex_t arena_lock;
+	/*! Set by the acquisition thread once it is done, only accessed atomically */
+	volatile uint8_t done;
+	/*! Persistence of the state, staged by the processing thread and written by the acquisition thread */
+	bsec_iot_persist_t persist;
+	/*! Slots of the persistence */
+	tests_nvm_t nvm;
+	/*! Latest state staged */
+	uint8_t state[BSEC_MAX_STATE_BLOB_SIZE];
+	/*! Length of the latest state staged */
+	uint32_t state_len;
+	/*! State the sensors initialized while running start warm from */
+	uint8_t warm[BSEC_MAX_STATE_BLOB_SIZE];
+	/*! Length of the warm state */
+	uint32_t warm_len;
+	/*! History of the outputs, appended by the processing thread and spilled by the acquisition thread */
+	bsec_iot_history_t hist;
+	/*! Number of samples decoded from the blocks spilled */
+	uint32_t n_spilled_samples;
+	/*! Time stamp (in nanoseconds) of the latest sample spilled */
+	int64_t last_spilled;
+	/*! Set when a spilled sample was out of order */
+	uint8_t spill_disorder;
+} tests_tasks_t;
+
+/**********************************************************************************************************************/
+/* local variables */
+/**********************************************************************************************************************/
+
+static bsec_iot_ctx_t ctxs[TESTS_MAX_SENSORS];
+static bme68x_emu_t emus[TESTS_MAX_SENSORS];
+static tests_outputs_t outputs[TESTS_MAX_SENSORS];
+static uint8_t arena_mem[BSEC_IOT_ARENA_SIZE(TESTS_MAX_SENSORS)] __attribute__((aligned(4)));
+static bsec_iot_arena_t arena;
+static uint8_t trace_log[TESTS_TRACE_SIZE];
+static uint32_t trace_length;
+static uint8_t history_mem[TESTS_HISTORY_SIZE] __attribute__((aligned(8)));
+static uint8_t history_spilled[TESTS_HISTORY_BLOCK_SIZE] __attribute__((aligned(8)));
+static bsec_iot_output_t history_ref[TESTS_HISTORY_SAMPLES];
+static uint8_t retained[BSEC_IOT_RETAINED_SIZE] __attribute__((aligned(8)));
+static tests_tasks_t tasks;
+
+/**********************************************************************************************************************/
+/* functions */
+/**********************************************************************************************************************/
+
+/*!
+ * @brief       Fold bytes into an FNV-1a hash
+ *
+ * @param[in]   hash                hash so far
+ * @param[in]   data                bytes to fold in
+ * @param[in]   length              number of bytes
+ *
+ * @return      new hash
+ */
+static uint64_t tests_hash(uint64_t hash, const void *data, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+/*!
+ * @brief       Count and hash the outputs of a sensor, and keep track of the time between them
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void output_ready(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    tests_outputs_t *out = &outputs[ctx - ctxs];
+    int64_t timestamp_us;
+    int64_t gap;
+    uint8_t i;
+
+    if (out->last_timestamp != 0) {
+        gap = output->timestamp - out->last_timestamp;
+        if (out->min_gap == 0 || gap < out->min_gap) {
+            out->min_gap = gap;
+        }
+        if (gap > out->max_gap) {
+            out->max_gap = gap;
+        }
+    }
+    out->last_timestamp = output->timestamp;
+    out->n_outputs++;
+
+    /* In whole microseconds, the resolution of the trace */
+    timestamp_us = output->timestamp / 1000;
+    out->hash = tests_hash(out->hash, &timestamp_us, sizeof(timestamp_us));
+    for (i = 0; i < BSEC_IOT_NUM_OUTPUTS; i++) {
+        if (output->valid_mask & BSEC_IOT_OUTPUT_MASK(i)) {
+            out->hash = tests_hash(out->hash, &output->value[i], sizeof(output->value[i]));
+            out->hash = tests_hash(out->hash, &output->accuracy[i], sizeof(output->accuracy[i]));
+        }
+    }
+}
+
+/*!
+ * @brief       No state is kept between the checks
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   state_buffer        buffer to hold the loaded state string
+ * @param[in]   n_buffer            size of the allocated state buffer
+ *
+ * @return      zero
+ */
+static uint32_t state_load(bsec_iot_ctx_t *ctx, uint8_t *state_buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)state_buffer;
+    (void)n_buffer;
+    return 0;
+}
+
+/*!
+ * @brief       Keep the default configuration of BSEC
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   config_buffer       buffer to hold the loaded config string
+ * @param[in]   n_buffer            size of the allocated config buffer
+ *
+ * @return      zero
+ */
+static uint32_t config_load(bsec_iot_ctx_t *ctx, uint8_t *config_buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)config_buffer;
+    (void)n_buffer;
+    return 0;
+}
+
+/*!
+ * @brief       Start the virtual clock and the arena over, for a check running its sensors from scratch
+ *
+ * @return      none
+ */
+static void tests_reset(void) {
+    host_clock_reset();
+    bsec_iot_arena_init(&arena, arena_mem, sizeof(arena_mem));
+    memset(outputs, 0, sizeof(outputs));
+}
+
+/*!
+ * @brief       Initialize an emulated BME680 on I2C and its context, handing its outputs to output_ready()
+ *
+ * @param[in]   sensor              index of the sensor
+ * @param[in]   sample_rate         sample rate of the outputs
+ *
+ * @return      zero if successful, one otherwise
+ */
+static int tests_sensor(uint32_t sensor, float sample_rate) {
+    return_values_init ret;
+
+    bme68x_emu_init(&emus[sensor], BME68X_EMU_VARIANT_BME680, host_clock_now_us);
+    ret = bsec_iot_init(&ctxs[sensor], BME68X_I2C_INTF, 0x76, &emus[sensor], sample_rate, NULL, 0, 0.0f,
+                        bme68x_emu_write, bme68x_emu_read, host_clock_sleep, state_load, config_load, &arena);
+    if (ret.bme68x_status != BME68X_OK || ret.bsec_status != BSEC_OK) {
+        fprintf(stderr, "sensor %u: init failed (bme68x %d, bsec %d)\n", sensor, ret.bme68x_status, ret.bsec_status);
+        return 1;
+    }
+    bsec_iot_set_handlers(&ctxs[sensor], output_ready, NULL, 0);
+    outputs[sensor].hash = UINT64_C(1469598103934665603);
+
+    return 0;
+}
+
+/*!
+ * @brief       Drive one sensor through bsec_iot_step() alone until the given time, draining a pipeline if any
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   pipeline            pipeline drained after each phase, NULL if none
+ * @param[in]   until_us            time (in microseconds) of the virtual clock to stop at
+ *
+ * @return      none
+ */
+static void tests_run(bsec_iot_ctx_t *ctx, bsec_iot_pipeline_t *pipeline, int64_t until_us) {
+    int64_t deadline;
+
+    while (host_clock_now_us() < until_us) {
+        deadline = bsec_iot_step(ctx, host_clock_now_us());
+        if (pipeline != NULL) {
+            bsec_iot_pipeline_process(pipeline);
+        }
+        if (deadline > host_clock_now_us()) {
+            host_clock_advance(deadline - host_clock_now_us());
+        }
+    }
+}
+
+/*!
+ * @brief       Acquisition cycle of a single sensor: one sample per LP period, nothing done before the deadline, and
+ *              only the outputs asked for at init
+ *
+ * @return      zero if the check passed
+ */
+static int tests_step(void) {
+    static const bsec_sensor_configuration_t requested[] = {
+        {BSEC_SAMPLE_RATE_LP, BSEC_OUTPUT_IAQ},
+        {BSEC_SAMPLE_RATE_LP, BSEC_OUTPUT_CO2_EQUIVALENT},
+    };
+    bsec_iot_ctx_t *ctx = &ctxs[0];
+    bsec_iot_phase_t phase;
+    return_values_init ret;
+    int64_t deadline;
+
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+
+    tests_run(ctx, NULL, INT64_C(600000000));
+
+    /* 3 s apart, without any sample lost or doubled */
+    TESTS_CHECK(outputs[0].n_outputs >= 199 && outputs[0].n_outputs <= 201);
+    TESTS_CHECK(outputs[0].min_gap >= INT64_C(2900000000) && outputs[0].max_gap <= INT64_C(3100000000));
+    TESTS_CHECK(ctx->bus_stats.n_reads > 0 && ctx->bus_stats.n_writes > 0);
+
+    /* A call ahead of the deadline changes nothing */
+    deadline = bsec_iot_step(ctx, host_clock_now_us());
+    if (deadline > host_clock_now_us()) {
+        phase = ctx->phase;
+        TESTS_CHECK(bsec_iot_step(ctx, deadline - 1) == deadline);
+        TESTS_CHECK(ctx->phase == phase);
+    }
+
+    /* A list given to the init replaces the default outputs */
+    tests_reset();
+    bme68x_emu_init(&emus[0], BME68X_EMU_VARIANT_BME680, host_clock_now_us);
+    ret = bsec_iot_init(ctx, BME68X_I2C_INTF, 0x76, &emus[0], BSEC_SAMPLE_RATE_LP, requested, 2, 0.0f, bme68x_emu_write,
+                        bme68x_emu_read, host_clock_sleep, state_load, config_load, &arena);
+    TESTS_CHECK(ret.bme68x_status == BME68X_OK && ret.bsec_status == BSEC_OK);
+    TESTS_CHECK(ctx->subscribed_mask ==
+                (BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_IAQ) | BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_CO2_EQUIVALENT)));
+    bsec_iot_set_handlers(ctx, output_ready, NULL, 0);
+    tests_run(ctx, NULL, INT64_C(60000000));
+    TESTS_CHECK(outputs[0].n_outputs >= 19 && outputs[0].n_outputs <= 21);
+
+    return 0;
+}
+
+/*!
+ * @brief       Scheduler of several sensors: deadlines kept in order, close ones served by one wakeup, and a cycle
+ *              brought forward served right away
+ *
+ * @return      zero if the check passed
+ */
+static int tests_sched(void) {
+    bsec_iot_sched_t sched;
+    int64_t wakeup;
+    int64_t request_us = 0;
+    uint32_t n_before = 0;
+    uint8_t pos;
+    uint32_t i;
+
+    tests_reset();
+    bsec_iot_sched_init(&sched, 5000);
+    for (i = 0; i < TESTS_MAX_SENSORS; i++) {
+        /* Started a little apart, well within the slack */
+        TESTS_CHECK(tests_sensor(i, (i < TESTS_MAX_SENSORS - 1) ? BSEC_SAMPLE_RATE_LP : BSEC_SAMPLE_RATE_ULP) == 0);
+        TESTS_CHECK(bsec_iot_sched_add(&sched, &ctxs[i]) == 0);
+        host_clock_advance(1700);
+    }
+
+    while (host_clock_now_us() < INT64_C(900000000)) {
+        /* An out-of-schedule sample of the ULP sensor, halfway through its period */
+        if (request_us == 0 && host_clock_now_us() >= INT64_C(450000000) &&
+            ctxs[TESTS_MAX_SENSORS - 1].phase == BSEC_IOT_PHASE_CONTROL) {
+            request_us = host_clock_now_us();
+            n_before = outputs[TESTS_MAX_SENSORS - 1].n_outputs;
+            TESTS_CHECK(bsec_iot_measure_on_demand(&ctxs[TESTS_MAX_SENSORS - 1], request_us) == BSEC_OK);
+            bsec_iot_sched_reschedule(&sched, &ctxs[TESTS_MAX_SENSORS - 1]);
+        }
+
+        wakeup = bsec_iot_sched_run(&sched, host_clock_now_us());
+        TESTS_CHECK(wakeup > host_clock_now_us());
+        for (pos = 1; pos < sched.n_ctxs; pos++) {
+            TESTS_CHECK(sched.heap[(pos - 1) / 2]->deadline <= sched.heap[pos]->deadline);
+        }
+
+        if (request_us != 0 && n_before != 0 && outputs[TESTS_MAX_SENSORS - 1].n_outputs > n_before) {
+            TESTS_CHECK(outputs[TESTS_MAX_SENSORS - 1].last_timestamp / 1000 - request_us < 1000000);
+            n_before = 0;
+        }
+        host_clock_advance(wakeup - host_clock_now_us());
+    }
+
+    for (i = 0; i < TESTS_MAX_SENSORS - 1; i++) {
+        TESTS_CHECK(outputs[i].n_outputs >= 299 && outputs[i].n_outputs <= 301);
+    }
+    TESTS_CHECK(request_us != 0 && n_before == 0);
+    TESTS_CHECK(sched.n_coalesced > 0 && sched.n_wakeups < sched.n_steps);
+
+    return 0;
+}
+
+/*!
+ * @brief       Read a slot of the persistence check
+ *
+ * @param[in]   storage             slots
+ * @param[in]   slot                index of the slot
+ * @param[out]  record              buffer receiving the slot
+ * @param[in]   length              size of a slot
+ *
+ * @return      zero
+ */
+static int8_t tests_nvm_read(void *storage, uint8_t slot, uint8_t *record, uint32_t length) {
+    memcpy(record, &((tests_nvm_t *)storage)->slots[slot], length);
+    return 0;
+}
+
+/*!
+ * @brief       Write a slot of the persistence check, or only its header when writes fail
+ *
+ * @param[in]   storage             slots
+ * @param[in]   slot                index of the slot
+ * @param[in]   record              slot to write
+ * @param[in]   length              size of a slot
+ *
+ * @return      zero if successful, negative when writes fail
+ */
+static int8_t tests_nvm_write(void *storage, uint8_t slot, const uint8_t *record, uint32_t length) {
+    tests_nvm_t *nvm = (tests_nvm_t *)storage;
+
+    nvm->n_writes[slot]++;
+    if (nvm->fail) {
+        memcpy(&nvm->slots[slot], record, offsetof(bsec_iot_persist_record_t, blob));
+        return -1;
+    }
+    memcpy(&nvm->slots[slot], record, length);
+    return 0;
+}
+
+/*!
+ * @brief       Persistence of the state: rotation over the slots, unchanged states skipped, and the latest state
+ *              kept through failed writes and corrupted slots
+ *
+ * @return      zero if the check passed
+ */
+static int tests_persist(void) {
+    static tests_nvm_t nvm;
+    bsec_iot_persist_t persist;
+    uint8_t state[100];
+    uint8_t loaded[BSEC_MAX_STATE_BLOB_SIZE];
+    uint8_t i;
+
+    memset(&nvm, 0xff, sizeof(nvm.slots));
+    TESTS_CHECK(bsec_iot_persist_init(&persist, tests_nvm_read, tests_nvm_write, &nvm, 1, 0) < 0);
+    TESTS_CHECK(bsec_iot_persist_init(&persist, tests_nvm_read, tests_nvm_write, &nvm, 3, 5000) == 0);
+    TESTS_CHECK(bsec_iot_persist_load(&persist, 7, loaded, sizeof(loaded)) == 0);
+
+    /* Each new state goes to the next slot, only when there is time for the write */
+    for (i = 1; i <= 4; i++) {
+        memset(state, i, sizeof(state));
+        bsec_iot_persist_stage(&persist, 7, state, sizeof(state));
+        TESTS_CHECK(bsec_iot_persist_flush(&persist, 100) > 0);
+        TESTS_CHECK(bsec_iot_persist_flush(&persist, 10000) == 0);
+    }
+    TESTS_CHECK(nvm.n_writes[0] == 2 && nvm.n_writes[1] == 1 && nvm.n_writes[2] == 1);
+
+    /* The same state again is not written */
+    bsec_iot_persist_stage(&persist, 7, state, sizeof(state));
+    TESTS_CHECK(bsec_iot_persist_flush(&persist, 10000) == 0 && persist.n_skipped == 1);
+
+    /* A write failing halfway is retried on the same slot and never touches the latest state */
+    memset(state, 5, sizeof(state));
+    bsec_iot_persist_stage(&persist, 7, state, sizeof(state));
+    nvm.fail = 1;
+    for (i = 0; i < 3; i++) {
+        TESTS_CHECK(bsec_iot_persist_flush(&persist, 10000) < 0);
+    }
+    TESTS_CHECK(nvm.n_writes[1] == 4 && nvm.n_writes[0] == 2 && nvm.n_writes[2] == 1);
+    TESTS_CHECK(bsec_iot_persist_init(&persist, tests_nvm_read, tests_nvm_write, &nvm, 3, 5000) == 0);
+    TESTS_CHECK(bsec_iot_persist_load(&persist, 7, loaded, sizeof(loaded)) == sizeof(state) && loaded[0] == 4);
+
+    /* A corrupted latest slot leaves the one before */
+    nvm.slots[0].blob[5] ^= 1;
+    TESTS_CHECK(bsec_iot_persist_init(&persist, tests_nvm_read, tests_nvm_write, &nvm, 3, 5000) == 0);
+    TESTS_CHECK(bsec_iot_persist_load(&persist, 7, loaded, sizeof(loaded)) == sizeof(state) && loaded[0] == 3);
+
+    /* A state saved under another configuration is not loaded */
+    TESTS_CHECK(bsec_iot_persist_load(&persist, 8, loaded, sizeof(loaded)) == 0 && persist.n_mismatched == 1);
+
+    return 0;
+}
+
+/*!
+ * @brief       Append to the in-memory log of the trace check
+ *
+ * @param[in]   storage             unused
+ * @param[in]   data                data to append
+ * @param[in]   length              length of the data
+ *
+ * @return      zero if successful, negative if the log is full
+ */
+static int8_t tests_trace_write(void *storage, const void *data, uint32_t length) {
+    (void)storage;
+
+    if (trace_length + length > sizeof(trace_log)) {
+        return -1;
+    }
+    memcpy(trace_log + trace_length, data, length);
+    trace_length += length;
+    return 0;
+}
+
+/*!
+ * @brief       Trace round-trip: the replay of a recording gives the outputs of the live run, and a damaged log is
+ *              refused or cut at its last complete record
+ *
+ * @return      zero if the check passed
+ */
+static int tests_trace(void) {
+    bsec_iot_trace_t trace;
+    tests_outputs_t live;
+    int32_t n_sets;
+
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    bsec_iot_trace_init(&trace, tests_trace_write, NULL);
+    bsec_iot_set_trace(&ctxs[0], bsec_iot_trace_input, &trace);
+    tests_run(&ctxs[0], NULL, INT64_C(600000000));
+    live = outputs[0];
+    TESTS_CHECK(live.n_outputs > 0 && trace.n_write_errors == 0);
+    TESTS_CHECK(trace_length == sizeof(bsec_iot_trace_header_t) + trace.n_records * sizeof(bsec_iot_trace_record_t));
+
+    /* A fresh sensor fed with the log */
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    n_sets = bsec_iot_trace_replay(&ctxs[0], trace_log, trace_length, 0);
+    TESTS_CHECK(n_sets == (int32_t)live.n_outputs);
+    TESTS_CHECK(outputs[0].n_outputs == live.n_outputs && outputs[0].hash == live.hash);
+
+    TESTS_CHECK(bsec_iot_trace_replay(&ctxs[0], trace_log, trace_length - 7, 0) == n_sets - 1);
+    trace_log[0] ^= 1;
+    TESTS_CHECK(bsec_iot_trace_replay(&ctxs[0], trace_log, trace_length, 0) < 0);
+
+    return 0;
+}
+
+/*!
+ * @brief       Keep the latest block written to flash by the history check
+ *
+ * @param[in]   storage             unused
+ * @param[in]   block               block to write
+ * @param[in]   length              length of the block
+ *
+ * @return      zero
+ */
+static int8_t tests_history_spill(void *storage, const uint8_t *block, uint32_t length) {
+    (void)storage;
+
+    memcpy(history_spilled, block, length);
+    return 0;
+}
+
+/*!
+ * @brief       Compare a decoded sample of the history to the one appended
+ *
+ * @param[in]   decoded             decoded sample
+ *
+ * @return      zero if they match, one otherwise
+ */
+static int tests_history_match(const bsec_iot_output_t *decoded) {
+    const bsec_iot_output_t *ref;
+    int64_t index = decoded->timestamp / INT64_C(3000000000);
+    uint8_t i;
+
+    TESTS_CHECK(index >= 0 && index < TESTS_HISTORY_SAMPLES);
+    ref = &history_ref[index];
+    TESTS_CHECK(decoded->timestamp == ref->timestamp && decoded->valid_mask == ref->valid_mask);
+    for (i = 0; i < BSEC_IOT_NUM_OUTPUTS; i++) {
+        if (ref->valid_mask & BSEC_IOT_OUTPUT_MASK(i)) {
+            TESTS_CHECK(fabsf(decoded->value[i] - ref->value[i]) <= 1e-4f * (1.0f + fabsf(ref->value[i])));
+            TESTS_CHECK(decoded->accuracy[i] == ref->accuracy[i]);
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief       History encode/decode: the samples kept decode to the ones appended, over a time range and from a
+ *              block written to flash
+ *
+ * Values are whole tens, which every output resolution stores exactly, and time stamps whole milliseconds.
+ *
+ * @return      zero if the check passed
+ */
+static int tests_history(void) {
+    bsec_iot_history_t hist;
+    bsec_iot_history_iter_t iter;
+    bsec_iot_output_t output;
+    int64_t last = -1;
+    uint32_t n_decoded = 0;
+    uint32_t i;
+    uint8_t k;
+
+    TESTS_CHECK(bsec_iot_history_init(&hist, history_mem, sizeof(history_mem), TESTS_HISTORY_BLOCK_SIZE) == 0);
+    bsec_iot_history_set_spill(&hist, tests_history_spill, NULL, 100);
+
+    for (i = 0; i < TESTS_HISTORY_SAMPLES; i++) {
+        memset(&output, 0, sizeof(output));
+        output.timestamp = (int64_t)i * INT64_C(3000000000);
+        /* Some outputs drop out now and then */
+        output.valid_mask = (UINT32_C(1) << BSEC_IOT_NUM_OUTPUTS) - 1;
+        if (i % 50 < 3) {
+            output.valid_mask &= ~UINT32_C(0x3C000);
+        }
+        for (k = 0; k < BSEC_IOT_NUM_OUTPUTS; k++) {
+            output.value[k] = 10.0f * (float)(50 + (int)(20.0f * sinf(0.01f * (float)i + k)));
+            output.accuracy[k] = (uint8_t)((i / 100) % 4);
+        }
+        history_ref[i] = output;
+        bsec_iot_history_append(&hist, &output);
+        if (i % 7 == 0) {
+            bsec_iot_history_flush(&hist, 1000);
+        }
+    }
+    TESTS_CHECK(hist.n_samples == TESTS_HISTORY_SAMPLES && hist.n_spilled > 0);
+    /* Smaller than the samples themselves */
+    TESTS_CHECK(hist.n_bytes < hist.n_samples * sizeof(output.value));
+
+    /* The ring keeps the latest samples, in order and without a gap */
+    bsec_iot_history_iter_init(&iter, &hist, 0, INT64_MAX);
+    while (bsec_iot_history_next(&iter, &output)) {
+        TESTS_CHECK(tests_history_match(&output) == 0);
+        TESTS_CHECK(last < 0 || output.timestamp == last + INT64_C(3000000000));
+        last = output.timestamp;
+        n_decoded++;
+    }
+    TESTS_CHECK(n_decoded > 0 && last == history_ref[TESTS_HISTORY_SAMPLES - 1].timestamp);
+
+    /* A time range gives the samples within it only */
+    n_decoded = 0;
+    bsec_iot_history_iter_init(&iter, &hist, 4800 * INT64_C(3000000000), 4809 * INT64_C(3000000000));
+    while (bsec_iot_history_next(&iter, &output)) {
+        TESTS_CHECK(output.timestamp >= 4800 * INT64_C(3000000000) && output.timestamp <= 4809 * INT64_C(3000000000));
+        TESTS_CHECK(tests_history_match(&output) == 0);
+        n_decoded++;
+    }
+    TESTS_CHECK(n_decoded == 10);
+
+    /* A block written to flash decodes on its own */
+    n_decoded = 0;
+    bsec_iot_history_iter_block(&iter, history_spilled, 0, INT64_MAX);
+    while (bsec_iot_history_next(&iter, &output)) {
+        TESTS_CHECK(tests_history_match(&output) == 0);
+        n_decoded++;
+    }
+    TESTS_CHECK(n_decoded > 0);
+
+    return 0;
+}
+
+/*!
+ * @brief       Fill the outputs of the publishing check
+ *
+ * @param[out]  output              outputs to fill
+ * @param[in]   index               index of the sample, 3 s apart
+ * @param[in]   iaq                 IAQ
+ * @param[in]   accuracy            accuracy of the IAQ
+ *
+ * @return      none
+ */
+static void tests_publish_output(bsec_iot_output_t *output, uint32_t index, float iaq, uint8_t accuracy) {
+    memset(output, 0, sizeof(*output));
+    output->timestamp = (int64_t)index * INT64_C(3000000000);
+    output->valid_mask = BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_IAQ) | BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_TEMPERATURE);
+    output->value[BSEC_IOT_OUTPUT_IAQ] = iaq;
+    output->accuracy[BSEC_IOT_OUTPUT_IAQ] = accuracy;
+    output->value[BSEC_IOT_OUTPUT_TEMPERATURE] = 21.0f;
+}
+
+/*!
+ * @brief       Publishing filter: first sample, window close, deadband and accuracy change publish, nothing else
+ *
+ * @return      zero if the check passed
+ */
+static int tests_publish(void) {
+    bsec_iot_publish_t publish;
+    bsec_iot_output_t output;
+    uint32_t i;
+
+    bsec_iot_publish_init(&publish, 60);
+
+    /* Steady outputs: the first sample, then one window every 21 samples (60 s from the first sample after the
+     * previous publication) */
+    for (i = 0; i < 100; i++) {
+        tests_publish_output(&output, i, 50.0f, 1);
+        TESTS_CHECK(bsec_iot_publish_filter(&publish, &output) == (i % 21 == 0));
+        if (i == 0) {
+            TESTS_CHECK(publish.reason == BSEC_IOT_PUBLISH_FIRST);
+        } else if (i % 21 == 0) {
+            TESTS_CHECK(publish.reason == BSEC_IOT_PUBLISH_WINDOW);
+            TESTS_CHECK(publish.window.n_samples == 21 && publish.window.mean[BSEC_IOT_OUTPUT_IAQ] == 50.0f);
+        }
+    }
+    TESTS_CHECK(publish.n_published == 5 && publish.n_window == 4);
+
+    /* Beyond the deadband of the IAQ, then a change within it */
+    tests_publish_output(&output, 100, 60.0f, 1);
+    TESTS_CHECK(bsec_iot_publish_filter(&publish, &output) && publish.reason == BSEC_IOT_PUBLISH_DEADBAND);
+    TESTS_CHECK(publish.window.min[BSEC_IOT_OUTPUT_IAQ] == 50.0f && publish.window.max[BSEC_IOT_OUTPUT_IAQ] == 60.0f);
+    tests_publish_output(&output, 101, 63.0f, 1);
+    TESTS_CHECK(!bsec_iot_publish_filter(&publish, &output));
+
+    /* Accuracy change */
+    tests_publish_output(&output, 102, 63.0f, 2);
+    TESTS_CHECK(bsec_iot_publish_filter(&publish, &output) && publish.reason == BSEC_IOT_PUBLISH_ACCURACY);
+
+    /* An output seen for the first time */
+    tests_publish_output(&output, 103, 63.0f, 2);
+    output.valid_mask |= BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_HUMIDITY);
+    TESTS_CHECK(bsec_iot_publish_filter(&publish, &output) && publish.reason == BSEC_IOT_PUBLISH_FIRST);
+
+    TESTS_CHECK(publish.n_samples == 104 && publish.n_published == 8);
+    TESTS_CHECK(publish.n_deadband == 1 && publish.n_accuracy == 1);
+
+    return 0;
+}
+
+/*!
+ * @brief       Pipeline: processing the inputs on the other side of the queue gives the outputs of the serial run, and
+ *              a full queue drops the newest inputs without blocking the acquisition
+ *
+ * @return      zero if the check passed
+ */
+static int tests_pipeline(void) {
+    static bsec_iot_pipeline_t pipeline;
+    tests_outputs_t serial;
+
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    tests_run(&ctxs[0], NULL, INT64_C(600000000));
+    serial = outputs[0];
+
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    bsec_iot_pipeline_init(&pipeline, NULL, NULL);
+    bsec_iot_pipeline_add(&pipeline, &ctxs[0], NULL, NULL);
+    tests_run(&ctxs[0], &pipeline, INT64_C(600000000));
+    TESTS_CHECK(outputs[0].n_outputs == serial.n_outputs && outputs[0].hash == serial.hash);
+    TESTS_CHECK(pipeline.n_processed == pipeline.n_queued && pipeline.n_dropped == 0);
+
+    /* Nobody processing for a while */
+    tests_run(&ctxs[0], NULL, INT64_C(720000000));
+    TESTS_CHECK(pipeline.max_depth == BSEC_IOT_PIPELINE_DEPTH && pipeline.n_dropped > 0);
+    TESTS_CHECK(bsec_iot_pipeline_process(&pipeline) == BSEC_IOT_PIPELINE_DEPTH);
+
+    return 0;
+}
+
+/*!
+ * @brief       Take or give back the lock of the sensor of the two-task check
+ *
+ * @param[in]   lock_arg            mutex
+ * @param[in]   take                non-zero to take the lock, zero to give it back
+ *
+ * @return      none
+ */
+static void tests_tasks_lock(void *lock_arg, uint8_t take) {
+    if (take) {
+        pthread_mutex_lock((pthread_mutex_t *)lock_arg);
+    } else {
+        pthread_mutex_unlock((pthread_mutex_t *)lock_arg);
+    }
+}
+
+/*!
+ * @brief       Count the outputs, and stop BSEC from computing the gas percentage after a while
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void tests_unsubscribe_output_ready(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    bsec_sensor_configuration_t requested = {BSEC_SAMPLE_RATE_DISABLED, BSEC_OUTPUT_GAS_PERCENTAGE};
+
+    output_ready(ctx, output);
+    if (outputs[ctx - ctxs].n_outputs == TESTS_TASKS_UNSUBSCRIBE_AT) {
+        bsec_iot_update_subscription(ctx, &requested, 1);
+    }
+}
+
+/*!
+ * @brief       Count the outputs, change the subscription and append the outputs to the history, on the processing
+ *              thread
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   output              outputs of the step
+ *
+ * @return      none
+ */
+static void tests_tasks_output_ready(bsec_iot_ctx_t *ctx, const bsec_iot_output_t *output) {
+    tests_unsubscribe_output_ready(ctx, output);
+    bsec_iot_history_append(&tasks.hist, output);
+}
+
+/*!
+ * @brief       Stage the state for the acquisition thread to write, on the processing thread
+ *
+ * @param[in]   ctx                 context of the sensor
+ * @param[in]   state_buffer        state to save
+ * @param[in]   length              length of the state
+ *
+ * @return      none
+ */
+static void tests_tasks_state_save(bsec_iot_ctx_t *ctx, const uint8_t *state_buffer, uint32_t length) {
+    bsec_iot_persist_stage(&tasks.persist, ctx->boot.config_fingerprint, state_buffer, length);
+    memcpy(tasks.state, state_buffer, length);
+    tasks.state_len = length;
+}
+
+/*!
+ * @brief       Keep the state of the serial run for the sensors initialized while the two threads run
+ *
+ * @param[in]   ctx                 unused
+ * @param[in]   state_buffer        state to keep
+ * @param[in]   length              length of the state
+ *
+ * @return      none
+ */
+static void tests_tasks_keep_warm(bsec_iot_ctx_t *ctx, const uint8_t *state_buffer, uint32_t length) {
+    (void)ctx;
+
+    memcpy(tasks.warm, state_buffer, length);
+    tasks.warm_len = length;
+}
+
+/*!
+ * @brief       Load the warm state through the scratch area of the arena, on the acquisition thread
+ *
+ * @param[in]   ctx                 unused
+ * @param[out]  state_buffer        buffer to hold the state
+ * @param[in]   n_buffer            size of the buffer
+ *
+ * @return      length of the state
+ */
+static uint32_t tests_tasks_state_load(bsec_iot_ctx_t *ctx, uint8_t *state_buffer, uint32_t n_buffer) {
+    (void)ctx;
+    (void)n_buffer;
+
+    memcpy(state_buffer, tasks.warm, tasks.warm_len);
+    return tasks.warm_len;
+}
+
+/*!
+ * @brief       Decode a block of the history written to flash, on the acquisition thread
+ *
+ * @param[in]   storage             unused
+ * @param[in]   block               block to write
+ * @param[in]   length              length of the block
+ *
+ * @return      zero
+ */
+static int8_t tests_tasks_spill(void *storage, const uint8_t *block, uint32_t length) {
+    bsec_iot_history_iter_t iter;
+    bsec_iot_output_t output;
+
+    (void)storage;
+    (void)length;
+
+    bsec_iot_history_iter_block(&iter, block, 0, INT64_MAX);
+    while (bsec_iot_history_next(&iter, &output)) {
+        if (output.timestamp <= tasks.last_spilled) {
+            tasks.spill_disorder = 1;
+        }
+        tasks.last_spilled = output.timestamp;
+        tasks.n_spilled_samples++;
+    }
+    return 0;
+}
+
+/*!
+ * @brief       Write what the processing thread handed over while the sensor waits, on the acquisition thread
+ *
+ * @param[in]   idle_arg            unused
+ * @param[in]   now_us              current system timestamp in microseconds
+ * @param[in]   wakeup_us           time (in microseconds) of the next wakeup
+ *
+ * @return      none
+ */
+static void tests_tasks_idle(void *idle_arg, int64_t now_us, int64_t wakeup_us) {
+    (void)idle_arg;
+
+    bsec_iot_persist_flush(&tasks.persist, wakeup_us - now_us);
+    bsec_iot_history_flush(&tasks.hist, wakeup_us - now_us);
+}
+
+/*!
+ * @brief       Processing thread: drain the pipeline until the acquisition is done and the queue empty
+ *
+ * @param[in]   arg                 unused
+ *
+ * @return      NULL
+ */
+static void *tests_tasks_process(void *arg) {
+    (void)arg;
+
+    while (bsec_iot_pipeline_process(&tasks.pipeline) > 0 || !__atomic_load_n(&tasks.done, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    return NULL;
+}
+
+/*!
+ * @brief       Pipeline on two threads: the outputs of the serial run, the subscription changed from output_ready, the
+ *              state and the history staged on the processing thread and written by the idle function of the
+ *              acquisition thread, nothing lost on the way, and sensors initialized from the same arena meanwhile
+ *
+ * @return      zero if the check passed
+ */
+static int tests_tasks(void) {
+    static uint8_t loaded[BSEC_MAX_STATE_BLOB_SIZE];
+    bsec_iot_sched_t sched;
+    bsec_iot_history_iter_t iter;
+    bsec_iot_output_t output;
+    tests_outputs_t serial;
+    return_values_init ret;
+    pthread_t processing;
+    uint32_t n_ring = 0;
+    uint32_t n_warm = 0;
+    uint32_t arena_used;
+    int64_t wakeup;
+
+    memset(&tasks, 0, sizeof(tasks));
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    bsec_iot_set_handlers(&ctxs[0], tests_unsubscribe_output_ready, NULL, 0);
+    tests_run(&ctxs[0], NULL, INT64_C(1800000000));
+    serial = outputs[0];
+    TESTS_CHECK(bsec_iot_save_state(&ctxs[0], tests_tasks_keep_warm) == BSEC_OK);
+
+    tests_reset();
+    memset(tasks.nvm.slots, 0xff, sizeof(tasks.nvm.slots));
+    tasks.last_spilled = -1;
+    TESTS_CHECK(bsec_iot_persist_init(&tasks.persist, tests_nvm_read, tests_nvm_write, &tasks.nvm, 3, 1000) == 0);
+    TESTS_CHECK(bsec_iot_history_init(&tasks.hist, history_mem, sizeof(history_mem), TESTS_HISTORY_BLOCK_SIZE) == 0);
+    bsec_iot_history_set_spill(&tasks.hist, tests_tasks_spill, NULL, 1000);
+    pthread_mutex_init(&tasks.lock, NULL);
+    pthread_mutex_init(&tasks.arena_lock, NULL);
+    bsec_iot_arena_set_lock(&arena, tests_tasks_lock, &tasks.arena_lock);
+
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    bsec_iot_set_handlers(&ctxs[0], tests_tasks_output_ready, tests_tasks_state_save, TESTS_TASKS_SAVE_INTVL);
+    bsec_iot_pipeline_init(&tasks.pipeline, NULL, NULL);
+    bsec_iot_pipeline_add(&tasks.pipeline, &ctxs[0], tests_tasks_lock, &tasks.lock);
+    bsec_iot_sched_init(&sched, 0);
+    bsec_iot_sched_set_idle(&sched, tests_tasks_idle, NULL);
+    TESTS_CHECK(bsec_iot_sched_add(&sched, &ctxs[0]) == 0);
+    bme68x_emu_init(&emus[1], BME68X_EMU_VARIANT_BME680, host_clock_now_us);
+    TESTS_CHECK(pthread_create(&processing, NULL, tests_tasks_process, NULL) == 0);
+
+    while (host_clock_now_us() < INT64_C(1800000000)) {
+        wakeup = bsec_iot_sched_run(&sched, host_clock_now_us());
+        tests_tasks_idle(NULL, host_clock_now_us(), wakeup);
+
+        /* Another sensor starts warm from the same arena on each wakeup, while the processing thread saves states;
+         * its instance is given back every time */
+        arena_used = arena.used;
+        ret = bsec_iot_init(&ctxs[1], BME68X_I2C_INTF, 0x76, &emus[1], BSEC_SAMPLE_RATE_LP, NULL, 0, 0.0f,
+                            bme68x_emu_write, bme68x_emu_read, host_clock_sleep, tests_tasks_state_load, config_load,
+                            &arena);
+        arena.used = arena_used;
+        TESTS_CHECK(ret.bme68x_status == BME68X_OK && ret.bsec_status == BSEC_OK && ctxs[1].boot.state_restored);
+        n_warm++;
+
+        /* The virtual clock runs far ahead of the processing thread, which is given time to catch up */
+        while (__atomic_load_n(&tasks.pipeline.head, __ATOMIC_ACQUIRE) -
+               __atomic_load_n(&tasks.pipeline.tail, __ATOMIC_ACQUIRE) > BSEC_IOT_PIPELINE_DEPTH / 2) {
+            sched_yield();
+        }
+        host_clock_advance(wakeup - host_clock_now_us());
+    }
+    __atomic_store_n(&tasks.done, 1, __ATOMIC_RELEASE);
+    TESTS_CHECK(pthread_join(processing, NULL) == 0);
+    pthread_mutex_destroy(&tasks.lock);
+    pthread_mutex_destroy(&tasks.arena_lock);
+
+    TESTS_CHECK(n_warm > 0);
+    TESTS_CHECK(tasks.pipeline.n_dropped == 0 && tasks.pipeline.n_processed == tasks.pipeline.n_queued);
+    TESTS_CHECK(outputs[0].n_outputs == serial.n_outputs && outputs[0].hash == serial.hash);
+    TESTS_CHECK(!(ctxs[0].subscribed_mask & BSEC_IOT_OUTPUT_MASK(BSEC_IOT_OUTPUT_GAS_PERCENTAGE)));
+
+    /* Everything staged reaches flash, the latest state last */
+    TESTS_CHECK(bsec_iot_persist_flush(&tasks.persist, INT64_MAX) == 0);
+    TESTS_CHECK(tasks.persist.n_writes > 0 && tasks.persist.n_write_errors == 0);
+    TESTS_CHECK(tasks.persist.n_staged == outputs[0].n_outputs / TESTS_TASKS_SAVE_INTVL);
+    TESTS_CHECK(bsec_iot_persist_load(&tasks.persist, ctxs[0].boot.config_fingerprint, loaded, sizeof(loaded)) ==
+                tasks.state_len);
+    TESTS_CHECK(memcmp(loaded, tasks.state, tasks.state_len) == 0);
+
+    /* Every sample appended is in a block spilled or in the one being filled, in order */
+    TESTS_CHECK(bsec_iot_history_flush(&tasks.hist, INT64_MAX) == 0);
+    TESTS_CHECK(tasks.hist.n_dropped == 0 && tasks.hist.n_spilled > 0 && !tasks.spill_disorder);
+    bsec_iot_history_iter_init(&iter, &tasks.hist, tasks.last_spilled + INT64_C(1000000), INT64_MAX);
+    while (bsec_iot_history_next(&iter, &output)) {
+        n_ring++;
+    }
+    TESTS_CHECK(tasks.n_spilled_samples + n_ring == outputs[0].n_outputs);
+    TESTS_CHECK(tasks.hist.n_samples == outputs[0].n_outputs);
+
+    return 0;
+}
+
+/*!
+ * @brief       Asynchronous bus: the reads done by the simulated bus, or by the blocking adapter, give the outputs of
+ *              the blocking reads, with the transfers off the processor
+ *
+ * @return      zero if the check passed
+ */
+static int tests_bus(void) {
+    static bsec_iot_bus_t completions;
+    static host_bus_t bus;
+    bsec_iot_sched_t sched;
+    tests_outputs_t blocking;
+    int64_t wakeup;
+
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    tests_run(&ctxs[0], NULL, INT64_C(600000000));
+    blocking = outputs[0];
+
+    /* I2C at 400 kHz, the completions reported as by the interrupt of the bus */
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    bsec_iot_bus_init(&completions, NULL, NULL);
+    host_bus_init(&bus, 70, 23, &completions);
+    bsec_iot_set_async_read(&ctxs[0], host_bus_read_async, &bus);
+    bsec_iot_sched_init(&sched, 0);
+    TESTS_CHECK(bsec_iot_sched_add(&sched, &ctxs[0]) == 0);
+    while (host_clock_now_us() < INT64_C(600000000)) {
+        if (host_bus_poll(&bus) > 0) {
+            bsec_iot_bus_dispatch(&completions, &sched, host_clock_now_us());
+        }
+        wakeup = bsec_iot_sched_run(&sched, host_clock_now_us());
+        if (host_bus_next_us(&bus) < wakeup) {
+            wakeup = host_bus_next_us(&bus);
+        }
+        host_clock_advance(wakeup - host_clock_now_us());
+    }
+    TESTS_CHECK(outputs[0].n_outputs == blocking.n_outputs && outputs[0].hash == blocking.hash);
+    TESTS_CHECK(ctxs[0].bus_stats.n_async_reads > 0 && ctxs[0].bus_stats.n_async_failures == 0);
+    TESTS_CHECK(bus.n_reads == completions.n_dispatched && completions.n_dropped == 0 && bus.busy_us > 0);
+
+    /* Blocking adapter */
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    bsec_iot_set_async_read(&ctxs[0], bsec_iot_bus_blocking_read, NULL);
+    tests_run(&ctxs[0], NULL, INT64_C(600000000));
+    TESTS_CHECK(outputs[0].n_outputs == blocking.n_outputs && outputs[0].hash == blocking.hash);
+    TESTS_CHECK(ctxs[0].bus_stats.n_async_reads > 0);
+
+    return 0;
+}
+
+/*!
+ * @brief       Run one sensor for 10 minutes in LP mode, updating its charge estimate every 5 minutes, and suspend and
+ *              resume it halfway if asked to
+ *
+ * @param[out]  energy              charge estimate of the sensor
+ * @param[in]   suspend             non-zero to suspend and resume the sensor halfway
+ *
+ * @return      zero if successful, one otherwise
+ */
+static int tests_resume_run(bsec_iot_energy_t *energy, uint8_t suspend) {
+    const bsec_iot_retained_t *image;
+    return_values_init ret;
+
+    tests_reset();
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    bsec_iot_energy_init(energy, NULL);
+    bsec_iot_energy_update(energy, &ctxs[0], host_clock_now_us());
+
+    tests_run(&ctxs[0], NULL, INT64_C(300000000));
+    bsec_iot_energy_update(energy, &ctxs[0], host_clock_now_us());
+    if (suspend) {
+        TESTS_CHECK(bsec_iot_suspend(&ctxs[0], retained, sizeof(retained)) > 0);
+        image = (const bsec_iot_retained_t *)retained;
+        TESTS_CHECK(image->dev.intf_ptr == NULL && image->dev.read == NULL && image->dev.write == NULL &&
+                    image->dev.delay_us == NULL);
+
+        /* Whatever is not retained is lost in deep sleep, the BSEC instance included */
+        bsec_iot_arena_init(&arena, arena_mem, sizeof(arena_mem));
+        memset(&ctxs[0], 0xa5, sizeof(ctxs[0]));
+        ret = bsec_iot_resume(&ctxs[0], retained, sizeof(retained), &emus[0], bme68x_emu_write, bme68x_emu_read,
+                              host_clock_sleep, &arena);
+        TESTS_CHECK(ret.bme68x_status == BME68X_OK && ret.bsec_status == BSEC_OK);
+        bsec_iot_set_handlers(&ctxs[0], output_ready, NULL, 0);
+    }
+    tests_run(&ctxs[0], NULL, INT64_C(600000000));
+    bsec_iot_energy_update(energy, &ctxs[0], host_clock_now_us());
+
+    return 0;
+}
+
+/*!
+ * @brief       Resumption after a deep sleep: the sensor goes on with its schedule, and its charge estimate with the
+ *              counters it had; a sensor initialized again starts its counters over without upsetting the estimate
+ *
+ * @return      zero if the check passed
+ */
+static int tests_resume(void) {
+    static bsec_iot_energy_t energy;
+    bsec_iot_energy_report_t straight;
+    bsec_iot_energy_report_t resumed;
+    uint32_t n_outputs;
+    uint32_t n_steps;
+    uint8_t part;
+
+    TESTS_CHECK(tests_resume_run(&energy, 0) == 0);
+    bsec_iot_energy_get(&energy, BSEC_IOT_ENERGY_NUM_MODES, &straight);
+    n_outputs = outputs[0].n_outputs;
+
+    TESTS_CHECK(tests_resume_run(&energy, 1) == 0);
+    bsec_iot_energy_get(&energy, BSEC_IOT_ENERGY_NUM_MODES, &resumed);
+    TESTS_CHECK(ctxs[0].boot.resumed);
+    TESTS_CHECK(outputs[0].n_outputs == n_outputs && resumed.n_steps == straight.n_steps);
+    TESTS_CHECK(outputs[0].min_gap >= INT64_C(2900000000) && outputs[0].max_gap <= INT64_C(3100000000));
+
+    /* The sensor parts only depend on the virtual clock, the processor time is measured on the host */
+    for (part = 0; part < BSEC_IOT_ENERGY_NUM_PARTS; part++) {
+        if (part == BSEC_IOT_ENERGY_CPU) {
+            TESTS_CHECK(resumed.charge_uc[part] < 2.0f * straight.charge_uc[part] + 1000.0f);
+        } else {
+            TESTS_CHECK(fabsf(resumed.charge_uc[part] - straight.charge_uc[part]) <= 0.01f * straight.charge_uc[part]);
+        }
+    }
+
+    /* Initialized again while running, the counters start over and the estimate goes on from them, the reads of
+     * the initialization included */
+    n_outputs = outputs[0].n_outputs;
+    n_steps = resumed.n_steps;
+    TESTS_CHECK(tests_sensor(0, BSEC_SAMPLE_RATE_LP) == 0);
+    tests_run(&ctxs[0], NULL, INT64_C(900000000));
+    bsec_iot_energy_update(&energy, &ctxs[0], host_clock_now_us());
+    bsec_iot_energy_get(&energy, BSEC_IOT_ENERGY_NUM_MODES, &resumed);
+    TESTS_CHECK(resumed.n_steps - n_steps == outputs[0].n_outputs - n_outputs);
+    TESTS_CHECK(resumed.charge_uc[BSEC_IOT_ENERGY_CPU] < 10.0f * straight.charge_uc[BSEC_IOT_ENERGY_CPU] + 1000.0f);
+    TESTS_CHECK(resumed.charge_uc[BSEC_IOT_ENERGY_BUS] < 10.0f * straight.charge_uc[BSEC_IOT_ENERGY_BUS]);
+
+    return 0;
+}
+
+/*!
+ * @brief       Run the check named on the command line
+ *
+ * @return      zero if the check passed, one otherwise
+ */
+int main(int argc, char **argv) {
+    static const tests_entry_t entries[] = {
+        {"step", tests_step},         {"sched", tests_sched},     {"persist", tests_persist},
+        {"trace", tests_trace},       {"history", tests_history}, {"publish", tests_publish},
+        {"pipeline", tests_pipeline}, {"tasks", tests_tasks},     {"bus", tests_bus},
+        {"resume", tests_resume},
+    };
+    uint32_t i;
+
+    for (i = 0; argc == 2 && i < sizeof(entries) / sizeof(entries[0]); i++) {
+        if (strcmp(argv[1], entries[i].name) == 0) {
+            return entries[i].run();
+        }
+    }
+
+    fprintf(stderr, "usage: bsec_tests <step|sched|persist|trace|history|publish|pipeline|tasks|bus|resume>\n");
+    return 1;
+}
+
+/*! @}*/